@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +78,44 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* TASK 0: Starts channel 0 counting down from COUNT in mode 0
+   ("interrupt on terminal count").  The channel's output, and
+   thus interrupt line 0, rises once when the count reaches 0,
+   after COUNT / PIT_HZ seconds; unlike mode 2, the channel then
+   does not reload, so no further interrupts arrive until it is
+   reprogrammed.  A COUNT of 0 means 65536. */
+void
+pit_oneshot (uint16_t count)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0x30);
+  outb (PIT_PORT_COUNTER (0), count);
+  outb (PIT_PORT_COUNTER (0), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* TASK 0: Returns the current value of CHANNEL's counter.
+
+   The counter is latched first, so that its two bytes are read
+   from the same instant.  In mode 2 it counts down from the
+   period to 1 and reloads; in mode 0 it counts down to 0 and
+   then wraps around to 65535 and keeps going. */
+uint16_t
+pit_read_count (int channel)
+{
+  enum intr_level old_level;
+  uint16_t count;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, channel << 6);
+  count = inb (PIT_PORT_COUNTER (channel));
+  count |= inb (PIT_PORT_COUNTER (channel)) << 8;
+  intr_set_level (old_level);
+
+  return count;
+}
@@ -2,10 +2,13 @@
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
+#include <stddef.h>
 #include <stdio.h>
 #include "devices/pit.h"
 #include "lib/kernel/list.h"
 #include "threads/interrupt.h"
+#include "threads/profile.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
@@ -21,6 +24,10 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Most cycles spent in a single timer interrupt since the last
+   call to timer_reset_worst_cycles(). */
+static uint64_t worst_cycles;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -31,15 +38,114 @@ static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
-/* Semaphores used to block the sleeping threads */
-static struct list sleep_sema;
+/* TASK 0: Hierarchical timing wheel of pending timer events.
+
+   Level K has WHEEL_SLOTS slots, each covering WHEEL_SLOTS^K
+   ticks, so that the wheel as a whole covers 2^24 ticks (about
+   46 hours at 100 Hz) beyond wheel_now.  An event due DELTA
+   ticks from now goes in the lowest level K with DELTA <
+   WHEEL_SLOTS^(K+1), in the slot selected by bits 6K...6K+5 of
+   its expiry time.
+
+   At each tick wheel_advance() fires the level-0 slot that the
+   new time selects.  Whenever the low 6K bits of the time wrap
+   around to 0, the level-K slot it selects holds exactly the
+   events due in the next WHEEL_SLOTS^K ticks, which are moved
+   ("cascaded") to the lower levels first.  Events too far in the
+   future for the top level are parked in it and placed again
+   when they are cascaded. */
+#define WHEEL_BITS 6                            /* Bits per level. */
+#define WHEEL_SLOTS (1 << WHEEL_BITS)           /* Slots per level. */
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4                          /* Number of levels. */
+
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint64_t wheel_bitmap[WHEEL_LEVELS];     /* Bit S set iff slot S of
+                                                   the level non-empty. */
+static int64_t wheel_now;                       /* Last tick processed. */
+
+static void wheel_insert (struct timer_event *, bool cascading);
+static void wheel_remove (struct timer_event *);
+static void wheel_advance (void);
+static int wheel_next_event (int limit);
+
+/* TASK 0: PIT counts per timer tick, as programmed by
+   pit_configure_channel(). */
+#define PIT_PERIOD ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* TASK 0: What PIT channel 0 is programmed to do.  Only the BSP
+   receives its interrupts, but any CPU may reprogram it with
+   interrupts off. */
+enum pit_state
+  {
+    PIT_PERIODIC,               /* Interrupt at every tick (mode 2). */
+    PIT_TICKLESS,               /* One-shot over several idle ticks. */
+    PIT_HR_DEADLINE,            /* One-shot at a sub-tick deadline. */
+    PIT_HR_BOUNDARY             /* One-shot at the next tick boundary. */
+  };
+static enum pit_state pit_state;
+
+/* TASK 0: Tickless idle state.  In state PIT_TICKLESS, channel 0
+   counts down from oneshot_count to the oneshot_ticks'th tick
+   boundary after it was programmed.  The first boundary was
+   oneshot_first counts away. */
+static unsigned oneshot_ticks;
+static uint16_t oneshot_count;
+static uint16_t oneshot_first;
+
+/* TASK 0: Number of timer interrupts skipped by tickless idle. */
+static int64_t skipped_ticks;
+
+/* TASK 0: Time-stamp counter clock source, calibrated against
+   the PIT by timer_calibrate().  Until then tsc_hz is 0.  We
+   assume that the TSCs of all CPUs run in step. */
+static uint64_t tsc_hz;                 /* TSC cycles per second. */
+static uint64_t tsc_base;               /* TSC value at tick 0. */
+
+/* Number of ticks over which the TSC is calibrated. */
+#define TSC_CALIBRATE_TICKS (TIMER_FREQ / 10 > 1 ? TIMER_FREQ / 10 : 2)
+
+static uint64_t cycles_to_ns (uint64_t cycles);
+static uint64_t ns_to_cycles (uint64_t ns);
+
+/* TASK 0: Threads blocked in a sub-tick sleep, in order of
+   deadline.  Only a few short sleeps are ever pending at once,
+   so a sorted list is good enough.
+
+   While the list is non-empty, PIT channel 0 is switched to
+   one-shot mode whenever the earliest deadline falls before the
+   next tick boundary, at hr_boundary on the TSC.  When it fires,
+   the channel is aimed at the next deadline or back at the
+   boundary, where it returns to periodic mode. */
+struct hr_sleeper
+  {
+    uint64_t deadline;          /* TSC value at which to wake. */
+    struct semaphore sema;      /* The thread waits on this. */
+    struct list_elem elem;      /* Element in hr_sleepers. */
+  };
+static struct list hr_sleepers;
+static uint64_t hr_boundary;
+
+/* Sleeps shorter than this just spin: blocking and waking again
+   would cost more than the sleep itself. */
+#define HR_MIN_NS 20000
+
+static void hr_sleep (int64_t ns);
+static void hr_wake (void);
+static void hr_program (void);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void)
 {
-  list_init (&sleep_sema);
+  int level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SLOTS; slot++)
+      list_init (&wheel[level][slot]);
+  list_init (&hr_sleepers);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -69,6 +175,28 @@ timer_calibrate (void)
       loops_per_tick |= test_bit;
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  /* TASK 0: Count TSC cycles across a whole number of ticks,
+     starting right at a tick boundary. */
+  {
+    int64_t start_tick, end_tick;
+    uint64_t start_tsc, end_tsc, per_tick;
+
+    start_tick = ticks;
+    while (ticks == start_tick)
+      barrier ();
+    start_tsc = timer_cycles ();
+    start_tick = ticks;
+    end_tick = start_tick + TSC_CALIBRATE_TICKS;
+    while (ticks < end_tick)
+      barrier ();
+    end_tsc = timer_cycles ();
+
+    per_tick = (end_tsc - start_tsc) / TSC_CALIBRATE_TICKS;
+    tsc_base = start_tsc - per_tick * start_tick;
+    tsc_hz = per_tick * TIMER_FREQ;
+    printf ("TSC: %'"PRIu64" cycles/s.\n", tsc_hz);
+  }
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -81,6 +209,21 @@ timer_ticks (void)
   return t;
 }
 
+/* TASK 0: Returns the number of nanoseconds since the OS booted,
+   read from the TSC.  Until the TSC has been calibrated, only
+   tick resolution is available. */
+int64_t
+timer_now_ns (void)
+{
+  int64_t cycles;
+
+  if (tsc_hz == 0)
+    return timer_ticks () * (1000000000 / TIMER_FREQ);
+
+  cycles = timer_cycles () - tsc_base;
+  return cycles > 0 ? (int64_t) cycles_to_ns (cycles) : 0;
+}
+
 /* Returns the number of timer ticks elapsed since THEN, which
    should be a value once returned by timer_ticks(). */
 int64_t
@@ -89,13 +232,20 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
-/* Comparator function that returns true if the thread A wakes up before
-   thread B using number of wake_up_tick */
-static bool less_sema_ticks (const struct list_elem *a UNUSED,
-                             const struct list_elem *b,
-                             void *aux) {
-  int64_t *ticks_ptr = (int64_t*) aux;
-  return *ticks_ptr < thread_for_sema_list_elem(b)->wake_up_tick;
+/* TASK 0: A thread waiting in timer_sleep(). */
+struct sleeper
+  {
+    struct timer_event event;   /* Fires when the thread should wake. */
+    struct semaphore sema;      /* The thread waits on this. */
+  };
+
+/* Wakes up the thread sleeping on the sleeper that contains EV. */
+static void
+wake_sleeper (struct timer_event *ev)
+{
+  struct sleeper *s = (struct sleeper *) ((uint8_t *) ev
+                                          - offsetof (struct sleeper, event));
+  sema_up (&s->sema);
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
@@ -103,29 +253,76 @@ static bool less_sema_ticks (const struct list_elem *a UNUSED,
 void
 timer_sleep (int64_t ticks)
 {
+  struct thread *cur = thread_current ();
+  struct sleeper s;
+  enum intr_level old_level;
+
   ASSERT (intr_get_level () == INTR_ON);
 
-  ticks += timer_ticks ();
-  thread_current ()->wake_up_tick = ticks;
+  if (ticks <= 0)
+    return;
 
-  /* Initialise semaphore  */
-  struct semaphore_elem sema_elem;
+  sema_init (&s.sema, 0);
+  timer_event_init (&s.event);
 
-  /* Initialise the semaphore with 0 to wait for a signal from
-     timer_interrupt() */
-  sema_init(&sema_elem.semaphore, 0);
+  /* TASK 0: Adding to the timing wheel takes constant time, no
+     matter how many other threads are asleep. */
+  old_level = intr_disable ();
+  cur->wake_up_tick = timer_ticks () + ticks;
+  timer_event_add (&s.event, cur->wake_up_tick, wake_sleeper);
+  intr_set_level (old_level);
 
-  enum intr_level old_level = intr_disable ();
+  sema_down (&s.sema);
+}
 
-  /* Add the new sleep_thread to list acting as a priority queue
-   i.e. The threads that have to sleep the longest will be at the end
-   of the queue */
-  list_insert_ordered(&sleep_sema, &sema_elem.elem, less_sema_ticks, &ticks);
+/* TASK 0: Initializes EV as a timer event that is not pending. */
+void
+timer_event_init (struct timer_event *ev)
+{
+  ASSERT (ev != NULL);
+  ev->pending = false;
+}
 
+/* TASK 0: Arranges for the timer interrupt handler to call FUNC,
+   passing EV, once timer_ticks() reaches EXPIRES.  If EXPIRES
+   has already been reached, FUNC is called at the next tick.  If
+   EV is already pending, it is first cancelled.  EV must stay
+   valid until FUNC is called or EV is cancelled. */
+void
+timer_event_add (struct timer_event *ev, int64_t expires,
+                 timer_event_func *func)
+{
+  enum intr_level old_level;
+
+  ASSERT (ev != NULL);
+  ASSERT (func != NULL);
+
+  old_level = intr_disable ();
+  if (ev->pending)
+    wheel_remove (ev);
+  ev->expires = expires;
+  ev->func = func;
+  wheel_insert (ev, false);
+  intr_set_level (old_level);
+}
+
+/* TASK 0: Cancels timer event EV.  Returns true if EV was
+   pending, false if it had already fired or was never added. */
+bool
+timer_event_cancel (struct timer_event *ev)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (ev != NULL);
+
+  old_level = intr_disable ();
+  was_pending = ev->pending;
+  if (was_pending)
+    wheel_remove (ev);
   intr_set_level (old_level);
 
-  /* Block thread */
-  sema_down(&sema_elem.semaphore);
+  return was_pending;
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -195,33 +392,306 @@ timer_ndelay (int64_t ns)
 void
 timer_print_stats (void)
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRId64" skipped while idle\n",
+          timer_ticks (), skipped_ticks);
 }
 
-/* Timer interrupt handler. */
+/* Returns the most CPU cycles spent handling a single timer
+   interrupt since the last call to timer_reset_worst_cycles(). */
+uint64_t
+timer_worst_cycles (void)
+{
+  enum intr_level old_level = intr_disable ();
+  uint64_t t = worst_cycles;
+  intr_set_level (old_level);
+  return t;
+}
+
+/* Resets the value returned by timer_worst_cycles(). */
+void
+timer_reset_worst_cycles (void)
+{
+  enum intr_level old_level = intr_disable ();
+  worst_cycles = 0;
+  intr_set_level (old_level);
+}
+
+/* Handles a tick of the timer, for timer_interrupt(). */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_tick (struct intr_frame *args)
 {
+  if (pit_state == PIT_HR_BOUNDARY)
+    {
+      pit_state = PIT_PERIODIC;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+
   ticks++;
 
-  /* Wakes up (unblocks) all threads that have slept
-     for the wake_at_ticks (member) duration of ticks */
-  struct list_elem *e = list_begin(&sleep_sema);
+  /* TASK 1: Only the BSP sees the timer, so pass the tick on. */
+  smp_send_tick ();
 
-  while (e != list_end(&sleep_sema)) {
+  /* TASK 0: Wake up threads whose sleep is over. */
+  wheel_advance ();
 
-    struct thread *t = thread_for_sema_list_elem (e);
+  thread_tick ();
+  profile_tick (args);
 
-    /* If it is time for the thread to wake up */
-    if(t->wake_up_tick > ticks) break;
+  /* TASK 0: Aim at a sub-tick deadline during the coming tick. */
+  if (!list_empty (&hr_sleepers))
+    {
+      hr_wake ();
+      hr_program ();
+    }
+}
 
-    sema_up(&list_entry(e, struct semaphore_elem, elem)->semaphore);
-    // unblock sleeping thread
-    e = list_remove(e);
-    // remove semaphores from the list
-  }
+/* Timer interrupt handler.  Whether the interrupt is a tick or a
+   sub-tick deadline, its cost counts toward worst_cycles. */
+static void
+timer_interrupt (struct intr_frame *args)
+{
+  uint64_t start = timer_cycles ();
+  uint64_t elapsed;
 
-  thread_tick ();
+  /* TASK 0: A sub-tick deadline is not a tick. */
+  if (pit_state == PIT_HR_DEADLINE)
+    {
+      hr_wake ();
+      hr_program ();
+    }
+  else
+    timer_tick (args);
+
+  elapsed = timer_cycles () - start;
+  if (elapsed > worst_cycles)
+    worst_cycles = elapsed;
+}
+
+/* TASK 0: Stops the periodic timer interrupt while the system is
+   idle.  Called by the BSP's idle thread, with interrupts off,
+   when no CPU has anything to run.
+
+   Channel 0 is reprogrammed in one-shot mode to interrupt at the
+   tick boundary where the next timer event is due, or as far
+   ahead as its 16-bit counter reaches, whichever is sooner.  The
+   first boundary is where the periodic count would have reached
+   it, so ticks stay in step with real time.  Under the MLFQS we
+   never skip past the start of a second, where thread.c
+   recomputes the load average.
+
+   Whatever interrupt wakes the CPU, timer_idle_exit() restores
+   the periodic interrupt before it is handled. */
+void
+timer_idle_enter (void)
+{
+  int limit, n;
+  uint16_t first;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (pit_state != PIT_PERIODIC || !list_empty (&hr_sleepers))
+    return;
+
+  limit = UINT16_MAX / PIT_PERIOD;
+  if (thread_mlfqs)
+    {
+      int to_second = TIMER_FREQ - ticks % TIMER_FREQ;
+      if (to_second < limit)
+        limit = to_second;
+    }
+  n = wheel_next_event (limit);
+  if (n < 2)
+    return;
+
+  first = pit_read_count (0);
+  if (first == 0 || first > PIT_PERIOD)
+    first = PIT_PERIOD;
+
+  pit_state = PIT_TICKLESS;
+  oneshot_ticks = n;
+  oneshot_first = first;
+  oneshot_count = first + (n - 1) * PIT_PERIOD;
+  pit_oneshot (oneshot_count);
+}
+
+/* TASK 0: Ends tickless idle, if it is in effect.  Called with
+   interrupts off at the start of every external interrupt.
+
+   Catches up on the ticks that passed without an interrupt and
+   puts channel 0 back in periodic mode.  If the one-shot count
+   has run out, the interrupt for its last tick is pending (or is
+   the one being handled), and timer_interrupt() will count that
+   tick itself.  Otherwise, the fraction of a tick since the last
+   boundary is lost when the periodic count restarts. */
+void
+timer_idle_exit (void)
+{
+  unsigned caught_up;
+  uint16_t count;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (pit_state != PIT_TICKLESS)
+    return;
+
+  count = pit_read_count (0);
+  if (count == 0 || count > oneshot_count)
+    caught_up = oneshot_ticks - 1;
+  else
+    {
+      unsigned elapsed = oneshot_count - count;
+      caught_up = (elapsed < oneshot_first ? 0
+                   : 1 + (elapsed - oneshot_first) / PIT_PERIOD);
+    }
+  pit_state = PIT_PERIODIC;
+  pit_configure_channel (0, 2, TIMER_FREQ);
+
+  skipped_ticks += caught_up;
+  thread_idle_ticks (caught_up);
+  while (caught_up-- > 0)
+    {
+      ticks++;
+      wheel_advance ();
+    }
+}
+
+/* TASK 0: Adds EV to the timing wheel.  CASCADING is true if EV
+   is being moved down from a higher level by wheel_cascade(), in
+   which case the current level-0 slot has yet to be fired this
+   tick.  Interrupts must be off. */
+static void
+wheel_insert (struct timer_event *ev, bool cascading)
+{
+  int64_t delta = ev->expires - wheel_now;
+  int64_t when = ev->expires;
+  int level = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (delta <= 0)
+    {
+      /* Already due.  An event cascaded on its own tick goes in the
+         slot about to be fired, so that it is neither late nor
+         behind events due after it; a new one fires at the next
+         tick. */
+      when = cascading ? wheel_now : wheel_now + 1;
+    }
+  else
+    {
+      while (level < WHEEL_LEVELS - 1
+             && delta >= (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+        level++;
+
+      /* Too far ahead for the top level: park it in the last
+         slot that level covers. */
+      if (delta >= (int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+        when = wheel_now + ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    }
+
+  ev->level = level;
+  ev->slot = (when >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  list_push_back (&wheel[level][ev->slot], &ev->elem);
+  wheel_bitmap[level] |= (uint64_t) 1 << ev->slot;
+  ev->pending = true;
+}
+
+/* TASK 0: Removes pending event EV from the timing wheel.
+   Interrupts must be off. */
+static void
+wheel_remove (struct timer_event *ev)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (ev->pending);
+
+  list_remove (&ev->elem);
+  if (list_empty (&wheel[ev->level][ev->slot]))
+    wheel_bitmap[ev->level] &= ~((uint64_t) 1 << ev->slot);
+  ev->pending = false;
+}
+
+/* TASK 0: Moves every event in SLOT of LEVEL down to the level
+   where it now belongs. */
+static void
+wheel_cascade (int level, int slot)
+{
+  struct list events;
+
+  if (list_empty (&wheel[level][slot]))
+    return;
+
+  list_init (&events);
+  list_splice (list_end (&events), list_begin (&wheel[level][slot]),
+               list_end (&wheel[level][slot]));
+  wheel_bitmap[level] &= ~((uint64_t) 1 << slot);
+
+  while (!list_empty (&events))
+    wheel_insert (list_entry (list_pop_front (&events),
+                              struct timer_event, elem), true);
+}
+
+/* TASK 0: Advances the timing wheel by one tick, to match an
+   increment of `ticks', and calls the functions of the events
+   that are now due.  Interrupts must be off. */
+static void
+wheel_advance (void)
+{
+  struct list *due;
+  int level, slot;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  wheel_now++;
+  ASSERT (wheel_now == ticks);
+
+  /* Cascade from the highest level down, so that events moving
+     two levels at once are still picked up this tick. */
+  for (level = WHEEL_LEVELS - 1; level > 0; level--)
+    if ((wheel_now & (((int64_t) 1 << (WHEEL_BITS * level)) - 1)) == 0)
+      wheel_cascade (level, (wheel_now >> (WHEEL_BITS * level)) & WHEEL_MASK);
+
+  /* Fire the events in the current level-0 slot, in the order
+     they were added.  Each one is removed before its function
+     runs, so that the function may add it again. */
+  slot = wheel_now & WHEEL_MASK;
+  due = &wheel[0][slot];
+  while (!list_empty (due))
+    {
+      struct timer_event *ev = list_entry (list_pop_front (due),
+                                           struct timer_event, elem);
+      ASSERT (ev->expires <= wheel_now);
+      ev->pending = false;
+      ev->func (ev);
+    }
+  wheel_bitmap[0] &= ~((uint64_t) 1 << slot);
+}
+
+/* TASK 0: Returns the number of ticks from now, between 1 and
+   LIMIT, until the timing wheel next has work to do: an event to
+   fire or a non-empty slot to cascade.  Returns LIMIT if there
+   is none before then. */
+static int
+wheel_next_event (int limit)
+{
+  int i;
+
+  for (i = 1; i < limit; i++)
+    {
+      int64_t t = wheel_now + i;
+      int level;
+
+      if (wheel_bitmap[0] & ((uint64_t) 1 << (t & WHEEL_MASK)))
+        return i;
+      for (level = 1; level < WHEEL_LEVELS; level++)
+        {
+          int shift = WHEEL_BITS * level;
+          if ((t & (((int64_t) 1 << shift) - 1)) != 0)
+            break;
+          if (wheel_bitmap[level] & ((uint64_t) 1 << ((t >> shift)
+                                                       & WHEEL_MASK)))
+            return i;
+        }
+    }
+  return limit;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -279,9 +749,15 @@ real_time_sleep (int64_t num, int32_t denom)
     }
   else
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom);
+      /* TASK 0: Block until a one-shot timer interrupt for
+         sub-tick sleeps long enough to be worth it, once the TSC
+         gives us the resolution to time them.  Otherwise, use a
+         busy-wait loop for more accurate sub-tick timing. */
+      int64_t ns = num * 1000000000 / denom;
+      if (tsc_hz != 0 && ns >= HR_MIN_NS)
+        hr_sleep (ns);
+      else
+        real_time_delay (num, denom);
     }
 }
 
@@ -294,3 +770,124 @@ real_time_delay (int64_t num, int32_t denom)
   ASSERT (denom % 1000 == 0);
   busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
 }
+
+/* TASK 0: Converts a number of TSC cycles to nanoseconds.  Split
+   into whole seconds and a remainder so that the product cannot
+   overflow. */
+static uint64_t
+cycles_to_ns (uint64_t cycles)
+{
+  return (cycles / tsc_hz * 1000000000
+          + cycles % tsc_hz * 1000000000 / tsc_hz);
+}
+
+/* TASK 0: Converts a number of nanoseconds to TSC cycles. */
+static uint64_t
+ns_to_cycles (uint64_t ns)
+{
+  return ns / 1000000000 * tsc_hz + ns % 1000000000 * tsc_hz / 1000000000;
+}
+
+/* TASK 0: Converts a TSC interval of CYCLES to a count for PIT
+   channel 0, rounding up so that the interrupt does not come
+   early, and clamping to what the 16-bit counter can hold. */
+static uint16_t
+cycles_to_pit (int64_t cycles)
+{
+  uint64_t count;
+
+  if (cycles <= 0)
+    return 1;
+  count = ((uint64_t) cycles * PIT_HZ + tsc_hz - 1) / tsc_hz;
+  if (count == 0)
+    return 1;
+  return count > UINT16_MAX ? UINT16_MAX : count;
+}
+
+/* Returns true if hr_sleeper A has an earlier deadline than B. */
+static bool
+hr_sleeper_less (const struct list_elem *a_, const struct list_elem *b_,
+                 void *aux UNUSED)
+{
+  const struct hr_sleeper *a = list_entry (a_, struct hr_sleeper, elem);
+  const struct hr_sleeper *b = list_entry (b_, struct hr_sleeper, elem);
+  return a->deadline < b->deadline;
+}
+
+/* TASK 0: Blocks the current thread for NS nanoseconds, less
+   than a tick, and wakes it from a one-shot timer interrupt. */
+static void
+hr_sleep (int64_t ns)
+{
+  struct hr_sleeper s;
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  sema_init (&s.sema, 0);
+  old_level = intr_disable ();
+  s.deadline = timer_cycles () + ns_to_cycles (ns);
+  list_insert_ordered (&hr_sleepers, &s.elem, hr_sleeper_less, NULL);
+  hr_program ();
+  intr_set_level (old_level);
+
+  sema_down (&s.sema);
+}
+
+/* TASK 0: Wakes up every sub-tick sleeper whose deadline has
+   passed.  Interrupts must be off. */
+static void
+hr_wake (void)
+{
+  uint64_t now = timer_cycles ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&hr_sleepers))
+    {
+      struct hr_sleeper *s = list_entry (list_front (&hr_sleepers),
+                                         struct hr_sleeper, elem);
+      if (s->deadline > now)
+        break;
+      list_pop_front (&hr_sleepers);
+      sema_up (&s->sema);
+    }
+}
+
+/* TASK 0: Programs PIT channel 0 for the earliest sub-tick
+   deadline, if it comes before the next tick boundary, or else
+   for the boundary if the channel is in one-shot mode.
+   Interrupts must be off. */
+static void
+hr_program (void)
+{
+  uint64_t now = timer_cycles ();
+  uint64_t deadline;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (pit_state == PIT_TICKLESS)
+    return;
+  if (pit_state == PIT_PERIODIC)
+    {
+      /* If this tick's interrupt is already pending, leave it to
+         timer_interrupt() to program the next tick. */
+      if (list_empty (&hr_sleepers) || intr_ext_pending (0x20))
+        return;
+      hr_boundary = now + pit_read_count (0) * tsc_hz / PIT_HZ;
+    }
+
+  deadline = (list_empty (&hr_sleepers) ? hr_boundary
+              : list_entry (list_front (&hr_sleepers),
+                            struct hr_sleeper, elem)->deadline);
+  if (deadline < hr_boundary)
+    {
+      pit_state = PIT_HR_DEADLINE;
+      pit_oneshot (cycles_to_pit (deadline - now));
+    }
+  else if (pit_state != PIT_PERIODIC)
+    {
+      pit_state = PIT_HR_BOUNDARY;
+      pit_oneshot (cycles_to_pit (hr_boundary - now));
+    }
+}
@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,6 +14,7 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_now_ns (void);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -19,11 +22,53 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* TASK 0: Timer events.
+
+   A timer event calls a function from the timer interrupt
+   handler once timer_ticks() reaches a given value.  Events are
+   kept in a hierarchical timing wheel, so that adding or
+   cancelling one takes constant time however many are pending.
+   The function runs in an external interrupt context, so it
+   must not sleep. */
+struct timer_event;
+typedef void timer_event_func (struct timer_event *);
+
+struct timer_event
+  {
+    int64_t expires;            /* Tick at which to call FUNC. */
+    timer_event_func *func;     /* Function to call. */
+    struct list_elem elem;      /* Element in a wheel slot. */
+    uint8_t level;              /* Wheel level holding ELEM. */
+    uint8_t slot;               /* Slot within LEVEL holding ELEM. */
+    bool pending;               /* In the wheel? */
+  };
+
+void timer_event_init (struct timer_event *);
+void timer_event_add (struct timer_event *, int64_t expires,
+                      timer_event_func *);
+bool timer_event_cancel (struct timer_event *);
+
+/* TASK 0: Tickless idle. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 /* Busy waits. */
 void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
+uint64_t timer_worst_cycles (void);
+void timer_reset_worst_cycles (void);
+
+/* Reads the CPU's time-stamp counter, for timing short code
+   paths in cycles.  See [IA32-v2b] "RDTSC". */
+static inline uint64_t
+timer_cycles (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
 
 #endif /* devices/timer.h */
@@ -0,0 +1,109 @@
+/* top.c
+
+   Samples per-thread statistics and prints, for each live
+   thread, how much it ran, switched, faulted and did I/O since
+   the previous sample.
+
+   Usage: top [SAMPLES [DELAY]]
+   SAMPLES defaults to 5.  There is no sleep system call, so
+   samples are separated by a busy loop of DELAY iterations. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define MAX_THREADS 64
+
+static struct thread_stats prev[MAX_THREADS], cur[MAX_THREADS];
+static int prev_cnt;
+
+/* Returns the previous sample for thread TID, or NULL if there
+   is none. */
+static const struct thread_stats *
+find_prev (int tid)
+{
+  int i;
+
+  for (i = 0; i < prev_cnt; i++)
+    if (prev[i].tid == tid)
+      return &prev[i];
+  return NULL;
+}
+
+/* Orders threads by descending run ticks. */
+static int
+compare_run_ticks (const void *a_, const void *b_)
+{
+  const struct thread_stats *a = a_;
+  const struct thread_stats *b = b_;
+
+  return a->run_ticks < b->run_ticks ? 1 : a->run_ticks > b->run_ticks ? -1 : 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int samples = argc > 1 ? atoi (argv[1]) : 5;
+  int delay = argc > 2 ? atoi (argv[2]) : 10000000;
+  int s;
+
+  for (s = 0; s < samples; s++)
+    {
+      volatile int spin;
+      int cnt, i;
+
+      cnt = stats (cur, MAX_THREADS);
+      if (cnt < 0)
+        {
+          printf ("top: stats failed\n");
+          return EXIT_FAILURE;
+        }
+
+      /* Turn the counters into deltas against the previous sample,
+         keeping the raw values for the next round. */
+      for (i = 0; i < cnt; i++)
+        {
+          const struct thread_stats *p = find_prev (cur[i].tid);
+          struct thread_stats raw = cur[i];
+
+          if (p != NULL)
+            {
+              cur[i].run_ticks -= p->run_ticks;
+              cur[i].voluntary_switches -= p->voluntary_switches;
+              cur[i].involuntary_switches -= p->involuntary_switches;
+              cur[i].page_faults -= p->page_faults;
+              cur[i].major_faults -= p->major_faults;
+              cur[i].swap_ins -= p->swap_ins;
+              cur[i].lock_blocks -= p->lock_blocks;
+              cur[i].bytes_read -= p->bytes_read;
+              cur[i].bytes_written -= p->bytes_written;
+            }
+          prev[i] = raw;
+        }
+      prev_cnt = cnt;
+
+      qsort (cur, cnt, sizeof *cur, compare_run_ticks);
+
+      printf ("%5s %-15s %3s %6s %6s %6s %6s %6s %6s %6s %8s %8s\n",
+              "TID", "NAME", "PRI", "TICKS", "VCSW", "ICSW",
+              "FAULTS", "MAJFLT", "SWAPIN", "LOCKS", "READ", "WRITTEN");
+      for (i = 0; i < cnt; i++)
+        printf ("%5d %-15s %3d %6u %6u %6u %6u %6u %6u %6u %8llu %8llu\n",
+                cur[i].tid, cur[i].name, cur[i].priority,
+                (unsigned) cur[i].run_ticks,
+                (unsigned) cur[i].voluntary_switches,
+                (unsigned) cur[i].involuntary_switches,
+                (unsigned) cur[i].page_faults,
+                (unsigned) cur[i].major_faults,
+                (unsigned) cur[i].swap_ins,
+                (unsigned) cur[i].lock_blocks,
+                (unsigned long long) cur[i].bytes_read,
+                (unsigned long long) cur[i].bytes_written);
+      printf ("\n");
+
+      if (s + 1 < samples)
+        for (spin = 0; spin < delay; spin++)
+          continue;
+    }
+  return EXIT_SUCCESS;
+}
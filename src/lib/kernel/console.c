@@ -63,7 +63,7 @@ static int64_t write_cnt;
 void
 console_init (void) 
 {
-  lock_init (&console_lock);
+  lock_init_named (&console_lock, "console_lock");
   use_console_lock = true;
 }
 
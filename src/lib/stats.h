@@ -0,0 +1,30 @@
+#ifndef __LIB_STATS_H
+#define __LIB_STATS_H
+
+#include <stdint.h>
+
+/* Per-thread statistics.  The kernel keeps one of these in every
+   thread and copies them out through the stats system call, so
+   the layout is shared between the kernel and user programs. */
+struct thread_stats
+  {
+    /* Filled in when the statistics are sampled. */
+    int tid;                            /* Thread identifier. */
+    char name[16];                      /* Thread name. */
+    int priority;                       /* Effective priority. */
+
+    /* Counters, zero when the thread is created. */
+    uint32_t run_ticks;                 /* Timer ticks spent running. */
+    uint32_t voluntary_switches;        /* Context switches from blocking. */
+    uint32_t involuntary_switches;      /* Context switches from preemption
+                                           or yielding. */
+    uint32_t page_faults;               /* Page faults taken. */
+    uint32_t major_faults;              /* Page faults that waited for a
+                                           read from swap or a file. */
+    uint32_t swap_ins;                  /* Pages read back from swap. */
+    uint32_t lock_blocks;               /* Times blocked on a held lock. */
+    uint64_t bytes_read;                /* Bytes returned by read(). */
+    uint64_t bytes_written;             /* Bytes accepted by write(). */
+  };
+
+#endif /* lib/stats.h */
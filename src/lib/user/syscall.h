@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <stats.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +46,10 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Statistics. */
+int stats (struct thread_stats *, int max);
+
+/* Copy-on-write process creation. */
+pid_t fork (void);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,143 @@
+/* Microbenchmark for threads/palloc.c.
+
+   Times single-page allocations freed right away, which the
+   per-CPU page caches serve, a few hundred pages allocated and
+   freed together, and a mix of multi-page allocations of random
+   size freed in random order, which exercises splitting and
+   merging in the buddy lists.  Checks along the way that no two
+   allocations overlap and that freed memory merges back into
+   large blocks.
+
+   This is not a test we will run on your submitted tasks.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Single-page allocations timed in the first two phases. */
+#define PAIR_CNT 10000
+#define BATCH_PAGES 256
+#define BATCH_ROUNDS 40
+
+/* Multi-page allocations held at once, and timed, in the last. */
+#define MULTI_MAX 64
+#define MULTI_OPS 10000
+#define MULTI_PAGES 16
+
+static void report (const char *what, int64_t start, int ops);
+static void fill (void *pages, size_t page_cnt, int tag);
+static void verify (const void *pages, size_t page_cnt, int tag);
+
+/* Pages held by the batch phase. */
+static void *batch[BATCH_PAGES];
+
+/* Benchmarks the page allocator. */
+void
+test (void)
+{
+  void *held[MULTI_MAX];
+  size_t held_cnt[MULTI_MAX];
+  int64_t start;
+  void *big;
+  int i, j;
+
+  /* Allocate and free one page at a time. */
+  start = timer_now_ns ();
+  for (i = 0; i < PAIR_CNT; i++)
+    {
+      void *page = palloc_get_page (PAL_ASSERT);
+      palloc_free_page (page);
+    }
+  report ("single page get/free pairs", start, PAIR_CNT);
+
+  /* Allocate many pages, then free them all. */
+  start = timer_now_ns ();
+  for (i = 0; i < BATCH_ROUNDS; i++)
+    {
+      for (j = 0; j < BATCH_PAGES; j++)
+        {
+          batch[j] = palloc_get_page (PAL_ASSERT);
+          *(int *) batch[j] = j;
+        }
+      for (j = 0; j < BATCH_PAGES; j++)
+        {
+          ASSERT (*(int *) batch[j] == j);
+          palloc_free_page (batch[j]);
+        }
+    }
+  report ("batched single page get/free pairs", start,
+          BATCH_ROUNDS * BATCH_PAGES);
+
+  /* Hold a changing set of multi-page allocations. */
+  for (i = 0; i < MULTI_MAX; i++)
+    held[i] = NULL;
+  start = timer_now_ns ();
+  for (i = 0; i < MULTI_OPS; i++)
+    {
+      int slot = random_ulong () % MULTI_MAX;
+
+      if (held[slot] != NULL)
+        {
+          verify (held[slot], held_cnt[slot], slot);
+          palloc_free_multiple (held[slot], held_cnt[slot]);
+          held[slot] = NULL;
+        }
+      else
+        {
+          held_cnt[slot] = random_ulong () % MULTI_PAGES + 1;
+          held[slot] = palloc_get_multiple (PAL_ASSERT, held_cnt[slot]);
+          fill (held[slot], held_cnt[slot], slot);
+        }
+    }
+  report ("multi-page gets and frees", start, MULTI_OPS);
+  for (i = 0; i < MULTI_MAX; i++)
+    if (held[i] != NULL)
+      {
+        verify (held[i], held_cnt[i], i);
+        palloc_free_multiple (held[i], held_cnt[i]);
+      }
+
+  /* Everything freed should have merged back together. */
+  big = palloc_get_multiple (0, MULTI_MAX * MULTI_PAGES);
+  ASSERT (big != NULL);
+  palloc_free_multiple (big, MULTI_MAX * MULTI_PAGES);
+
+  printf ("palloc: PASS\n");
+}
+
+/* Prints the average time per operation since START. */
+static void
+report (const char *what, int64_t start, int ops)
+{
+  int64_t ns = timer_now_ns () - start;
+  printf ("palloc: %d %s: %"PRId64" ns each\n", ops, what, ns / ops);
+}
+
+/* Marks the first word of each of the PAGE_CNT pages at PAGES
+   with TAG. */
+static void
+fill (void *pages, size_t page_cnt, int tag)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    *(int *) ((uint8_t *) pages + i * PGSIZE) = tag;
+}
+
+/* Checks that no other allocation overwrote fill()'s marks. */
+static void
+verify (const void *pages, size_t page_cnt, int tag)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    ASSERT (*(const int *) ((const uint8_t *) pages + i * PGSIZE) == tag);
+}
@@ -0,0 +1,64 @@
+/* Checks that sub-tick sleeps block instead of spinning.
+
+   The main thread sleeps for 100 microseconds, a small fraction
+   of a tick, SLEEP_CNT times, while a lower-priority thread
+   counts loop iterations.  Each sleep is timed with
+   timer_now_ns() and must not end early.  If the sleeps blocked,
+   the counting thread ran while the main thread slept. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEP_CNT 100           /* Number of sleeps. */
+#define SLEEP_US 100            /* Length of each sleep. */
+
+static thread_func counter;
+
+static volatile bool done;
+static volatile unsigned count;
+static struct semaphore done_sema;
+
+void
+test_alarm_hires (void)
+{
+  int64_t total_ns = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done_sema, 0);
+  thread_create ("counter", PRI_DEFAULT - 1, counter, NULL);
+
+  for (i = 0; i < SLEEP_CNT; i++)
+    {
+      int64_t start = timer_now_ns ();
+      int64_t elapsed;
+
+      timer_usleep (SLEEP_US);
+      elapsed = timer_now_ns () - start;
+      if (elapsed < SLEEP_US * 1000)
+        fail ("sleep %d lasted only %lld ns", i, elapsed);
+      total_ns += elapsed;
+    }
+  done = true;
+  sema_down (&done_sema);
+
+  msg ("%d sleeps of %d us: %lld us on average.",
+       SLEEP_CNT, SLEEP_US, total_ns / SLEEP_CNT / 1000);
+  if (count == 0)
+    fail ("lower-priority thread never ran while we slept");
+  msg ("Lower-priority thread ran while we slept.");
+}
+
+static void
+counter (void *aux UNUSED)
+{
+  while (!done)
+    count++;
+  sema_up (&done_sema);
+}
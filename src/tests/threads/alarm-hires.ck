@@ -0,0 +1,34 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the average varying
+# from run to run:
+#
+# (alarm-hires) 100 sleeps of 100 us: 131 us on average.
+# (alarm-hires) Lower-priority thread ran while we slept.
+#
+# A sleep rounded up to the next timer tick would last 5,000 us on
+# average at 100 Hz, so the sleeps must average less than that.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(alarm-hires) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(alarm-hires) end', @output);
+my ($average) = map (/^\(alarm-hires\) 100 sleeps of 100 us: (\d+) us on average\.$/, @output);
+fail "missing sleep timing" unless defined $average;
+fail "100 us sleeps lasted $average us on average, "
+  . "as long as sleeping to the next tick\n"
+  unless $average < 5000;
+fail "lower-priority thread did not run"
+  unless grep ($_ eq '(alarm-hires) Lower-priority thread ran while we slept.', @output);
+
+pass;
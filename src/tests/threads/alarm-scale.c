@@ -0,0 +1,226 @@
+/* Measures how the cost of timer_sleep()'s bookkeeping scales
+   with the number of pending timer events, then checks that a
+   thousand sleeping threads wake up on time and in order.
+
+   For 10, 100, 1000 and 10000 pending events, with expiry times
+   spread from the next tick to hours ahead, the main thread
+   times adding and then cancelling a batch of probe events with
+   the CPU's cycle counter.  With a timing wheel neither cost
+   should grow with the number of pending events.
+
+   Events due exactly on a tick where the timing wheel moves them
+   down from a higher level, at multiples of 64 ticks, must fire
+   on that tick, and before events due after it.
+
+   While the sleepers wait, nothing is runnable, so the idle
+   thread should stop the periodic timer interrupt; the number of
+   ticks it skipped appears in the "Timer:" line at shutdown. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define PROBE_CNT 100           /* Events added and cancelled per round. */
+#define SLEEPER_CNT 1000        /* Threads in the wake-up check. */
+#define BOUNDARY_CNT 4          /* Wheel boundaries in the boundary check. */
+#define WHEEL_SPAN 64           /* Ticks covered by a level-0 wheel turn. */
+
+static void measure (int pending_cnt);
+static void check_boundaries (void);
+static void check_wakeups (void);
+
+void
+test_alarm_scale (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  measure (10);
+  measure (100);
+  measure (1000);
+  measure (10000);
+
+  check_boundaries ();
+  check_wakeups ();
+}
+
+/* Does nothing.  Background events that come due while we
+   measure end up here. */
+static void
+ignore_event (struct timer_event *ev UNUSED)
+{
+}
+
+/* Times adding and cancelling timer events with PENDING_CNT
+   other events in the timing wheel. */
+static void
+measure (int pending_cnt)
+{
+  struct timer_event *pending, *probes;
+  uint64_t add_cycles, cancel_cycles, start;
+  int64_t now;
+  int i;
+
+  pending = malloc (sizeof *pending * pending_cnt);
+  probes = malloc (sizeof *probes * PROBE_CNT);
+  if (pending == NULL || probes == NULL)
+    fail ("couldn't allocate %d timer events", pending_cnt + PROBE_CNT);
+
+  now = timer_ticks ();
+  for (i = 0; i < pending_cnt; i++)
+    {
+      timer_event_init (&pending[i]);
+      timer_event_add (&pending[i], now + 1 + (i * 7919) % 1000000,
+                       ignore_event);
+    }
+  for (i = 0; i < PROBE_CNT; i++)
+    timer_event_init (&probes[i]);
+
+  start = timer_cycles ();
+  for (i = 0; i < PROBE_CNT; i++)
+    timer_event_add (&probes[i], now + 1 + (i * 104729) % 1000000,
+                     ignore_event);
+  add_cycles = (timer_cycles () - start) / PROBE_CNT;
+
+  start = timer_cycles ();
+  for (i = 0; i < PROBE_CNT; i++)
+    timer_event_cancel (&probes[i]);
+  cancel_cycles = (timer_cycles () - start) / PROBE_CNT;
+
+  msg ("%5d pending events: %llu cycles per insert, %llu cycles per cancel",
+       pending_cnt, add_cycles, cancel_cycles);
+
+  for (i = 0; i < pending_cnt; i++)
+    timer_event_cancel (&pending[i]);
+  free (probes);
+  free (pending);
+}
+
+/* Shared state for check_boundaries(). */
+static struct timer_event boundary_events[3 * BOUNDARY_CNT];
+static int64_t boundary_deadlines[3 * BOUNDARY_CNT];
+static int64_t fired_at[3 * BOUNDARY_CNT];  /* Tick each event fired. */
+static int fire_order[3 * BOUNDARY_CNT];    /* Events, in order fired. */
+static int fire_cnt;
+
+/* Records that boundary event EV fired. */
+static void
+boundary_fired (struct timer_event *ev)
+{
+  int i = ev - boundary_events;
+
+  fired_at[i] = timer_ticks ();
+  fire_order[fire_cnt++] = i;
+}
+
+/* Adds timer events due one tick before, on, and one tick after
+   each of BOUNDARY_CNT multiples of WHEEL_SPAN ticks, all far
+   enough ahead to start above level 0 of the timing wheel, and
+   checks that each fires on its deadline, in order of deadline. */
+static void
+check_boundaries (void)
+{
+  int64_t base = (timer_ticks () / WHEEL_SPAN + 2) * WHEEL_SPAN;
+  int i;
+
+  /* Add them latest first, so that the order they fire in comes
+     from the wheel rather than from the order they were added. */
+  for (i = 3 * BOUNDARY_CNT - 1; i >= 0; i--)
+    {
+      boundary_deadlines[i] = base + (i / 3) * WHEEL_SPAN + i % 3 - 1;
+      timer_event_init (&boundary_events[i]);
+      timer_event_add (&boundary_events[i], boundary_deadlines[i],
+                       boundary_fired);
+    }
+  timer_sleep (boundary_deadlines[3 * BOUNDARY_CNT - 1] + 1
+               - timer_ticks ());
+
+  if (fire_cnt != 3 * BOUNDARY_CNT)
+    fail ("%d of %d boundary events fired", fire_cnt, 3 * BOUNDARY_CNT);
+  for (i = 0; i < 3 * BOUNDARY_CNT; i++)
+    {
+      int ev = fire_order[i];
+      if (fired_at[ev] != boundary_deadlines[ev])
+        fail ("event due at tick %lld fired at tick %lld",
+              boundary_deadlines[ev], fired_at[ev]);
+      if (i > 0 && boundary_deadlines[ev]
+                   < boundary_deadlines[fire_order[i - 1]])
+        fail ("event due at tick %lld fired after one due at tick %lld",
+              boundary_deadlines[ev], boundary_deadlines[fire_order[i - 1]]);
+    }
+  msg ("%d events on wheel boundaries fired on time and in order.",
+       fire_cnt);
+}
+
+/* Shared state for check_wakeups(). */
+static int64_t *wake_order;     /* Deadlines, in the order threads woke. */
+static int wake_cnt;            /* Number of entries in wake_order. */
+static int late_cnt;            /* Number of threads that woke early. */
+static struct semaphore done_sema;
+
+static thread_func sleeper;
+
+/* Starts SLEEPER_CNT threads, each sleeping until a different
+   deadline, and checks that each wakes up no earlier than its
+   deadline and that they wake in order of deadline. */
+static void
+check_wakeups (void)
+{
+  int64_t start = timer_ticks () + 100;
+  int64_t *deadlines;
+  int i;
+
+  wake_order = malloc (sizeof *wake_order * SLEEPER_CNT);
+  deadlines = malloc (sizeof *deadlines * SLEEPER_CNT);
+  if (wake_order == NULL || deadlines == NULL)
+    fail ("couldn't allocate memory for %d sleepers", SLEEPER_CNT);
+  sema_init (&done_sema, 0);
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    {
+      char name[16];
+      deadlines[i] = start + (i * 37) % 300;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, &deadlines[i])
+          == TID_ERROR)
+        fail ("could not create sleeper %d", i);
+    }
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done_sema);
+
+  if (late_cnt != 0)
+    fail ("%d sleepers woke up before their deadline", late_cnt);
+  for (i = 1; i < wake_cnt; i++)
+    if (wake_order[i] < wake_order[i - 1])
+      fail ("sleeper with deadline %lld woke after one with deadline %lld",
+            wake_order[i - 1], wake_order[i]);
+  msg ("%d sleepers woke up in order.", wake_cnt);
+
+  free (deadlines);
+  free (wake_order);
+}
+
+/* Sleeps until the tick that DEADLINE_ points to, then records
+   it. */
+static void
+sleeper (void *deadline_)
+{
+  int64_t deadline = *(int64_t *) deadline_;
+  enum intr_level old_level;
+
+  timer_sleep (deadline - timer_ticks ());
+
+  old_level = intr_disable ();
+  if (timer_ticks () < deadline)
+    late_cnt++;
+  wake_order[wake_cnt++] = deadline;
+  intr_set_level (old_level);
+
+  sema_up (&done_sema);
+}
@@ -0,0 +1,53 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run:
+#
+# (alarm-scale)    10 pending events: 96 cycles per insert, 41 cycles per cancel
+# (alarm-scale)   100 pending events: 98 cycles per insert, 40 cycles per cancel
+# (alarm-scale)  1000 pending events: 97 cycles per insert, 42 cycles per cancel
+# (alarm-scale) 10000 pending events: 99 cycles per insert, 41 cycles per cancel
+# (alarm-scale) 12 events on wheel boundaries fired on time and in order.
+# (alarm-scale) 1000 sleepers woke up in order.
+#
+# Neither cost may be more than three times as high with 10000
+# pending events as with 10; the costs are small enough that a few
+# cache misses show.  The idle thread must have skipped some ticks
+# while the sleepers waited.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+my ($skipped) = map (/^Timer: \d+ ticks, (\d+) skipped while idle$/, @output);
+fail "missing count of ticks skipped while idle" unless defined $skipped;
+fail "no ticks were skipped while idle\n" unless $skipped > 0;
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(alarm-scale) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(alarm-scale) end', @output);
+
+my (%insert, %cancel);
+foreach my $cnt (10, 100, 1000, 10000) {
+    ($insert{$cnt}, $cancel{$cnt}) = map (/^\(alarm-scale\) +$cnt pending events: (\d+) cycles per insert, (\d+) cycles per cancel$/, @output);
+    fail "missing measurement for $cnt pending events"
+      unless defined $cancel{$cnt};
+}
+fail "an insert costs $insert{10000} cycles with 10000 pending events, "
+  . "more than three times the $insert{10} with 10\n"
+  if $insert{10000} > 3 * $insert{10};
+fail "a cancel costs $cancel{10000} cycles with 10000 pending events, "
+  . "more than three times the $cancel{10} with 10\n"
+  if $cancel{10000} > 3 * $cancel{10};
+fail "events on wheel boundaries did not all fire on time and in order"
+  unless grep ($_ eq '(alarm-scale) 12 events on wheel boundaries fired on time and in order.', @output);
+fail "sleepers did not all wake up in order"
+  unless grep ($_ eq '(alarm-scale) 1000 sleepers woke up in order.', @output);
+
+pass;
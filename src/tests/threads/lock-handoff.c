@@ -0,0 +1,100 @@
+/* Measures the cost of acquiring a lock, with and without
+   adaptive spinning.
+
+   First times uncontended acquire/release pairs in a single
+   thread.  Then two threads repeatedly take turns holding one
+   lock for a short critical section, and we time the average
+   cost of each handoff, once with lock_adaptive off, so that a
+   waiter always blocks, and once with it on.  With more than one
+   CPU, spinning should make handoffs much cheaper, since the
+   waiter no longer has to go through the scheduler twice.  Run
+   with "pintos --smp=2" to see the effect. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define UNCONTENDED_CNT 10000   /* Uncontended pairs timed. */
+#define HANDOFF_CNT 2000        /* Critical sections per thread. */
+#define HOLD_LOOPS 200          /* Loop iterations with lock held. */
+#define AWAY_LOOPS 50           /* Loop iterations without lock. */
+
+static thread_func contender;
+static uint64_t measure_handoffs (bool adaptive);
+
+static struct lock lock;
+static struct semaphore done_sema;
+static volatile int shared;
+
+void
+test_lock_handoff (void)
+{
+  bool old_adaptive = lock_adaptive;
+  uint64_t start, cycles;
+  int i;
+
+  lock_init (&lock);
+  sema_init (&done_sema, 0);
+  msg ("%u CPUs online.", cpu_cnt);
+
+  start = timer_cycles ();
+  for (i = 0; i < UNCONTENDED_CNT; i++)
+    {
+      lock_acquire (&lock);
+      lock_release (&lock);
+    }
+  cycles = (timer_cycles () - start) / UNCONTENDED_CNT;
+  msg ("uncontended: %llu cycles per acquire", cycles);
+
+  msg ("contended, blocking: %llu cycles per handoff",
+       measure_handoffs (false));
+  msg ("contended, adaptive: %llu cycles per handoff",
+       measure_handoffs (true));
+
+  lock_adaptive = old_adaptive;
+  if (shared != 4 * HANDOFF_CNT)
+    fail ("critical sections overlapped: count is %d, not %d",
+          shared, 4 * HANDOFF_CNT);
+}
+
+/* Runs two contending threads with lock_adaptive set to
+   ADAPTIVE, and returns the average cycles per critical
+   section. */
+static uint64_t
+measure_handoffs (bool adaptive)
+{
+  uint64_t start;
+  int i;
+
+  lock_adaptive = adaptive;
+  start = timer_cycles ();
+  for (i = 0; i < 2; i++)
+    thread_create ("contender", PRI_DEFAULT, contender, NULL);
+  for (i = 0; i < 2; i++)
+    sema_down (&done_sema);
+  return (timer_cycles () - start) / (2 * HANDOFF_CNT);
+}
+
+/* Repeatedly takes the lock for a short critical section. */
+static void
+contender (void *aux UNUSED)
+{
+  int i, j;
+
+  for (i = 0; i < HANDOFF_CNT; i++)
+    {
+      lock_acquire (&lock);
+      for (j = 0; j < HOLD_LOOPS; j++)
+        barrier ();
+      shared++;
+      lock_release (&lock);
+
+      for (j = 0; j < AWAY_LOOPS; j++)
+        barrier ();
+    }
+  sema_up (&done_sema);
+}
@@ -0,0 +1,40 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run:
+#
+# (lock-handoff) 2 CPUs online.
+# (lock-handoff) uncontended: 118 cycles per acquire
+# (lock-handoff) contended, blocking: 9421 cycles per handoff
+# (lock-handoff) contended, adaptive: 1377 cycles per handoff
+#
+# With more than one CPU, spinning must make handoffs cheaper.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(lock-handoff) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(lock-handoff) end', @output);
+my ($cpus) = map (/^\(lock-handoff\) (\d+) CPUs online\.$/, @output);
+fail "missing CPU count" unless defined $cpus;
+fail "missing uncontended measurement"
+  unless grep (/^\(lock-handoff\) uncontended: \d+ cycles per acquire$/, @output);
+my (%cycles);
+foreach my $mode ('blocking', 'adaptive') {
+    ($cycles{$mode}) = map (/^\(lock-handoff\) contended, $mode: (\d+) cycles per handoff$/, @output);
+    fail "missing $mode measurement" unless defined $cycles{$mode};
+}
+fail "adaptive handoffs took $cycles{adaptive} cycles on $cpus CPUs, "
+  . "no fewer than the $cycles{blocking} of blocking ones\n"
+  if $cpus > 1 && $cycles{adaptive} >= $cycles{blocking};
+
+pass;
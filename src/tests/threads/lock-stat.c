@@ -0,0 +1,46 @@
+/* Checks that lock profiling counts acquisitions and contention.
+
+   The main thread takes a named lock, then creates a
+   higher-priority thread that blocks on it.  Releasing the lock
+   hands it to that thread, after which the main thread takes it
+   once more without contention.  Run with "-o=lockstat"; the
+   profile printed at shutdown should show 3 acquisitions, 1 of
+   them contended. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func contender;
+
+static struct lock lock;
+
+void
+test_lock_stat (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* This test needs lock profiling. */
+  ASSERT (lock_profiling);
+
+  lock_init_named (&lock, "lock-stat");
+  lock_acquire (&lock);
+  thread_create ("contender", PRI_DEFAULT + 1, contender, NULL);
+  msg ("Contender is waiting.");
+  lock_release (&lock);
+
+  lock_acquire (&lock);
+  msg ("Main thread acquired the lock again.");
+  lock_release (&lock);
+}
+
+static void
+contender (void *aux UNUSED)
+{
+  lock_acquire (&lock);
+  msg ("Contender acquired the lock.");
+  lock_release (&lock);
+}
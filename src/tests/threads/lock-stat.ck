@@ -0,0 +1,30 @@
+# -*- perl -*-
+
+# Besides the test's own messages, the output should contain a
+# lock profile line like this, with the times varying from run
+# to run:
+#
+#   lock-stat                 3          1           25            3
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+fail "missing lock profile"
+  unless grep ($_ eq 'Lock profile:', @output);
+fail "wrong profile for test lock"
+  unless grep (/^  lock-stat +3 +1 +\d+ +\d+$/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(lock-stat) begin
+(lock-stat) Contender is waiting.
+(lock-stat) Contender acquired the lock.
+(lock-stat) Main thread acquired the lock again.
+(lock-stat) end
+EOF
+
+pass;
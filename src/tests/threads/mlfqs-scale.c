@@ -0,0 +1,85 @@
+/* Measures how the cost of the timer interrupt scales with the
+   number of threads under the MLFQS.
+
+   First records the most cycles spent in a single timer
+   interrupt over 2 seconds with no other threads, then starts
+   500 threads that each wake up once a second and spin briefly,
+   and records the worst case again over 5 seconds that include
+   several load_avg updates.  The sleepers' wake-ups are spread
+   evenly over the second, so that the same few threads wake up
+   in each tick whatever the number of sleepers.  Because only
+   running and ready threads have their recent_cpu and priority
+   updated by the timer interrupt, the worst case should not grow
+   with the number of sleeping threads. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 500
+#define SPIN_CNT 1000
+
+static thread_func sleeper;
+
+static int64_t start_time;              /* When sleepers start. */
+static int64_t end_time;                /* When sleepers stop. */
+static struct semaphore done_sema;      /* Upped by each exiting sleeper. */
+
+void
+test_mlfqs_scale (void)
+{
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&done_sema, 0);
+
+  timer_reset_worst_cycles ();
+  timer_sleep (2 * TIMER_FREQ);
+  msg ("Worst timer interrupt with no sleepers: %llu cycles.",
+       timer_worst_cycles ());
+
+  msg ("Starting %d sleepers...", THREAD_CNT);
+  start_time = timer_ticks ();
+  end_time = start_time + 8 * TIMER_FREQ;
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, (void *) i) == TID_ERROR)
+        fail ("could not create sleeper %d", i);
+    }
+
+  timer_sleep (TIMER_FREQ);
+  timer_reset_worst_cycles ();
+  timer_sleep (5 * TIMER_FREQ);
+  msg ("Worst timer interrupt with %d sleepers: %llu cycles.",
+       THREAD_CNT, timer_worst_cycles ());
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done_sema);
+  msg ("All sleepers finished.");
+}
+
+/* Wakes up once a second, at a tick of the second that depends
+   on ID, until end_time. */
+static void
+sleeper (void *id_)
+{
+  int id = (int) id_;
+  int64_t wake_time = start_time + 1 + id % TIMER_FREQ;
+
+  while (wake_time < end_time)
+    {
+      volatile int i;
+
+      timer_sleep (wake_time - timer_ticks ());
+      for (i = 0; i < SPIN_CNT; i++)
+        continue;
+      wake_time += TIMER_FREQ;
+    }
+  sema_up (&done_sema);
+}
@@ -0,0 +1,36 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run:
+#
+# (mlfqs-scale) Worst timer interrupt with no sleepers: 5120 cycles.
+# (mlfqs-scale) Starting 500 sleepers...
+# (mlfqs-scale) Worst timer interrupt with 500 sleepers: 6874 cycles.
+# (mlfqs-scale) All sleepers finished.
+#
+# The worst case with 500 sleepers may not be more than twice the
+# worst case with none.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing end in output"
+  unless grep ($_ eq '(mlfqs-scale) end', @output);
+my ($idle) = map (/^\(mlfqs-scale\) Worst timer interrupt with no sleepers: (\d+) cycles\.$/, @output);
+fail "missing measurement with no sleepers" unless defined $idle;
+my ($busy) = map (/^\(mlfqs-scale\) Worst timer interrupt with 500 sleepers: (\d+) cycles\.$/, @output);
+fail "missing measurement with 500 sleepers" unless defined $busy;
+fail "worst timer interrupt took $busy cycles with 500 sleepers, "
+  . "more than twice the $idle with none\n"
+  if $busy > 2 * $idle;
+fail "sleepers did not finish"
+  unless grep ($_ eq '(mlfqs-scale) All sleepers finished.', @output);
+
+pass;
@@ -0,0 +1,78 @@
+/* Reader threads A and B hold an rwlock shared at the same time,
+   then block downing a semaphore.  High priority writer W then
+   waits for the rwlock exclusively, donating its priority to
+   both readers.  Reader C, of medium priority, arrives after W
+   and must wait behind it even though the rwlock is only held
+   shared.
+
+   The main thread ups the semaphore twice.  A wakes up with W's
+   priority and releases the rwlock, dropping back to its own
+   priority.  B does the same, which hands the rwlock to W.  When
+   W releases it, C gets it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define READER_PRI (PRI_DEFAULT + 1)
+#define LATE_PRI (PRI_DEFAULT + 5)
+#define WRITER_PRI (PRI_DEFAULT + 10)
+
+static struct rwlock rwlock;
+static struct semaphore sema;
+
+static thread_func reader_thread_func;
+static thread_func late_reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_priority_donate_rwlock (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  sema_init (&sema, 0);
+  thread_create ("A", READER_PRI, reader_thread_func, NULL);
+  thread_create ("B", READER_PRI, reader_thread_func, NULL);
+  thread_create ("W", WRITER_PRI, writer_thread_func, NULL);
+  thread_create ("C", LATE_PRI, late_reader_thread_func, NULL);
+
+  sema_up (&sema);
+  sema_up (&sema);
+  msg ("Main thread finished.");
+}
+
+static void
+reader_thread_func (void *aux UNUSED)
+{
+  rwlock_acquire_shared (&rwlock);
+  msg ("Thread %s acquired rwlock shared.", thread_name ());
+  sema_down (&sema);
+  msg ("Thread %s has priority %d.", thread_name (), thread_get_priority ());
+  rwlock_release_shared (&rwlock);
+  msg ("Thread %s released rwlock, priority %d.",
+       thread_name (), thread_get_priority ());
+}
+
+static void
+late_reader_thread_func (void *aux UNUSED)
+{
+  rwlock_acquire_shared (&rwlock);
+  msg ("Thread C acquired rwlock shared.");
+  rwlock_release_shared (&rwlock);
+}
+
+static void
+writer_thread_func (void *aux UNUSED)
+{
+  rwlock_acquire_exclusive (&rwlock);
+  msg ("Thread W acquired rwlock exclusively.");
+  rwlock_release_exclusive (&rwlock);
+  msg ("Thread W finished.");
+}
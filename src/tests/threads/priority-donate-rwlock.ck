@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rwlock) begin
+(priority-donate-rwlock) Thread A acquired rwlock shared.
+(priority-donate-rwlock) Thread B acquired rwlock shared.
+(priority-donate-rwlock) Thread A has priority 41.
+(priority-donate-rwlock) Thread A released rwlock, priority 32.
+(priority-donate-rwlock) Thread B has priority 41.
+(priority-donate-rwlock) Thread W acquired rwlock exclusively.
+(priority-donate-rwlock) Thread W finished.
+(priority-donate-rwlock) Thread C acquired rwlock shared.
+(priority-donate-rwlock) Thread B released rwlock, priority 32.
+(priority-donate-rwlock) Main thread finished.
+(priority-donate-rwlock) end
+EOF
+pass;
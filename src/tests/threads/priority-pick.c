@@ -0,0 +1,121 @@
+/* Measures how the cost of scheduling decisions scales with the
+   number of ready threads.
+
+   For 10, 100 and 1000 ready threads spread across the priority
+   levels below PRI_DEFAULT, the main thread runs at PRI_MAX and
+   times two operations with the CPU's cycle counter:
+
+     - thread_yield(), which puts the main thread back on the run
+       queue and picks the highest-priority ready thread (the main
+       thread again);
+
+     - sema_up() on a semaphore that a low-priority "probe" thread
+       is waiting on, which makes the probe ready behind every
+       other ready thread.
+
+   With an O(1) run queue neither cost should grow with the
+   number of ready threads. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define YIELD_CNT 1000          /* Yields timed per round. */
+#define PROBE_CNT 16            /* Wake-ups timed per round. */
+#define PROBE_PRI (PRI_MIN + 1) /* Priority of the probe threads. */
+
+static thread_func probe_thread;
+static thread_func ready_thread;
+
+static struct semaphore probe_sema;     /* Probes wait here. */
+static struct semaphore done_sema;      /* Upped by each exiting thread. */
+
+static void measure (int ready_cnt);
+
+void
+test_priority_pick (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&probe_sema, 0);
+  sema_init (&done_sema, 0);
+
+  measure (10);
+  measure (100);
+  measure (1000);
+
+  thread_set_priority (PRI_DEFAULT);
+}
+
+/* Times yields and wake-ups with READY_CNT threads in the run
+   queue, then lets every thread it created run to completion. */
+static void
+measure (int ready_cnt)
+{
+  uint64_t yield_cycles, wake_cycles, start;
+  int i;
+
+  /* Create the probes and drop below them, so that each one runs
+     and blocks on PROBE_SEMA before we take our measurements. */
+  for (i = 0; i < PROBE_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "probe %d", i);
+      if (thread_create (name, PROBE_PRI, probe_thread, NULL) == TID_ERROR)
+        fail ("could not create probe thread %d", i);
+    }
+  thread_set_priority (PRI_MIN);
+  thread_set_priority (PRI_MAX);
+
+  /* Fill the run queue with threads above the probes.  They do
+     not run until we block at the end of this round. */
+  for (i = 0; i < ready_cnt; i++)
+    {
+      char name[16];
+      int priority = PROBE_PRI + 1 + i % (PRI_DEFAULT - PROBE_PRI);
+      snprintf (name, sizeof name, "ready %d", i);
+      if (thread_create (name, priority, ready_thread, NULL) == TID_ERROR)
+        fail ("could not create ready thread %d", i);
+    }
+
+  start = timer_cycles ();
+  for (i = 0; i < YIELD_CNT; i++)
+    thread_yield ();
+  yield_cycles = (timer_cycles () - start) / YIELD_CNT;
+
+  wake_cycles = 0;
+  for (i = 0; i < PROBE_CNT; i++)
+    {
+      start = timer_cycles ();
+      sema_up (&probe_sema);
+      wake_cycles += timer_cycles () - start;
+    }
+  wake_cycles /= PROBE_CNT;
+
+  msg ("%4d ready threads: %llu cycles per yield, %llu cycles per wake-up",
+       ready_cnt, yield_cycles, wake_cycles);
+
+  /* Let everything we created run to completion. */
+  for (i = 0; i < ready_cnt + PROBE_CNT; i++)
+    sema_down (&done_sema);
+}
+
+static void
+probe_thread (void *aux UNUSED)
+{
+  sema_down (&probe_sema);
+  sema_up (&done_sema);
+}
+
+static void
+ready_thread (void *aux UNUSED)
+{
+  sema_up (&done_sema);
+}
@@ -0,0 +1,41 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run:
+#
+# (priority-pick)   10 ready threads: 412 cycles per yield, 198 cycles per wake-up
+# (priority-pick)  100 ready threads: 415 cycles per yield, 201 cycles per wake-up
+# (priority-pick) 1000 ready threads: 409 cycles per yield, 203 cycles per wake-up
+#
+# Neither cost may be more than twice as high with 1000 ready
+# threads as with 10.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(priority-pick) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(priority-pick) end', @output);
+
+my (%yield, %wake);
+foreach my $cnt (10, 100, 1000) {
+    ($yield{$cnt}, $wake{$cnt}) = map (/^\(priority-pick\) +$cnt ready threads: (\d+) cycles per yield, (\d+) cycles per wake-up$/, @output);
+    fail "missing measurement for $cnt ready threads"
+      unless defined $wake{$cnt};
+}
+fail "a yield costs $yield{1000} cycles with 1000 ready threads, "
+  . "more than twice the $yield{10} with 10\n"
+  if $yield{1000} > 2 * $yield{10};
+fail "a wake-up costs $wake{1000} cycles with 1000 ready threads, "
+  . "more than twice the $wake{10} with 10\n"
+  if $wake{1000} > 2 * $wake{10};
+
+pass;
@@ -0,0 +1,26 @@
+/* Checks that the sampling profiler records where the CPU is
+   busy.  Spins in a loop for a number of timer ticks; run with
+   "-o=profile", the profile printed at shutdown should then
+   count at least most of those ticks as kernel samples. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/profile.h"
+#include "devices/timer.h"
+
+#define SPIN_TICKS 50
+
+void
+test_profile_sample (void)
+{
+  int64_t start;
+
+  /* This test needs the sampling profiler. */
+  ASSERT (profile_period == 1);
+
+  msg ("Spinning for %d ticks.", SPIN_TICKS);
+  start = timer_ticks ();
+  while (timer_elapsed (start) < SPIN_TICKS)
+    continue;
+  msg ("Done spinning.");
+}
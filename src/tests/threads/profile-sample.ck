@@ -0,0 +1,37 @@
+# -*- perl -*-
+
+# Besides the test's own messages, the output should contain a
+# profile like this, with the counts and addresses varying from
+# run to run:
+#
+# Profile: 57 kernel samples, 0 user samples, 3 idle, 0 lost
+# Profile hot spots (samples per address, for utils/backtrace):
+#   0xc002a1b3 31
+#   0xc0023f1e 19
+#   ...
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+my ($summary) = grep (/^Profile: \d+ kernel samples/, @output);
+fail "missing profile summary" unless defined $summary;
+my ($kernel) = $summary =~ /^Profile: (\d+) kernel samples, \d+ user samples, \d+ idle, \d+ lost$/
+  or fail "malformed profile summary: $summary";
+fail "only $kernel kernel samples while spinning for 50 ticks"
+  if $kernel < 40;
+fail "missing profile hot spots"
+  unless grep (/^  0x[0-9a-f]{8} \d+$/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(profile-sample) begin
+(profile-sample) Spinning for 50 ticks.
+(profile-sample) Done spinning.
+(profile-sample) end
+EOF
+
+pass;
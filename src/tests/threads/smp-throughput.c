@@ -0,0 +1,87 @@
+/* Measures how the throughput of CPU-bound threads scales with
+   the number of CPUs.
+
+   First finds a number of loop iterations that takes one thread
+   at least MIN_TICKS timer ticks, then times 1, 2, 4 and 8
+   threads that each run that many iterations.  With enough CPUs
+   and no shared state between the threads, the elapsed time
+   should stay roughly constant up to the number of CPUs, so that
+   the speedup over one thread grows almost linearly.  Run with
+   "pintos --smp=4" to see the effect. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define MIN_TICKS (TIMER_FREQ / 2)      /* Minimum single-thread time. */
+#define MAX_THREADS 8                   /* Most threads timed at once. */
+
+static thread_func worker;
+static int64_t run_workers (int thread_cnt);
+
+static unsigned iterations;             /* Loop iterations per worker. */
+static struct semaphore done_sema;      /* Upped by each exiting worker. */
+
+void
+test_smp_throughput (void)
+{
+  int64_t base;
+  int thread_cnt;
+
+  sema_init (&done_sema, 0);
+  msg ("%u CPUs online.", cpu_cnt);
+
+  for (iterations = 1 << 16; ; iterations *= 2)
+    {
+      base = run_workers (1);
+      if (base >= MIN_TICKS)
+        break;
+    }
+
+  for (thread_cnt = 1; thread_cnt <= MAX_THREADS; thread_cnt *= 2)
+    {
+      int64_t elapsed = thread_cnt == 1 ? base : run_workers (thread_cnt);
+      int speedup = elapsed > 0 ? thread_cnt * base * 100 / elapsed : 0;
+
+      msg ("%d threads: %lld ticks, speedup %d.%02d",
+           thread_cnt, elapsed, speedup / 100, speedup % 100);
+    }
+}
+
+/* Runs THREAD_CNT workers and returns the ticks until the last
+   one is done. */
+static int64_t
+run_workers (int thread_cnt)
+{
+  int64_t start = timer_ticks ();
+  int i;
+
+  for (i = 0; i < thread_cnt; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "worker %d", i);
+      if (thread_create (name, PRI_DEFAULT, worker, NULL) == TID_ERROR)
+        fail ("could not create worker %d", i);
+    }
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&done_sema);
+
+  return timer_elapsed (start);
+}
+
+/* Spins for ITERATIONS iterations of a loop that touches nothing
+   but registers and its own stack. */
+static void
+worker (void *aux UNUSED)
+{
+  volatile unsigned x = 0;
+  unsigned i;
+
+  for (i = 0; i < iterations; i++)
+    x += i * 2654435761u;
+  sema_up (&done_sema);
+}
@@ -0,0 +1,43 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the tick counts
+# varying from run to run and the speedups depending on the
+# number of CPUs (here, 4):
+#
+# (smp-throughput) 4 CPUs online.
+# (smp-throughput) 1 threads: 52 ticks, speedup 1.00
+# (smp-throughput) 2 threads: 53 ticks, speedup 1.96
+# (smp-throughput) 4 threads: 55 ticks, speedup 3.78
+# (smp-throughput) 8 threads: 108 ticks, speedup 3.85
+#
+# Throughput must scale nearly linearly with the number of CPUs:
+# with at least two CPUs, two threads must run at least 1.7 times
+# as fast as one, and with at least four, four threads at least
+# 3.0 times as fast.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing end in output"
+  unless grep ($_ eq '(smp-throughput) end', @output);
+my ($cpus) = map (/^\(smp-throughput\) (\d+) CPUs online\.$/, @output);
+fail "missing CPU count" unless defined $cpus;
+my (%speedup);
+foreach my $cnt (1, 2, 4, 8) {
+    ($speedup{$cnt}) = map (/^\(smp-throughput\) $cnt threads: \d+ ticks, speedup (\d+\.\d\d)$/, @output);
+    fail "missing measurement for $cnt threads"
+      unless defined $speedup{$cnt};
+}
+fail "2 threads on $cpus CPUs ran only $speedup{2} times as fast as 1\n"
+  if $cpus >= 2 && $speedup{2} < 1.7;
+fail "4 threads on $cpus CPUs ran only $speedup{4} times as fast as 1\n"
+  if $cpus >= 4 && $speedup{4} < 3.0;
+
+pass;
@@ -18,11 +18,19 @@ static const struct test tests[] =
     {"priority-donate-nest", test_priority_donate_nest},
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
+    {"priority-donate-rwlock", test_priority_donate_rwlock},
     {"priority-donate-chain", test_priority_donate_chain},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-pick", test_priority_pick},
+    {"smp-throughput", test_smp_throughput},
+    {"alarm-scale", test_alarm_scale},
+    {"alarm-hires", test_alarm_hires},
+    {"lock-handoff", test_lock_handoff},
+    {"lock-stat", test_lock_stat},
+    {"profile-sample", test_profile_sample},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -32,6 +40,7 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-scale", test_mlfqs_scale},
   };
 
 static const char *test_name;
@@ -12,11 +12,19 @@ extern test_func test_priority_donate_multiple2;
 extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
+extern test_func test_priority_donate_rwlock;
 extern test_func test_priority_donate_chain;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_pick;
+extern test_func test_smp_throughput;
+extern test_func test_alarm_scale;
+extern test_func test_alarm_hires;
+extern test_func test_lock_handoff;
+extern test_func test_lock_stat;
+extern test_func test_profile_sample;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -26,6 +34,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_scale;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,48 @@
+/* Child process of page-share.
+   Reads through 16 pages of read-only data, which lives in the
+   executable's text segment, and checks them.  Then spins for a
+   while, so that its siblings run while its pages are still
+   mapped, and checks them again. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+const char *test_name = "child-share";
+
+#define TABLE_PAGES 16
+#define TABLE_SIZE (TABLE_PAGES * 4096)
+
+/* Initialized, so that it is read from the executable.  Only the
+   first byte of each page is set, which check() relies on. */
+#define PAGE_START(N) [(N) * 4096] = (N) + 1
+static const unsigned char table[TABLE_SIZE] =
+  {
+    PAGE_START (0), PAGE_START (1), PAGE_START (2), PAGE_START (3),
+    PAGE_START (4), PAGE_START (5), PAGE_START (6), PAGE_START (7),
+    PAGE_START (8), PAGE_START (9), PAGE_START (10), PAGE_START (11),
+    PAGE_START (12), PAGE_START (13), PAGE_START (14), PAGE_START (15),
+  };
+
+/* Checks that TABLE holds what it was initialized to. */
+static void
+check (void)
+{
+  size_t i;
+
+  for (i = 0; i < TABLE_SIZE; i++)
+    if (table[i] != (i % 4096 == 0 ? i / 4096 + 1 : 0))
+      fail ("byte %zu of table is %d", i, table[i]);
+}
+
+int
+main (void)
+{
+  volatile int spin;
+
+  check ();
+  for (spin = 0; spin < 20000000; spin++)
+    continue;
+  check ();
+
+  return 0x42;
+}
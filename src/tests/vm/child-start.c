@@ -0,0 +1,58 @@
+/* Child process of exec-latency.
+   Notes the time at which main() is reached, then reads through
+   32 pages of read-only data, as a short-lived helper program
+   would run through its text.  Exits with the number of cycles
+   from the time-stamp given as its argument to main(). */
+
+#include <limits.h>
+#include <stdint.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-start";
+
+#define TABLE_PAGES 32
+#define TABLE_SIZE (TABLE_PAGES * 4096)
+
+/* Initialized, so that it is read from the executable.  Only the
+   first byte of each page is set. */
+#define PAGE_START(N) [(N) * 4096] = (N) + 1
+static const unsigned char table[TABLE_SIZE] =
+  {
+    PAGE_START (0), PAGE_START (1), PAGE_START (2), PAGE_START (3),
+    PAGE_START (4), PAGE_START (5), PAGE_START (6), PAGE_START (7),
+    PAGE_START (8), PAGE_START (9), PAGE_START (10), PAGE_START (11),
+    PAGE_START (12), PAGE_START (13), PAGE_START (14), PAGE_START (15),
+    PAGE_START (16), PAGE_START (17), PAGE_START (18), PAGE_START (19),
+    PAGE_START (20), PAGE_START (21), PAGE_START (22), PAGE_START (23),
+    PAGE_START (24), PAGE_START (25), PAGE_START (26), PAGE_START (27),
+    PAGE_START (28), PAGE_START (29), PAGE_START (30), PAGE_START (31),
+  };
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint64_t now = rdtsc ();
+  uint64_t start = 0;
+  const char *p;
+  size_t i;
+
+  if (argc != 2)
+    fail ("usage: child-start TSC");
+  for (p = argv[1]; *p >= '0' && *p <= '9'; p++)
+    start = start * 10 + (*p - '0');
+
+  for (i = 0; i < TABLE_PAGES; i++)
+    if (table[i * 4096] != i + 1)
+      fail ("page %zu of table is wrong", i);
+
+  return now - start < INT_MAX ? (int) (now - start) : INT_MAX;
+}
@@ -0,0 +1,38 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run, and with an exit line for each child
+# mixed in:
+#
+# (exec-lat-nopf) exec to main: 1234567 cycles
+# (exec-lat-nopf) exec to exit: 3456789 cycles
+#
+# With prefetch and fault-around off, the statistics printed at
+# shutdown should be:
+#
+# Prefetch: 0 pages read ahead of exec, 0 mapped by fault-around
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+fail "prefetch was not turned off"
+  unless grep ($_ eq 'Prefetch: 0 pages read ahead of exec, 0 mapped by fault-around', @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(exec-lat-nopf) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(exec-lat-nopf) end', @output);
+fail "missing exec to main measurement"
+  unless grep (/^\(exec-lat-nopf\) exec to main: \d+ cycles$/, @output);
+fail "missing exec to exit measurement"
+  unless grep (/^\(exec-lat-nopf\) exec to exit: \d+ cycles$/, @output);
+fail "child failed"
+  if grep (/^child-start: exit\(-/, @output);
+
+pass;
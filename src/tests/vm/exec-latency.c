@@ -0,0 +1,53 @@
+/* Times how long a freshly exec'd program takes to reach main(),
+   and to run to completion, averaged over several runs of
+   child-start.  Each run starts with none of child-start's pages
+   resident, since they are dropped when the previous run exits.
+
+   exec-lat-nopf repeats the measurement with exec-time prefetch
+   and fault-around turned off. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RUNS 8
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+void
+test_main (void)
+{
+  uint64_t to_main = 0, to_exit = 0;
+  int run;
+
+  for (run = 0; run < RUNS; run++)
+    {
+      char cmd[64];
+      uint64_t start = rdtsc ();
+      pid_t pid;
+      int cycles;
+
+      snprintf (cmd, sizeof cmd, "child-start %llu",
+                (unsigned long long) start);
+      pid = exec (cmd);
+      if (pid == PID_ERROR)
+        fail ("exec \"child-start\" failed");
+      cycles = wait (pid);
+      to_exit += rdtsc () - start;
+      if (cycles < 0)
+        fail ("child-start failed");
+      to_main += cycles;
+    }
+
+  msg ("exec to main: %llu cycles", (unsigned long long) (to_main / RUNS));
+  msg ("exec to exit: %llu cycles", (unsigned long long) (to_exit / RUNS));
+}
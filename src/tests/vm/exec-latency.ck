@@ -0,0 +1,43 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run, and with an exit line for each child
+# mixed in:
+#
+# (exec-latency) exec to main: 1234567 cycles
+# (exec-latency) exec to exit: 2345678 cycles
+#
+# The prefetch statistics printed at shutdown look like this:
+#
+# Prefetch: 96 pages read ahead of exec, 180 mapped by fault-around
+#
+# Some pages must have been read ahead of exec.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+my ($prefetched) = get_measurement
+  ("prefetch statistics",
+   qr/^Prefetch: (\d+) pages read ahead of exec, \d+ mapped by fault-around$/,
+   @output);
+fail "no pages were read ahead of exec\n" unless $prefetched > 0;
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(exec-latency) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(exec-latency) end', @output);
+fail "missing exec to main measurement"
+  unless grep (/^\(exec-latency\) exec to main: \d+ cycles$/, @output);
+fail "missing exec to exit measurement"
+  unless grep (/^\(exec-latency\) exec to exit: \d+ cycles$/, @output);
+fail "child failed"
+  if grep (/^child-start: exit\(-/, @output);
+
+pass;
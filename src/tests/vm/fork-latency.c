@@ -0,0 +1,86 @@
+/* Times fork() with a small and with a large resident set.
+
+   The parent makes 1 page, and then 256 pages, of an array
+   resident and forks repeatedly, timing each fork() until it
+   returns in the parent.  Since fork() shares the pages
+   copy-on-write instead of copying them, both should cost about
+   the same.  Each child checks that it sees the parent's data and
+   then overwrites it, which the parent must not see. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define BIG_PAGES 256
+#define FORKS 16
+
+static char array[BIG_PAGES * PAGE_SIZE];
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Child: checks the first PAGES pages of the array, then scribbles
+   on them. */
+static void
+child (size_t pages)
+{
+  size_t i;
+
+  for (i = 0; i < pages; i++)
+    if (array[i * PAGE_SIZE] != (char) i)
+      exit (1);
+  for (i = 0; i < pages; i++)
+    array[i * PAGE_SIZE] = (char) ~i;
+  exit (0);
+}
+
+/* Forks FORKS times with the first PAGES pages of the array
+   resident and returns the average cycles per fork(). */
+static uint64_t
+time_forks (size_t pages)
+{
+  uint64_t cycles = 0;
+  size_t i;
+  int f;
+
+  for (i = 0; i < pages; i++)
+    array[i * PAGE_SIZE] = (char) i;
+
+  for (f = 0; f < FORKS; f++)
+    {
+      uint64_t start = rdtsc ();
+      pid_t pid = fork ();
+      if (pid == 0)
+        child (pages);
+      cycles += rdtsc () - start;
+
+      if (pid == PID_ERROR)
+        fail ("fork failed");
+      if (wait (pid) != 0)
+        fail ("child did not see the parent's pages");
+      for (i = 0; i < pages; i++)
+        if (array[i * PAGE_SIZE] != (char) i)
+          fail ("page %zu was changed by the child", i);
+    }
+  return cycles / FORKS;
+}
+
+void
+test_main (void)
+{
+  uint64_t small = time_forks (1);
+  uint64_t big = time_forks (BIG_PAGES);
+
+  msg ("fork with %d page resident: %llu cycles", 1,
+       (unsigned long long) small);
+  msg ("fork with %d pages resident: %llu cycles", BIG_PAGES,
+       (unsigned long long) big);
+}
@@ -0,0 +1,40 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run, and with an exit line for each child
+# mixed in:
+#
+# (fork-latency) fork with 1 page resident: 412345 cycles
+# (fork-latency) fork with 256 pages resident: 498765 cycles
+#
+# Since fork() copies no pages, the large fork may cost no more
+# than twice the small one.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(fork-latency) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(fork-latency) end', @output);
+my ($small) = get_measurement
+  ("small measurement", qr/^\(fork-latency\) fork with 1 page resident: (\d+) cycles$/,
+   @output);
+my ($large) = get_measurement
+  ("large measurement", qr/^\(fork-latency\) fork with 256 pages resident: (\d+) cycles$/,
+   @output);
+fail "fork with 256 pages resident took $large cycles, more than "
+  . "twice the $small with 1\n"
+  if $large > 2 * $small;
+fail "child failed"
+  if grep (/^fork-latency: exit\((?!0\))/, @output);
+
+pass;
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Returns the values captured by RE from the first line of OUTPUT
+# that it matches, or fails, naming WHAT as missing.
+sub get_measurement {
+    my ($what, $re, @output) = @_;
+    foreach (@output) {
+	my (@values) = /$re/;
+	return wantarray ? @values : $values[0] if @values;
+    }
+    fail "missing $what in output\n";
+}
+
+# Returns the output of OTHER, a test in the same directory that
+# runs the same program under different conditions, for comparison.
+sub read_other_output {
+    my ($other) = @_;
+    our ($test);
+    (my $file = $test) =~ s%[^/]*$%$other.output%;
+    fail "$file missing, run $other first\n" unless -e $file;
+    return read_text_file ($file);
+}
+
+1;
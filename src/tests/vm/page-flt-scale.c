@@ -0,0 +1,60 @@
+/* Measures the cost of a page fault as the number of resident
+   pages grows.
+
+   Touches the pages of a large zeroed buffer one at a time, so
+   that each touch faults a fresh page in.  The faults taken with
+   16, 64 and 256 pages already resident are timed with the CPU's
+   time-stamp counter.  With an O(1) frame table, the cost per
+   fault should not grow with the number of resident pages. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define TIMED_FAULTS 32         /* Faults timed at each size. */
+#define MAX_RESIDENT 256        /* Pages resident at the last size. */
+
+static char buf[(MAX_RESIDENT + TIMED_FAULTS) * PAGE_SIZE];
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Touches pages FIRST through FIRST + CNT - 1 of BUF. */
+static void
+touch (size_t first, size_t cnt)
+{
+  size_t i;
+
+  for (i = first; i < first + cnt; i++)
+    buf[i * PAGE_SIZE] = 1;
+}
+
+void
+test_main (void)
+{
+  static const size_t sizes[] = {16, 64, MAX_RESIDENT};
+  size_t resident = 0;
+  size_t i;
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      uint64_t start;
+
+      touch (resident, sizes[i] - resident);
+      resident = sizes[i];
+
+      start = rdtsc ();
+      touch (resident, TIMED_FAULTS);
+      msg ("%3zu pages resident: %llu cycles per fault", resident,
+           (unsigned long long) (rdtsc () - start) / TIMED_FAULTS);
+      resident += TIMED_FAULTS;
+    }
+}
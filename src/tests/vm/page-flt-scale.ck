@@ -0,0 +1,41 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run:
+#
+# (page-flt-scale)  16 pages resident: 41234 cycles per fault
+# (page-flt-scale)  64 pages resident: 40987 cycles per fault
+# (page-flt-scale) 256 pages resident: 41502 cycles per fault
+#
+# A fault with 256 pages resident may cost no more than twice one
+# with 16, which leaves room for noise but not for a frame table
+# searched in proportion to its size.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(page-flt-scale) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(page-flt-scale) end', @output);
+
+my (%cycles);
+foreach my $cnt (16, 64, 256) {
+    $cycles{$cnt} = get_measurement
+      ("measurement with $cnt pages resident",
+       qr/^\(page-flt-scale\) +$cnt pages resident: (\d+) cycles per fault$/,
+       @output);
+}
+fail "a fault costs $cycles{256} cycles with 256 pages resident, "
+  . "more than twice the $cycles{16} with 16\n"
+  if $cycles{256} > 2 * $cycles{16};
+
+pass;
@@ -0,0 +1,52 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF2']);
+(page-share-mem) begin
+(page-share-mem) exec "child-share"
+(page-share-mem) exec "child-share"
+(page-share-mem) exec "child-share"
+(page-share-mem) exec "child-share"
+(page-share-mem) exec "child-share"
+(page-share-mem) exec "child-share"
+(page-share-mem) exec "child-share"
+(page-share-mem) exec "child-share"
+(page-share-mem) wait for child 0
+(page-share-mem) wait for child 1
+(page-share-mem) wait for child 2
+(page-share-mem) wait for child 3
+(page-share-mem) wait for child 4
+(page-share-mem) wait for child 5
+(page-share-mem) wait for child 6
+(page-share-mem) wait for child 7
+(page-share-mem) end
+EOF2
+
+# The statistics printed at shutdown look like this, with the
+# counts varying from run to run:
+#
+# Shared pages: 180 mapped, 150 already resident (frames saved)
+# Prefetch: 20 pages read ahead of exec, 12 mapped by fault-around
+#
+# The 8 children run at once in 96 pages of user memory, less than
+# their copies of the 16-page table alone would take.  Each of the
+# 7 children after the first maps the first one's frame for every
+# page of the table, either when it faults on the page or by
+# fault-around, so at least 7 * 16 frames must have been saved.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($hits) = get_measurement
+  ("shared page statistics",
+   qr/^Shared pages: \d+ mapped, (\d+) already resident \(frames saved\)$/,
+   @output);
+my ($around) = get_measurement
+  ("prefetch statistics",
+   qr/^Prefetch: \d+ pages read ahead of exec, (\d+) mapped by fault-around$/,
+   @output);
+my ($saved) = $hits + $around;
+fail "only $saved frames saved by sharing, expected at least 112\n"
+  unless $saved >= 7 * 16;
+
+pass;
@@ -0,0 +1,25 @@
+/* Runs 8 child-share processes at once.  The read-only pages of
+   their executable should be read from disk once and then mapped
+   into each of them, which the shared page statistics printed at
+   shutdown report.  page-share-mem runs it in less user memory than
+   the children would take without sharing. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 8
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK ((children[i] = exec ("child-share")) != -1,
+           "exec \"child-share\"");
+
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK (wait (children[i]) == 0x42, "wait for child %d", i);
+}
@@ -0,0 +1,42 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-share) begin
+(page-share) exec "child-share"
+(page-share) exec "child-share"
+(page-share) exec "child-share"
+(page-share) exec "child-share"
+(page-share) exec "child-share"
+(page-share) exec "child-share"
+(page-share) exec "child-share"
+(page-share) exec "child-share"
+(page-share) wait for child 0
+(page-share) wait for child 1
+(page-share) wait for child 2
+(page-share) wait for child 3
+(page-share) wait for child 4
+(page-share) wait for child 5
+(page-share) wait for child 6
+(page-share) wait for child 7
+(page-share) end
+EOF
+
+# The shared page statistics printed at shutdown look like this,
+# with the counts varying from run to run:
+#
+# Shared pages: 180 mapped, 150 already resident (frames saved)
+#
+# Every child after the first should find the pages of the table
+# resident, so some must have been.
+use tests::vm::measure;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($hits) = get_measurement
+  ("shared page statistics",
+   qr/^Shared pages: \d+ mapped, (\d+) already resident \(frames saved\)$/,
+   @output);
+fail "no shared page was already resident\n" unless $hits > 0;
+
+pass;
@@ -0,0 +1,89 @@
+/* Measures how well page replacement keeps a hot working set
+   resident while a larger buffer is scanned past it.
+
+   Each round touches every page of a small hot set, then the
+   next few pages of a large cold buffer, wrapping around.  The
+   cold buffer is much bigger than memory, so it keeps pushing
+   pages out.  CLOCK replacement should keep the hot pages, since
+   they are always accessed between two passes of the clock hand,
+   whereas FIFO replacement evicts them as readily as cold pages.
+
+   Reports the hit rate, from the page faults counted by the
+   stats system call, and the average cost of a touch, from the
+   time-stamp counter.  Built twice: page-thrash runs with the
+   default CLOCK policy and pg-thrash-fifo with "-evict=fifo". */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HOT_PAGES 64            /* Pages in the hot set. */
+#define COLD_PAGES 640          /* Pages in the cold buffer. */
+#define COLD_PER_ROUND 32       /* Cold pages touched per round. */
+#define ROUNDS 100              /* Rounds to run. */
+
+static char hot[HOT_PAGES * PAGE_SIZE];
+static char cold[COLD_PAGES * PAGE_SIZE];
+static struct thread_stats stats_buf[64];
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the number of page faults this process has taken. */
+static unsigned
+page_faults (void)
+{
+  int cnt = stats (stats_buf, sizeof stats_buf / sizeof *stats_buf);
+  int i;
+
+  /* Our thread is named after the program, as is the test. */
+  for (i = 0; i < cnt; i++)
+    if (!strcmp (stats_buf[i].name, test_name))
+      return stats_buf[i].page_faults;
+  fail ("own thread not found in stats");
+}
+
+void
+test_main (void)
+{
+  size_t cold_next = 0;
+  unsigned faults;
+  uint64_t start, cycles;
+  int round, i;
+
+  /* Fault everything in once, so that the measurement starts
+     from a full memory. */
+  memset (hot, 1, sizeof hot);
+  memset (cold, 1, sizeof cold);
+
+  faults = page_faults ();
+  start = rdtsc ();
+  for (round = 0; round < ROUNDS; round++)
+    {
+      for (i = 0; i < HOT_PAGES; i++)
+        hot[i * PAGE_SIZE]++;
+      for (i = 0; i < COLD_PER_ROUND; i++)
+        {
+          cold[cold_next * PAGE_SIZE]++;
+          cold_next = (cold_next + 1) % COLD_PAGES;
+        }
+    }
+  cycles = rdtsc () - start;
+  faults = page_faults () - faults;
+
+  {
+    unsigned touches = ROUNDS * (HOT_PAGES + COLD_PER_ROUND);
+    msg ("%u page touches, %u faults, hit rate %u%%, %llu cycles per touch",
+         touches, faults, (touches - faults) * 100 / touches,
+         (unsigned long long) cycles / touches);
+  }
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the counts varying
+# from run to run:
+#
+# (page-thrash) 9600 page touches, 3231 faults, hit rate 66%, 61234 cycles per touch
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(page-thrash) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(page-thrash) end', @output);
+fail "missing measurement"
+  unless grep (/^\(page-thrash\) 9600 page touches, \d+ faults, hit rate \d+%, \d+ cycles per touch$/, @output);
+
+pass;
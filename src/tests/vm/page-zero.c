@@ -0,0 +1,88 @@
+/* Reads a BSS array four times the size of user memory, then
+   writes to some of its pages.
+
+   The test is run with user memory limited to 128 pages.  Pages
+   of BSS are all zeros until they are written, so reading them
+   should only map the kernel's zero page, without using any
+   frames or evicting anything, so reading them all again should
+   take no page faults.  Pages that are then written must read back
+   what was written, while the others still read as zeros. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ARRAY_PAGES 512         /* 4 times the 128 pages of memory. */
+#define WRITE_STRIDE 16         /* Write to every 16th page. */
+
+static char array[ARRAY_PAGES * PAGE_SIZE];
+static struct thread_stats stats_buf[64];
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the number of page faults this process has taken. */
+static unsigned
+page_faults (void)
+{
+  int cnt = stats (stats_buf, sizeof stats_buf / sizeof *stats_buf);
+  int i;
+
+  /* Our thread is named after the program, as is the test. */
+  for (i = 0; i < cnt; i++)
+    if (!strcmp (stats_buf[i].name, test_name))
+      return stats_buf[i].page_faults;
+  fail ("own thread not found in stats");
+}
+
+/* Fails unless every page of the array reads as zeros. */
+static void
+check_zeros (void)
+{
+  size_t i;
+
+  for (i = 0; i < ARRAY_PAGES; i++)
+    if (array[i * PAGE_SIZE] != 0
+        || array[i * PAGE_SIZE + PAGE_SIZE - 1] != 0)
+      fail ("page %zu is not zeroed", i);
+}
+
+void
+test_main (void)
+{
+  uint64_t start, cycles;
+  unsigned faults;
+  size_t i;
+
+  start = rdtsc ();
+  check_zeros ();
+  cycles = rdtsc () - start;
+  msg ("read %d pages of zeros: %llu cycles per page", ARRAY_PAGES,
+       (unsigned long long) cycles / ARRAY_PAGES);
+
+  faults = page_faults ();
+  check_zeros ();
+  msg ("read them again: %u page faults", page_faults () - faults);
+
+  msg ("write every %dth page", WRITE_STRIDE);
+  for (i = 0; i < ARRAY_PAGES; i += WRITE_STRIDE)
+    array[i * PAGE_SIZE + 1] = (char) (i / WRITE_STRIDE + 1);
+
+  msg ("check %d pages", ARRAY_PAGES);
+  for (i = 0; i < ARRAY_PAGES; i++)
+    {
+      char expected = i % WRITE_STRIDE == 0 ? (char) (i / WRITE_STRIDE + 1) : 0;
+      if (array[i * PAGE_SIZE] != 0
+          || array[i * PAGE_SIZE + 1] != expected)
+        fail ("page %zu has the wrong contents", i);
+    }
+}
@@ -0,0 +1,40 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle count
+# varying from run to run:
+#
+# (page-zero) read 512 pages of zeros: 5123 cycles per page
+# (page-zero) read them again: 0 page faults
+# (page-zero) write every 16th page
+# (page-zero) check 512 pages
+#
+# The pages read are four times more than fit in memory, so if they
+# had taken frames, most would have been evicted and faulted in
+# again by the second read.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(page-zero) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(page-zero) end', @output);
+fail "missing measurement"
+  unless grep (/^\(page-zero\) read 512 pages of zeros: \d+ cycles per page$/, @output);
+my ($faults) = get_measurement
+  ("second read", qr/^\(page-zero\) read them again: (\d+) page faults$/,
+   @output);
+fail "reading the zero pages again took $faults page faults\n"
+  unless $faults == 0;
+fail "missing check"
+  unless grep ($_ eq '(page-zero) check 512 pages', @output);
+
+pass;
@@ -0,0 +1,39 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the counts varying
+# from run to run:
+#
+# (pg-thrash-fifo) 9600 page touches, 3231 faults, hit rate 66%, 61234 cycles per touch
+#
+# The hit rate must be below page-thrash's, since CLOCK keeps the
+# hot pages that FIFO evicts.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(pg-thrash-fifo) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(pg-thrash-fifo) end', @output);
+my ($fifo_rate) = get_measurement
+  ("measurement", qr/^\(pg-thrash-fifo\) 9600 page touches, \d+ faults, hit rate (\d+)%, \d+ cycles per touch$/,
+   @output);
+
+my (@base) = get_core_output ("run", read_other_output ("page-thrash"));
+my ($clock_rate) = get_measurement
+  ("page-thrash measurement", qr/^\(page-thrash\) 9600 page touches, \d+ faults, hit rate (\d+)%, \d+ cycles per touch$/,
+   @base);
+
+fail "CLOCK's hit rate ($clock_rate%) is no better than FIFO's "
+  . "($fifo_rate%)\n"
+  unless $clock_rate > $fifo_rate;
+
+pass;
@@ -0,0 +1,39 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the counts varying
+# from run to run:
+#
+# (swap-tput-sect) dirty 640 pages
+# (swap-tput-sect) read back
+# (swap-tput-sect) 512 pages swapped in, 1234 pages per second
+#
+# The rate must be below swap-tput's, which moves each page with
+# one disk request instead of one per sector.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing end in output"
+  unless grep ($_ eq '(swap-tput-sect) end', @output);
+my ($sector_rate) = get_measurement
+  ("measurement", qr/^\(swap-tput-sect\) \d+ pages swapped in, (\d+) pages per second$/,
+   @output);
+
+my (@base) = get_core_output ("run", read_other_output ("swap-tput"));
+my ($page_rate) = get_measurement
+  ("swap-tput measurement", qr/^\(swap-tput\) \d+ pages swapped in, (\d+) pages per second$/,
+   @base);
+
+fail "one request per page ($page_rate pages/s) is no faster than "
+  . "one per sector ($sector_rate pages/s)\n"
+  unless $page_rate > $sector_rate;
+
+pass;
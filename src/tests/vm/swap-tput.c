@@ -0,0 +1,99 @@
+/* Measures swap throughput in pages per second.
+
+   Dirties a buffer bigger than user memory, so that most of it
+   is written out to swap, then reads it back from the start.
+   Each read of an evicted page faults, swaps the page in and
+   pushes another one out, so the timed pass exercises both
+   directions of swap I/O.  The contents are checked as they come
+   back.
+
+   Swap-ins are counted with the stats system call and timed with
+   the CPU's time-stamp counter, whose rate is calibrated against
+   the timer ticks that the same call reports.
+
+   swap-tput-sect runs it again with one disk request per sector
+   instead of one per page, and zswap-tput with the compressed
+   swap pool in front of the disk. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define BUF_PAGES 640           /* Pages in the buffer. */
+#define CALIBRATE_TICKS 10      /* Timer ticks to calibrate over. */
+#define TIMER_FREQ 100          /* Timer ticks per second. */
+
+static char buf[BUF_PAGES * PAGE_SIZE];
+static struct thread_stats stats_buf[64];
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns this process's statistics. */
+static const struct thread_stats *
+own_stats (void)
+{
+  int cnt = stats (stats_buf, sizeof stats_buf / sizeof *stats_buf);
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    if (!strcmp (stats_buf[i].name, test_name))
+      return &stats_buf[i];
+  fail ("own thread not found in stats");
+}
+
+/* Returns the number of time-stamp counter cycles per timer
+   tick, measured by spinning for CALIBRATE_TICKS ticks. */
+static uint64_t
+cycles_per_tick (void)
+{
+  uint32_t ticks = own_stats ()->run_ticks;
+  uint64_t start;
+
+  /* Start on a tick boundary. */
+  while (own_stats ()->run_ticks == ticks)
+    continue;
+  ticks = own_stats ()->run_ticks;
+  start = rdtsc ();
+  while (own_stats ()->run_ticks < ticks + CALIBRATE_TICKS)
+    continue;
+  return (rdtsc () - start) / CALIBRATE_TICKS;
+}
+
+void
+test_main (void)
+{
+  uint64_t tick_cycles, start, cycles;
+  unsigned swap_ins;
+  size_t i;
+
+  tick_cycles = cycles_per_tick ();
+
+  msg ("dirty %d pages", BUF_PAGES);
+  for (i = 0; i < BUF_PAGES; i++)
+    memset (buf + i * PAGE_SIZE, i, PAGE_SIZE);
+
+  msg ("read back");
+  swap_ins = own_stats ()->swap_ins;
+  start = rdtsc ();
+  for (i = 0; i < BUF_PAGES; i++)
+    if (buf[i * PAGE_SIZE] != (char) i
+        || buf[i * PAGE_SIZE + PAGE_SIZE - 1] != (char) i)
+      fail ("page %zu has the wrong contents", i);
+  cycles = rdtsc () - start;
+  swap_ins = own_stats ()->swap_ins - swap_ins;
+
+  if (swap_ins == 0)
+    fail ("no pages were swapped in");
+  msg ("%u pages swapped in, %llu pages per second", swap_ins,
+       (unsigned long long) swap_ins * tick_cycles * TIMER_FREQ / cycles);
+}
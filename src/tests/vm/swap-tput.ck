@@ -0,0 +1,35 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the counts varying
+# from run to run:
+#
+# (swap-tput) dirty 640 pages
+# (swap-tput) read back
+# (swap-tput) 512 pages swapped in, 1234 pages per second
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(swap-tput) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(swap-tput) end', @output);
+my ($swap_ins, $rate) = get_measurement
+  ("measurement", qr/^\(swap-tput\) (\d+) pages swapped in, (\d+) pages per second$/,
+   @output);
+
+# User memory is limited to 256 pages, so at least 384 pages of
+# the 640-page buffer have to come back from swap.
+fail "only $swap_ins pages swapped in, expected at least 384\n"
+  if $swap_ins < 384;
+fail "swap rate is zero\n" if $rate == 0;
+
+pass;
@@ -0,0 +1,44 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the counts varying
+# from run to run:
+#
+# (swap-walk-nora) fill 512 pages
+# (swap-walk-nora) walk 512 pages
+# (swap-walk-nora) 470 major faults, 470 pages swapped in, 91234 cycles per page
+#
+# Without read-ahead, each page swapped in takes a major fault of
+# its own, and swap-walk must take fewer.  Faults that read a page
+# of the executable back count too.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(swap-walk-nora) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(swap-walk-nora) end', @output);
+my ($faults, $swap_ins) = get_measurement
+  ("measurement", qr/^\(swap-walk-nora\) (\d+) major faults, (\d+) pages swapped in, \d+ cycles per page$/,
+   @output);
+fail "$faults major faults for $swap_ins pages swapped in, "
+  . "though read-ahead is off\n"
+  unless $faults >= $swap_ins;
+
+my (@base) = get_core_output ("run", read_other_output ("swap-walk"));
+my ($ra_faults) = get_measurement
+  ("swap-walk measurement", qr/^\(swap-walk\) (\d+) major faults, \d+ pages swapped in, \d+ cycles per page$/,
+   @base);
+fail "read-ahead took $ra_faults major faults, no fewer than "
+  . "$faults without it\n"
+  unless $ra_faults < $faults;
+
+pass;
@@ -0,0 +1,76 @@
+/* Walks an array four times the size of user memory and reports
+   how many major faults it took.
+
+   The test is run with user memory limited to 128 pages, so the
+   512-page array cannot stay resident: the first pass fills it,
+   pushing most of it out to swap, and the second pass reads it
+   back in order, checking the contents.  Every page of the second
+   pass has to come back from swap, but with swap read-ahead most
+   of them are already in memory by the time they are touched, so
+   the second pass should take far fewer major faults than it
+   swaps pages in.
+
+   Built twice: swap-walk runs with the default read-ahead and
+   swap-walk-nora with "-readahead=0", for comparison. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ARRAY_PAGES 512         /* 4 times the 128 pages of memory. */
+
+static char array[ARRAY_PAGES * PAGE_SIZE];
+static struct thread_stats stats_buf[64];
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns this process's statistics. */
+static struct thread_stats
+own_stats (void)
+{
+  int cnt = stats (stats_buf, sizeof stats_buf / sizeof *stats_buf);
+  int i;
+
+  /* Our thread is named after the program, as is the test. */
+  for (i = 0; i < cnt; i++)
+    if (!strcmp (stats_buf[i].name, test_name))
+      return stats_buf[i];
+  fail ("own thread not found in stats");
+}
+
+void
+test_main (void)
+{
+  struct thread_stats before, after;
+  uint64_t start, cycles;
+  size_t i;
+
+  msg ("fill %d pages", ARRAY_PAGES);
+  for (i = 0; i < ARRAY_PAGES; i++)
+    memset (array + i * PAGE_SIZE, i, PAGE_SIZE);
+
+  msg ("walk %d pages", ARRAY_PAGES);
+  before = own_stats ();
+  start = rdtsc ();
+  for (i = 0; i < ARRAY_PAGES; i++)
+    if (array[i * PAGE_SIZE] != (char) i
+        || array[i * PAGE_SIZE + PAGE_SIZE - 1] != (char) i)
+      fail ("page %zu has the wrong contents", i);
+  cycles = rdtsc () - start;
+  after = own_stats ();
+
+  msg ("%u major faults, %u pages swapped in, %llu cycles per page",
+       (unsigned) (after.major_faults - before.major_faults),
+       (unsigned) (after.swap_ins - before.swap_ins),
+       (unsigned long long) cycles / ARRAY_PAGES);
+}
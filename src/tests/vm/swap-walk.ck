@@ -0,0 +1,36 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the counts varying
+# from run to run:
+#
+# (swap-walk) fill 512 pages
+# (swap-walk) walk 512 pages
+# (swap-walk) 61 major faults, 470 pages swapped in, 91234 cycles per page
+#
+# With read-ahead, most pages must come in with another page's
+# fault, so there must be fewer major faults than pages swapped in.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(swap-walk) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(swap-walk) end', @output);
+my ($faults, $swap_ins) = get_measurement
+  ("measurement", qr/^\(swap-walk\) (\d+) major faults, (\d+) pages swapped in, \d+ cycles per page$/,
+   @output);
+fail "no pages were swapped in\n" unless $swap_ins > 0;
+fail "$faults major faults for $swap_ins pages swapped in: "
+  . "no read-ahead\n"
+  unless $faults < $swap_ins;
+
+pass;
@@ -0,0 +1,50 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run:
+#
+# (tlb-lazy-off) round trip through the kernel: 1234567 cycles
+# (tlb-lazy-off) touch 48 pages after it: 6789 cycles
+#
+# With lazy TLB switching off, the page directory statistics
+# printed at shutdown should show no kernel thread keeping one:
+#
+# Paging: 302 page directory loads, 0 kept for kernel threads
+#
+# tlb-lazy, which lets kernel threads keep the loaded page
+# directory, must have loaded fewer.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+my ($loads, $kept) = get_measurement
+  ("page directory statistics",
+   qr/^Paging: (\d+) page directory loads, (\d+) kept for kernel threads$/,
+   @output);
+fail "lazy TLB switching was not turned off\n" unless $kept == 0;
+
+my ($lazy_loads) = get_measurement
+  ("tlb-lazy page directory statistics",
+   qr/^Paging: (\d+) page directory loads, \d+ kept for kernel threads$/,
+   read_other_output ("tlb-lazy"));
+fail "tlb-lazy loaded $lazy_loads page directories, no fewer than "
+  . "$loads without lazy switching\n"
+  unless $lazy_loads < $loads;
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(tlb-lazy-off) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(tlb-lazy-off) end', @output);
+fail "missing round trip measurement"
+  unless grep (/^\(tlb-lazy-off\) round trip through the kernel: \d+ cycles$/, @output);
+fail "missing working set measurement"
+  unless grep (/^\(tlb-lazy-off\) touch 48 pages after it: \d+ cycles$/, @output);
+
+pass;
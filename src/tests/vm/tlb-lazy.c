@@ -0,0 +1,80 @@
+/* Times round trips from a process through the kernel and back
+   during which a kernel thread runs, and how long the process
+   takes afterward to touch its working set again.  Each round trip
+   reads a byte of a file, which the kernel does not cache, so the
+   process waits for the disk while the idle thread runs.
+
+   Kernel threads normally keep the page directory of the process
+   that ran before them, so the process comes back to its TLB
+   entries.  tlb-lazy-off repeats the test with "-nolazytlb", which
+   loads the kernel's page directory for each kernel thread and so
+   flushes the process's entries every time. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUNDS 64               /* Round trips timed. */
+#define WS_PAGES 48             /* Pages in the working set. */
+
+static char ws[WS_PAGES][4096];
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Reads a byte from each page of the working set and returns
+   their sum. */
+static int
+touch (void)
+{
+  int sum = 0;
+  int i;
+
+  for (i = 0; i < WS_PAGES; i++)
+    sum += *(volatile char *) ws[i];
+  return sum;
+}
+
+void
+test_main (void)
+{
+  const int expected = WS_PAGES * (WS_PAGES - 1) / 2;
+  uint64_t trip = 0, retouch = 0;
+  int handle;
+  int i;
+
+  CHECK (create ("data", 512), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  for (i = 0; i < WS_PAGES; i++)
+    ws[i][0] = i;
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      uint64_t start, back;
+      char byte;
+
+      touch ();
+      seek (handle, 0);
+      start = rdtsc ();
+      if (read (handle, &byte, 1) != 1)
+        fail ("read \"data\" failed");
+      back = rdtsc ();
+      if (touch () != expected)
+        fail ("working set corrupted");
+      retouch += rdtsc () - back;
+      trip += back - start;
+    }
+  close (handle);
+
+  msg ("round trip through the kernel: %llu cycles",
+       (unsigned long long) (trip / ROUNDS));
+  msg ("touch %d pages after it: %llu cycles", WS_PAGES,
+       (unsigned long long) (retouch / ROUNDS));
+}
@@ -0,0 +1,37 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle counts
+# varying from run to run:
+#
+# (tlb-lazy) round trip through the kernel: 1234567 cycles
+# (tlb-lazy) touch 48 pages after it: 2345 cycles
+#
+# The page directory statistics printed at shutdown look like
+# this, with most switches to a kernel thread keeping the loaded
+# page directory:
+#
+# Paging: 42 page directory loads, 130 kept for kernel threads
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+my ($kept) = map (/^Paging: \d+ page directory loads, (\d+) kept for kernel threads$/, @output);
+fail "missing page directory statistics" unless defined $kept;
+fail "no kernel thread kept a page directory" unless $kept > 0;
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(tlb-lazy) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(tlb-lazy) end', @output);
+fail "missing round trip measurement"
+  unless grep (/^\(tlb-lazy\) round trip through the kernel: \d+ cycles$/, @output);
+fail "missing working set measurement"
+  unless grep (/^\(tlb-lazy\) touch 48 pages after it: \d+ cycles$/, @output);
+
+pass;
@@ -0,0 +1,32 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle count
+# varying from run to run:
+#
+# (tlb-matmult-4k) multiply 256x256 matrices: 512345678 cycles
+#
+# With -small-pages the kernel mapping described at boot should
+# use no 4 MB pages and no global pages:
+#
+# Kernel mapping: 0 4 MB pages, 8192 4 kB pages, global pages off
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+fail "large or global pages were used"
+  unless grep (/^Kernel mapping: 0 4 MB pages, \d+ 4 kB pages, global pages off$/, @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(tlb-matmult-4k) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(tlb-matmult-4k) end', @output);
+fail "missing measurement"
+  unless grep (/^\(tlb-matmult-4k\) multiply 256x256 matrices: \d+ cycles$/, @output);
+
+pass;
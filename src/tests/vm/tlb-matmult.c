@@ -0,0 +1,63 @@
+/* Multiplies two 256x256 matrices of ints, the straightforward
+   way, and times it.  Each matrix takes 64 pages, and the inner
+   loop walks a column of the second one, touching a different
+   page every 4 steps, so the multiplication leans hard on the
+   TLB; timer interrupts and the kernel's work on their behalf
+   compete with it for TLB entries.
+
+   tlb-matmult-4k repeats it with the kernel mapped by 4 kB,
+   non-global pages only. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define N 256
+
+static int a[N][N], b[N][N], c[N][N];
+
+/* Returns the time-stamp counter, which user code may read. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+void
+test_main (void)
+{
+  const int s1 = N * (N - 1) / 2;               /* Sum of k. */
+  const int s2 = (N - 1) * N * (2 * N - 1) / 6; /* Sum of k * k. */
+  uint64_t start, cycles;
+  int i, j, k;
+
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++)
+      {
+        a[i][j] = i + j;
+        b[i][j] = i - j;
+      }
+
+  start = rdtsc ();
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++)
+      {
+        int sum = 0;
+        for (k = 0; k < N; k++)
+          sum += a[i][k] * b[k][j];
+        c[i][j] = sum;
+      }
+  cycles = rdtsc () - start;
+
+  /* The sum over k of (i + k) * (k - j). */
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++)
+      if (c[i][j] != i * s1 - N * i * j + s2 - j * s1)
+        fail ("c[%d][%d] is %d", i, j, c[i][j]);
+
+  msg ("multiply %dx%d matrices: %llu cycles", N, N,
+       (unsigned long long) cycles);
+}
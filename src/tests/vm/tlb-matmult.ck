@@ -0,0 +1,40 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the cycle count
+# varying from run to run:
+#
+# (tlb-matmult) multiply 256x256 matrices: 512345678 cycles
+#
+# The kernel mapping is described at boot by a line like this,
+# with the counts depending on the size of memory:
+#
+# Kernel mapping: 3 4 MB pages, 5120 4 kB pages, global pages on
+#
+# With 32 MB of RAM, some of the mapping must use 4 MB pages, and
+# all of it global pages.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+my ($large, $global) = get_measurement
+  ("kernel mapping line",
+   qr/^Kernel mapping: (\d+) 4 MB pages, \d+ 4 kB pages, global pages (on|off)$/,
+   @output);
+fail "the kernel is mapped without 4 MB pages\n" unless $large > 0;
+fail "the kernel is mapped without global pages\n" unless $global eq 'on';
+
+@output = get_core_output ("run", @output);
+fail "missing begin in output"
+  unless grep ($_ eq '(tlb-matmult) begin', @output);
+fail "missing end in output"
+  unless grep ($_ eq '(tlb-matmult) end', @output);
+fail "missing measurement"
+  unless grep (/^\(tlb-matmult\) multiply 256x256 matrices: \d+ cycles$/, @output);
+
+pass;
@@ -0,0 +1,40 @@
+# -*- perl -*-
+
+# The expected output looks like this, with the counts varying
+# from run to run:
+#
+# (zswap-tput) dirty 640 pages
+# (zswap-tput) read back
+# (zswap-tput) 512 pages swapped in, 51234 pages per second
+#
+# followed, after the run, by the compressed swap statistics:
+#
+# Zswap: 701 pages stored (0 zero, 0 incompressible), 129 written back
+# Zswap: 512 of 580 loads hit (88%), compressed to 1%, pool 12 of 256 kB used (peak 20 kB)
+#
+# Some of the pages swapped in must have come from the pool.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::measure;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my ($hits) = get_measurement
+  ("compressed swap statistics",
+   qr/^Zswap: (\d+) of \d+ loads hit \(\d+%\), compressed to \d+%, pool \d+ of \d+ kB used \(peak \d+ kB\)$/,
+   @output);
+fail "no page was loaded from the compressed pool\n" unless $hits > 0;
+
+@output = get_core_output ("run", @output);
+fail "missing end in output"
+  unless grep ($_ eq '(zswap-tput) end', @output);
+get_measurement
+  ("measurement", qr/^\(zswap-tput\) (\d+) pages swapped in, \d+ pages per second$/,
+   @output);
+
+pass;
@@ -20,12 +20,17 @@
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #else
@@ -39,12 +44,24 @@
 #endif
 #ifdef VM
 #include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
+#include "vm/prefetch.h"
 #endif
 
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
 
+/* TASK 3 : Paging extensions turned on in CR4 by paging_init(), for
+   every CPU to turn on before loading init_page_dir. */
+uint32_t init_cr4;
+
+/* -small-pages: Map the kernel with 4 kB pages only, none global? */
+static bool small_pages;
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -66,6 +83,7 @@ static void paging_init (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
+static void parse_profiling_option (char *value);
 static void run_actions (char **argv);
 static void usage (void);
 
@@ -101,7 +119,9 @@ main (void)
   /* Initialize memory system. */
   palloc_init (user_page_limit);
   malloc_init ();
+  kmem_init ();
   paging_init ();
+  profile_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -126,6 +146,9 @@ main (void)
   serial_init_queue ();
   timer_calibrate ();
 
+  /* TASK 1: Start the other CPUs, if any. */
+  smp_init ();
+
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
@@ -134,8 +157,13 @@ main (void)
 #endif
 
 #ifdef VM
-  /* TASK 3 : Initialise our frame table */
+  /* TASK 3 : Initialise our frame table, swap space, shared pages
+     and the prefetch worker */
   frame_init();
+  page_init();
+  swap_init();
+  share_init();
+  prefetch_init();
 #endif
 
   printf ("Boot complete.\n");
@@ -161,16 +189,47 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* TASK 3 : Returns the CR4 paging extensions, CR4_PSE and
+   CR4_PGE, that the CPU supports.  See [IA32-v2a] "CPUID--CPU
+   Identification". */
+static uint32_t
+paging_extensions (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  uint32_t cr4 = 0;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  if (edx & (1 << 3))
+    cr4 |= CR4_PSE;
+  if (edx & (1 << 13))
+    cr4 |= CR4_PGE;
+  return cr4;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   TASK 3 : The kernel mapping is the same in every page
+   directory, so, when the CPU supports it, it is marked global,
+   which keeps it in the TLB when a process switch loads CR3.  And
+   each 4 MB of it is mapped by a single 4 MB page where it can be,
+   which makes the most of the TLB: where it holds no kernel text,
+   which must stay read-only, and no user pool page, since the
+   clock reads the accessed bit of each user frame's kernel
+   mapping. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  size_t large_cnt = 0, small_cnt = 0;
   extern char _start, _end_kernel_text;
+  char *ram_end = ptov (init_ram_pages * PGSIZE);
+  char *user_base = palloc_user_base ();
+
+  init_cr4 = small_pages ? 0 : paging_extensions ();
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -184,12 +243,39 @@ paging_init (void)
 
       if (pd[pde_idx] == 0)
         {
+          char *large_end = vaddr + LARGE_PGSIZE;
+          if ((init_cr4 & CR4_PSE) && pte_idx == 0
+              && large_end <= ram_end && large_end <= user_base
+              && (large_end <= &_start || vaddr >= &_end_kernel_text))
+            {
+              pd[pde_idx] = pde_create_large (vaddr, true);
+              if (init_cr4 & CR4_PGE)
+                pd[pde_idx] |= PTE_G;
+              large_cnt++;
+              page += LARGE_PGSIZE / PGSIZE - 1;
+              continue;
+            }
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      if (init_cr4 & CR4_PGE)
+        pt[pte_idx] |= PTE_G;
+      small_cnt++;
+    }
+
+  /* Turn the extensions on before anything can use them.  CR4
+     can be read and written on any CPU that has CPUID. */
+  if (init_cr4 != 0)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      cr4 |= init_cr4;
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4));
     }
+  printf ("Kernel mapping: %zu 4 MB pages, %zu 4 kB pages, global pages %s\n",
+          large_cnt, small_cnt, init_cr4 & CR4_PGE ? "on" : "off");
 
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
@@ -261,15 +347,40 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-evict") && value != NULL
+               && !strcmp (value, "fifo"))
+        frame_evict_fifo = true;
+      else if (!strcmp (name, "-pageout-low"))
+        pageout_low = atoi (value);
+      else if (!strcmp (name, "-pageout-high"))
+        pageout_high = atoi (value);
+      else if (!strcmp (name, "-readahead"))
+        swap_readahead = atoi (value);
+      else if (!strcmp (name, "-swap-per-sector"))
+        swap_per_sector = true;
+      else if (!strcmp (name, "-zswap"))
+        zswap_pool_pages = value != NULL ? atoi (value) : 64;
+      else if (!strcmp (name, "-prefetch"))
+        prefetch_pages = atoi (value);
+      else if (!strcmp (name, "-faultaround"))
+        fault_around_pages = atoi (value);
 #endif
 #endif
+      else if (!strcmp (name, "-small-pages"))
+        small_pages = true;
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-nospin"))
+        lock_adaptive = false;
+      else if (!strcmp (name, "-o") && value != NULL)
+        parse_profiling_option (value);
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-nolazytlb"))
+        pagedir_lazy = false;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -288,6 +399,29 @@ parse_options (char **argv)
   return argv;
 }
 
+/* Parses VALUE, the argument to a "-o" option, which turns on
+   one of the kernel's profilers: "lockstat" for lock contention,
+   or "profile" or "profile=N" for sampling the running code
+   every tick or every N ticks. */
+static void
+parse_profiling_option (char *value)
+{
+  char *save_ptr;
+  char *name = strtok_r (value, "=", &save_ptr);
+  char *arg = strtok_r (NULL, "", &save_ptr);
+
+  if (name != NULL && !strcmp (name, "lockstat") && arg == NULL)
+    lock_profiling = true;
+  else if (name != NULL && !strcmp (name, "profile"))
+    {
+      profile_period = arg != NULL ? atoi (arg) : 1;
+      if (profile_period == 0)
+        PANIC ("bad profiling period `%s' (use -h for help)", arg);
+    }
+  else
+    PANIC ("unknown profiler `%s' (use -h for help)", value);
+}
+
 /* Runs the task specified in ARGV[1]. */
 static void
 run_task (char **argv)
@@ -386,12 +520,25 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -evict=fifo        Replace pages FIFO instead of by CLOCK.\n"
+          "  -pageout-low=N     Start paging out below N free frames.\n"
+          "  -pageout-high=N    Stop paging out at N free frames.\n"
+          "  -readahead=N       Read up to N pages ahead on swap-in.\n"
+          "  -swap-per-sector   Swap pages a sector per request.\n"
+          "  -zswap[=N]         Keep swapped pages compressed in N pages.\n"
+          "  -prefetch=N        Read N pages of each segment at exec.\n"
+          "  -faultaround=N     Map resident pages N around a fault.\n"
 #endif
 #endif
+          "  -small-pages       Map the kernel with 4 kB, non-global pages.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -nospin            Never spin on contended locks.\n"
+          "  -o=lockstat        Profile named locks.\n"
+          "  -o=profile[=N]     Sample the running code every N ticks.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -nolazytlb         Load the kernel page directory for kernel threads.\n"
 #endif
           );
   shutdown_power_off ();
@@ -9,4 +9,7 @@
 /* Page directory with kernel mappings only. */
 extern uint32_t *init_page_dir;
 
+/* Paging extensions in CR4 that init_page_dir relies on. */
+extern uint32_t init_cr4;
+
 #endif /* threads/init.h */
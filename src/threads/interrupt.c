@@ -6,6 +6,8 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/smp.h"
+#include "threads/spinlock.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
@@ -43,9 +45,30 @@ static unsigned int unexpected_cnt[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.
+
+   TASK 1: Whether we are processing an external interrupt, and
+   whether to yield on its return, are kept per CPU in `struct
+   cpu' (see smp.h).  Inter-processor interrupts (IPIs) sent
+   between CPUs' local APICs are treated as external interrupts
+   too. */
+
+/* TASK 1: Giant lock.
+
+   On a single CPU, turning interrupts off is enough to make a
+   code sequence atomic, and the rest of the kernel relies on
+   this.  Once more than one CPU is running it no longer is, so
+   after smp_init() starts the APs each CPU also holds this
+   spinlock whenever its interrupts are off: intr_disable()
+   acquires it, intr_enable() releases it, and intr_handler()
+   takes it for interrupts that arrive with interrupts on.
+   Everything that used to be protected by disabling interrupts
+   is therefore still serialized, while code that runs with
+   interrupts on, such as CPU-bound threads and user programs,
+   runs in parallel.  The lock belongs to the CPU rather than the
+   thread, which is why a thread switch, which always happens
+   with interrupts off, hands it to the next thread. */
+static struct spinlock giant;
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -58,6 +81,7 @@ static inline uint64_t make_idtr_operand (uint16_t limit, void *base);
 
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
+static bool is_ipi (uint8_t vec_no);
 static void unexpected_interrupt (const struct intr_frame *);
 
 /* Returns the current interrupt status. */
@@ -94,6 +118,8 @@ intr_enable (void)
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
      Hardware Interrupts". */
+  if (old_level == INTR_OFF && smp_active)
+    spinlock_release (&giant);
   asm volatile ("sti");
 
   return old_level;
@@ -109,9 +135,61 @@ intr_disable (void)
      See [IA32-v2b] "CLI" and [IA32-v3a] 5.8.1 "Masking Maskable
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
+  if (old_level == INTR_ON && smp_active)
+    spinlock_acquire (&giant);
 
   return old_level;
 }
+
+/* TASK 1: Atomically enables interrupts and halts the CPU until
+   the next one arrives.  Interrupts must be off.
+
+   The `sti' instruction disables interrupts until the
+   completion of the next instruction, so `sti; hlt' can't lose
+   an interrupt that arrives in between.  See [IA32-v2a] "HLT",
+   [IA32-v2b] "STI", and [IA32-v3a] 7.11.1 "HLT Instruction". */
+void
+intr_wait (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!intr_context ());
+
+  if (smp_active)
+    spinlock_release (&giant);
+  asm volatile ("sti; hlt" : : : "memory");
+}
+
+/* TASK 1: Starts using the giant lock.  Called by smp_init() on
+   the BSP, with interrupts on, just before the APs are started. */
+void
+intr_start_smp (void)
+{
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (!smp_active);
+
+  /* Take the lock on behalf of the interrupts-off section we are
+     in, so that re-enabling interrupts releases it. */
+  old_level = intr_disable ();
+  spinlock_init (&giant);
+  spinlock_acquire (&giant);
+  smp_active = true;
+  intr_set_level (old_level);
+}
+
+/* TASK 1: Called by an AP that has been running with interrupts
+   off since it started, before it touches any shared state.
+   Takes the giant lock on behalf of that interrupts-off
+   section. */
+void
+intr_start_ap (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (smp_active);
+
+  spinlock_acquire (&giant);
+}
 
 /* Initializes the interrupt system. */
 void
@@ -157,6 +235,15 @@ intr_init (void)
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* TASK 1: Points an AP's IDT register at the IDT built by
+   intr_init(), which all CPUs share. */
+void
+intr_init_ap (void)
+{
+  uint64_t idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -203,15 +290,31 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
   ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT (!is_ipi (vec_no) && vec_no != IPI_SPURIOUS);
   register_handler (vec_no, dpl, level, handler, name);
 }
 
+/* TASK 1: Registers inter-processor interrupt VEC_NO to invoke
+   HANDLER, which is named NAME for debugging purposes.  Like an
+   external interrupt, the handler executes with interrupts
+   disabled. */
+void
+intr_register_ipi (uint8_t vec_no, intr_handler_func *handler,
+                   const char *name)
+{
+  ASSERT (is_ipi (vec_no));
+  register_handler (vec_no, 0, INTR_OFF, handler, name);
+}
+
 /* Returns true during processing of an external interrupt
    and false at all other times. */
 bool
 intr_context (void)
 {
-  return in_external_intr;
+  /* External interrupts always run with interrupts off.  Checking
+     that first also keeps us from reading another CPU's state if
+     we are preempted and migrate. */
+  return intr_get_level () == INTR_OFF && this_cpu ()->in_external_intr;
 }
 
 /* During processing of an external interrupt, directs the
@@ -222,7 +325,7 @@ void
 intr_yield_on_return (void)
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  this_cpu ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -274,6 +377,27 @@ pic_end_of_interrupt (int irq)
     outb (0xa0, 0x20);
 }
 
+/* TASK 0: Returns true if external interrupt VEC_NO has been
+   raised at the PIC but not yet delivered, e.g. because
+   interrupts are off.  Reads the PIC's interrupt request
+   register with OCW3. */
+bool
+intr_ext_pending (uint8_t vec_no)
+{
+  ASSERT (vec_no >= 0x20 && vec_no < 0x30);
+
+  if (vec_no < 0x28)
+    {
+      outb (PIC0_CTRL, 0x0a);
+      return (inb (PIC0_CTRL) & (1 << (vec_no - 0x20))) != 0;
+    }
+  else
+    {
+      outb (PIC1_CTRL, 0x0a);
+      return (inb (PIC1_CTRL) & (1 << (vec_no - 0x28))) != 0;
+    }
+}
+
 /* Creates an gate that invokes FUNCTION.
 
    The gate has descriptor privilege level DPL, meaning that it
@@ -346,26 +470,41 @@ intr_handler (struct intr_frame *frame)
 {
   bool external;
   intr_handler_func *handler;
+  struct cpu *cpu = NULL;
+
+  /* TASK 1: Entering through an interrupt gate turned interrupts
+     off.  If the interrupted code had them on, it did not hold
+     the giant lock, so take it now. */
+  if (smp_active && (frame->eflags & FLAG_IF)
+      && intr_get_level () == INTR_OFF)
+    spinlock_acquire (&giant);
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
      and they need to be acknowledged on the PIC (see below).
      An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+  external = (frame->vec_no >= 0x20 && frame->vec_no < 0x30)
+             || is_ipi (frame->vec_no);
   if (external)
     {
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (!intr_context ());
 
-      in_external_intr = true;
-      yield_on_return = false;
+      cpu = this_cpu ();
+      cpu->in_external_intr = true;
+      cpu->yield_on_return = false;
+
+      /* TASK 0: Restart the periodic timer interrupt if it was
+         stopped while idle, catching up on missed ticks. */
+      timer_idle_exit ();
     }
 
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+           || frame->vec_no == IPI_SPURIOUS)
     {
       /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
@@ -380,12 +519,36 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no);
+      cpu->in_external_intr = false;
+      if (is_ipi (frame->vec_no))
+        lapic_eoi ();
+      else
+        pic_end_of_interrupt (frame->vec_no);
 
-      if (yield_on_return)
+      if (cpu->yield_on_return)
         thread_yield ();
     }
+
+  /* TASK 1: Leave the giant lock held or not according to the
+     interrupt level that `iret' is about to restore. */
+  if (smp_active)
+    {
+      if (frame->eflags & FLAG_IF)
+        {
+          if (intr_get_level () == INTR_OFF)
+            spinlock_release (&giant);
+        }
+      else
+        intr_disable ();
+    }
+}
+
+/* TASK 1: Returns true if VEC_NO is one of the vectors used for
+   inter-processor interrupts, other than the spurious vector. */
+static bool
+is_ipi (uint8_t vec_no)
+{
+  return vec_no >= IPI_TICK && vec_no < IPI_SPURIOUS;
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
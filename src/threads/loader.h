@@ -8,6 +8,11 @@
 /* Physical address of kernel base. */
 #define LOADER_KERN_BASE 0x20000       /* 128 kB. */
 
+/* Physical address to which the kernel copies the application
+   processor start-up code in mpentry.S.  Must be page-aligned
+   and below 1 MB, since a STARTUP IPI names it by page number. */
+#define LOADER_AP_BASE 0x7000          /* 28 kB. */
+
 /* Kernel virtual address at which all physical memory is mapped.
    Must be aligned on a 4 MB boundary. */
 #define LOADER_PHYS_BASE 0xc0000000     /* 3 GB. */
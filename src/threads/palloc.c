@@ -1,14 +1,16 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/smp.h"
+#include "threads/spinlock.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,14 +25,72 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   TASK 3 : Each pool is a buddy system.  Its free pages make up
+   blocks of 2**ORDER pages, each aligned to its size within the
+   pool and kept on the free list for its order.  An allocation
+   takes the first block on the lowest nonempty list that fits,
+   halving it as often as it can and putting back the upper
+   halves, and returns any pages it does not need at the end.  A
+   freed block merges with its buddy, the other half of the block
+   of the next order up, for as long as the buddy is free too.
+   Both take time logarithmic, rather than linear, in the size of
+   the pool, and merging keeps free memory in large blocks.
+
+   Most allocations are of single pages, and many of those are
+   freed again soon, so each CPU also caches a few free pages of
+   each pool.  It takes pages from its cache, and frees them to
+   it, with interrupts off but without the pool's lock, moving
+   them to and from the buddy lists several at a time.  A page
+   freed to the cache is likely still in the CPU's data cache
+   when it is handed out again. */
+
+/* TASK 3 : Number of block orders.  The largest block has
+   2**(PALLOC_ORDERS - 1) pages. */
+#define PALLOC_ORDERS 16
+
+/* TASK 3 : Pages a CPU's cache holds at most, and pages moved
+   between it and the buddy lists at a time. */
+#define CACHE_PAGES 16
+#define CACHE_BATCH 8
+
+/* TASK 3 : State of a page, one byte per page. */
+#define PAGE_FREE 0x80          /* Starts a free block; low bits give
+                                   the block's order. */
+#define PAGE_USED 0x40          /* Handed out by the allocator. */
+                                /* Otherwise 0: inside a free block
+                                   or in a CPU's cache. */
+
+/* TASK 3 : A CPU's cache of free pages of one pool. */
+struct page_cache
+  {
+    size_t cnt;                 /* Number of pages in PAGES. */
+    void *pages[CACHE_PAGES];   /* Free pages, last freed last. */
+  };
+
+/* TASK 3 : Header kept in the first page of a free block. */
+struct free_block
+  {
+    struct list_elem elem;      /* Element in a free list. */
+  };
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct spinlock lock;               /* Protects free_lists.  Taken
+                                           with interrupts off, since
+                                           pages are freed where the
+                                           caller cannot sleep. */
+    struct list free_lists[PALLOC_ORDERS]; /* Free blocks by order. */
+    uint8_t *page_state;                /* State of each page. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    size_t free_cnt;                    /* Number of free pages, cached
+                                           ones included.  Updated
+                                           with interrupts off. */
+    struct page_cache caches[SMP_MAX_CPUS]; /* Per-CPU caches.  Used
+                                               with interrupts off. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +99,11 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void *cache_get (struct pool *);
+static void cache_put (struct pool *, void *page);
+static void cache_flush (struct pool *, struct page_cache *, size_t cnt);
+static size_t alloc_block (struct pool *, size_t page_cnt);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -71,20 +136,33 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
-  size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+  old_level = intr_disable ();
+  if (page_cnt == 1)
+    pages = cache_get (pool);
   else
-    pages = NULL;
+    {
+      size_t page_idx;
+
+      spinlock_acquire (&pool->lock);
+      page_idx = alloc_block (pool, page_cnt);
+      spinlock_release (&pool->lock);
+      if (page_idx != SIZE_MAX)
+        {
+          memset (pool->page_state + page_idx, PAGE_USED, page_cnt);
+          pages = pool->base + PGSIZE * page_idx;
+        }
+      else
+        pages = NULL;
+    }
+  if (pages != NULL)
+    pool->free_cnt -= page_cnt;
+  intr_set_level (old_level);
 
   if (pages != NULL)
     {
@@ -119,6 +197,8 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
+  size_t i;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +217,40 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  for (i = 0; i < page_cnt; i++)
+    {
+      ASSERT (pool->page_state[page_idx + i] == PAGE_USED);
+      pool->page_state[page_idx + i] = 0;
+    }
+
+  old_level = intr_disable ();
+  if (page_cnt == 1)
+    cache_put (pool, pages);
+  else
+    {
+      spinlock_acquire (&pool->lock);
+      free_range (pool, page_idx, page_cnt);
+      spinlock_release (&pool->lock);
+    }
+  pool->free_cnt += page_cnt;
+  intr_set_level (old_level);
+}
+
+/* Returns the number of free pages in the user pool.  The count
+   may be out of date by the time the caller looks at it. */
+size_t
+palloc_user_free_pages (void)
+{
+  return user_pool.free_cnt;
+}
+
+/* Returns the lowest kernel virtual address of a page in
+   the user pool.  The user pool runs from there to the end of
+   RAM. */
+void *
+palloc_user_base (void)
+{
+  return user_pool.base;
 }
 
 /* Frees the page at PAGE. */
@@ -153,20 +265,31 @@ palloc_free_page (void *page)
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  /* TASK 3 : We'll put the pool's page states at its base.
+     Calculate the space needed for them and subtract it from the
+     pool's size. */
+  size_t state_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  size_t i;
+  if (state_pages > page_cnt)
+    PANIC ("Not enough memory in %s for page states.", name);
+  page_cnt -= state_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  /* Initialize the pool, with all of its pages free. */
+  spinlock_init (&p->lock);
+  for (i = 0; i < PALLOC_ORDERS; i++)
+    list_init (&p->free_lists[i]);
+  p->page_state = base;
+  memset (p->page_state, 0, page_cnt);
+  p->base = base + state_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_cnt = page_cnt;
+  for (i = 0; i < SMP_MAX_CPUS; i++)
+    p->caches[i].cnt = 0;
+  spinlock_acquire (&p->lock);
+  free_range (p, 0, page_cnt);
+  spinlock_release (&p->lock);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +299,186 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* TASK 3 : Takes a page from the running CPU's cache of POOL,
+   refilling the cache from the buddy lists if it is empty.
+   Returns a null pointer if POOL has no free page.  Interrupts
+   must be off. */
+static void *
+cache_get (struct pool *pool)
+{
+  struct page_cache *c = &pool->caches[this_cpu ()->id];
+  void *page;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (c->cnt == 0)
+    {
+      spinlock_acquire (&pool->lock);
+      while (c->cnt < CACHE_BATCH)
+        {
+          size_t page_idx = alloc_block (pool, 1);
+          if (page_idx == SIZE_MAX)
+            break;
+          c->pages[c->cnt++] = pool->base + PGSIZE * page_idx;
+        }
+      spinlock_release (&pool->lock);
+      if (c->cnt == 0)
+        return NULL;
+    }
+
+  page = c->pages[--c->cnt];
+  pool->page_state[pg_no (page) - pg_no (pool->base)] = PAGE_USED;
+  return page;
+}
+
+/* TASK 3 : Puts PAGE, a free page of POOL, in the running CPU's
+   cache, first moving some of the cache's pages to the buddy
+   lists if it is full.  Interrupts must be off. */
+static void
+cache_put (struct pool *pool, void *page)
+{
+  struct page_cache *c = &pool->caches[this_cpu ()->id];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (c->cnt == CACHE_PAGES)
+    {
+      spinlock_acquire (&pool->lock);
+      cache_flush (pool, c, CACHE_BATCH);
+      spinlock_release (&pool->lock);
+    }
+  c->pages[c->cnt++] = page;
+}
+
+/* TASK 3 : Moves the CNT pages cached longest in C to POOL's
+   buddy lists.  POOL's lock must be held. */
+static void
+cache_flush (struct pool *pool, struct page_cache *c, size_t cnt)
+{
+  size_t i;
+
+  ASSERT (spinlock_held (&pool->lock));
+  ASSERT (cnt <= c->cnt);
+
+  for (i = 0; i < cnt; i++)
+    free_range (pool, pg_no (c->pages[i]) - pg_no (pool->base), 1);
+  c->cnt -= cnt;
+  memmove (c->pages, c->pages + cnt, c->cnt * sizeof *c->pages);
+}
+
+/* TASK 3 : Returns the first page of free block PAGE_IDX in POOL. */
+static inline struct free_block *
+block_at (struct pool *pool, size_t page_idx)
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* TASK 3 : Puts the free block of order ORDER at PAGE_IDX in POOL
+   on its free list. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  pool->page_state[page_idx] = PAGE_FREE | order;
+  list_push_front (&pool->free_lists[order],
+                   &block_at (pool, page_idx)->elem);
+}
+
+/* TASK 3 : Removes PAGE_CNT free pages from POOL's buddy lists and
+   returns the index of the first, or SIZE_MAX if there is no run
+   of PAGE_CNT free pages in a single block.  If no block is big
+   enough, the pages in the CPUs' caches are put back first, in
+   case they complete one.  Other CPUs only use their caches with
+   interrupts off too, and such sections never overlap (see
+   interrupt.c), so their caches are safe to empty from here.
+   POOL's lock must be held. */
+static size_t
+alloc_block (struct pool *pool, size_t page_cnt)
+{
+  struct free_block *b;
+  int order = 0;
+  int k;
+  size_t page_idx;
+
+  ASSERT (spinlock_held (&pool->lock));
+
+  while ((size_t) 1 << order < page_cnt)
+    if (++order >= PALLOC_ORDERS)
+      return SIZE_MAX;
+
+  for (k = order; k < PALLOC_ORDERS; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k == PALLOC_ORDERS)
+    {
+      bool flushed = false;
+      unsigned i;
+
+      for (i = 0; i < cpu_cnt; i++)
+        if (pool->caches[i].cnt > 0)
+          {
+            cache_flush (pool, &pool->caches[i], pool->caches[i].cnt);
+            flushed = true;
+          }
+      return flushed ? alloc_block (pool, page_cnt) : SIZE_MAX;
+    }
+
+  b = list_entry (list_pop_front (&pool->free_lists[k]),
+                  struct free_block, elem);
+  page_idx = pg_no (b) - pg_no (pool->base);
+  pool->page_state[page_idx] = 0;
+
+  /* Halve the block down to ORDER, keeping the lower half each
+     time, then give back the pages past PAGE_CNT. */
+  while (k > order)
+    {
+      k--;
+      push_block (pool, page_idx + ((size_t) 1 << k), k);
+    }
+  free_range (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+  return page_idx;
+}
+
+/* TASK 3 : Adds the PAGE_CNT pages starting at PAGE_IDX in POOL to
+   its buddy lists, as the largest aligned blocks that fit, merging
+   each with its buddy while that is free.  POOL's lock must be
+   held. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  ASSERT (spinlock_held (&pool->lock));
+
+  while (page_cnt > 0)
+    {
+      size_t start = page_idx;
+      int order = 0;
+
+      /* Largest aligned block at PAGE_IDX within the range. */
+      while (order + 1 < PALLOC_ORDERS
+             && start % ((size_t) 2 << order) == 0
+             && (size_t) 2 << order <= page_cnt)
+        order++;
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+
+      /* Merge with the buddy while it is a free block of the same
+         order. */
+      while (order + 1 < PALLOC_ORDERS)
+        {
+          size_t buddy = start ^ ((size_t) 1 << order);
+          if (buddy + ((size_t) 1 << order) > pool->page_cnt
+              || pool->page_state[buddy] != (PAGE_FREE | order))
+            break;
+          list_remove (&block_at (pool, buddy)->elem);
+          pool->page_state[buddy] = 0;
+          if (buddy < start)
+            start = buddy;
+          order++;
+        }
+      push_block (pool, start, order);
+    }
+}
@@ -0,0 +1,200 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* TASK 1: Sampling CPU profiler.
+
+   With the "-o=profile" kernel command-line option, every
+   PROFILE_PERIOD'th timer tick (1 by default, "-o=profile=N" for
+   every Nth) each CPU that is not idle records the EIP it was
+   interrupted at, in kernel or user mode alike, into its own
+   sample buffer.  No locking is needed for that, since only the
+   CPU itself touches its buffer, from its tick handler.
+
+   When a buffer fills up, its samples are folded into a single
+   histogram of sample counts by address.  The histogram is
+   global, but it is only updated with interrupts off, which
+   under SMP also means holding the giant lock.
+
+   At shutdown the histogram is printed, most sampled addresses
+   first, in a form that can be given straight to
+   utils/backtrace: kernel addresses are resolved against
+   kernel.o, and user addresses against the binary of the user
+   program that was running, if it is named as well. */
+unsigned profile_period;
+
+/* Samples kept per CPU before they are folded into the
+   histogram. */
+#define BUF_PAGES 1
+#define BUF_SIZE (BUF_PAGES * PGSIZE / sizeof (uint32_t))
+
+/* Number of distinct addresses the histogram can hold.  A power
+   of 2, so that it can be probed with a mask. */
+#define HIST_PAGES 4
+#define HIST_SIZE (HIST_PAGES * PGSIZE / sizeof (struct hist_entry))
+
+/* Number of histogram entries printed at shutdown. */
+#define PRINT_MAX 40
+
+/* A CPU's sample buffer. */
+struct sample_buf
+  {
+    uint32_t *eips;             /* Sampled EIPs. */
+    size_t cnt;                 /* Number of samples in EIPS. */
+    unsigned ticks;             /* Ticks until the next sample. */
+  };
+
+/* Number of samples that landed on one address. */
+struct hist_entry
+  {
+    uint32_t eip;               /* Sampled address, or 0 if unused. */
+    uint32_t cnt;               /* Number of samples. */
+  };
+
+static struct sample_buf bufs[SMP_MAX_CPUS];
+static struct hist_entry *hist;
+
+/* Sample totals. */
+static long long kernel_samples;        /* Samples in kernel mode. */
+static long long user_samples;          /* Samples in user mode. */
+static long long idle_samples;          /* Ticks that found a CPU idle. */
+static long long lost_samples;          /* Samples with no histogram slot. */
+
+static void fold (struct sample_buf *);
+
+/* Allocates the sample buffers and the histogram, if profiling
+   was requested.  Must be called after palloc_init() and before
+   the timer starts ticking on any other CPU. */
+void
+profile_init (void)
+{
+  unsigned i;
+
+  if (profile_period == 0)
+    return;
+
+  hist = palloc_get_multiple (PAL_ZERO, HIST_PAGES);
+  if (hist == NULL)
+    PANIC ("profile: out of memory for histogram");
+  for (i = 0; i < SMP_MAX_CPUS; i++)
+    {
+      bufs[i].eips = palloc_get_multiple (0, BUF_PAGES);
+      if (bufs[i].eips == NULL)
+        PANIC ("profile: out of memory for sample buffers");
+      bufs[i].ticks = profile_period;
+    }
+}
+
+/* Records a sample of the code interrupted by the timer tick
+   whose frame is F.  Called on every CPU at every tick, with
+   interrupts off. */
+void
+profile_tick (const struct intr_frame *f)
+{
+  struct cpu *c;
+  struct sample_buf *b;
+
+  if (hist == NULL)
+    return;
+
+  c = this_cpu ();
+  b = &bufs[c->id];
+  if (--b->ticks > 0)
+    return;
+  b->ticks = profile_period;
+
+  if (thread_current () == c->idle)
+    {
+      idle_samples++;
+      return;
+    }
+  if ((f->cs & 3) == 3)
+    user_samples++;
+  else
+    kernel_samples++;
+
+  b->eips[b->cnt++] = (uint32_t) f->eip;
+  if (b->cnt == BUF_SIZE)
+    fold (b);
+}
+
+/* Adds the samples in B to the histogram and empties B.
+   Interrupts must be off. */
+static void
+fold (struct sample_buf *b)
+{
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < b->cnt; i++)
+    {
+      uint32_t eip = b->eips[i];
+      size_t h = (eip * 2654435761u) & (HIST_SIZE - 1);
+      size_t probes;
+
+      for (probes = 0; probes < HIST_SIZE; probes++)
+        {
+          struct hist_entry *e = &hist[h];
+          if (e->eip == eip || e->eip == 0)
+            {
+              e->eip = eip;
+              e->cnt++;
+              break;
+            }
+          h = (h + 1) & (HIST_SIZE - 1);
+        }
+      if (probes == HIST_SIZE)
+        lost_samples++;
+    }
+  b->cnt = 0;
+}
+
+/* Prints the profile.  Does nothing unless profiling is on. */
+void
+profile_print_stats (void)
+{
+  enum intr_level old_level;
+  struct hist_entry top[PRINT_MAX];
+  size_t top_cnt = 0;
+  size_t i, j;
+
+  if (hist == NULL)
+    return;
+
+  /* Fold what is left in each buffer and pick out the most
+     sampled addresses by insertion into TOP. */
+  old_level = intr_disable ();
+  for (i = 0; i < SMP_MAX_CPUS; i++)
+    fold (&bufs[i]);
+  for (i = 0; i < HIST_SIZE; i++)
+    {
+      struct hist_entry e = hist[i];
+      if (e.eip == 0)
+        continue;
+      for (j = top_cnt; j > 0 && top[j - 1].cnt < e.cnt; j--)
+        if (j < PRINT_MAX)
+          top[j] = top[j - 1];
+      if (j < PRINT_MAX)
+        {
+          top[j] = e;
+          if (top_cnt < PRINT_MAX)
+            top_cnt++;
+        }
+    }
+  intr_set_level (old_level);
+
+  printf ("Profile: %lld kernel samples, %lld user samples, "
+          "%lld idle, %lld lost\n",
+          kernel_samples, user_samples, idle_samples, lost_samples);
+  printf ("Profile hot spots (samples per address, for utils/backtrace):\n");
+  for (i = 0; i < top_cnt; i++)
+    printf ("  0x%08"PRIx32" %"PRIu32"\n", top[i].eip, top[i].cnt);
+}
@@ -0,0 +1,16 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* TASK 1: Sampling CPU profiler. */
+
+/* Sample every this many timer ticks, or not at all if 0. */
+extern unsigned profile_period;
+
+void profile_init (void);
+void profile_tick (const struct intr_frame *);
+void profile_print_stats (void);
+
+#endif /* threads/profile.h */
@@ -66,6 +66,17 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=4 MB page, 0=page table (PDEs only). */
+#define PTE_G 0x100             /* 1=global, kept in the TLB when CR3 is
+                                   loaded, 0=not global. */
+
+/* TASK 3 : Bits in control register 4 that enable PTE_PS and
+   PTE_G.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR4_PSE 0x10            /* Page size extensions. */
+#define CR4_PGE 0x80            /* Page global enable. */
+
+/* Bytes covered by a 4 MB page, the same as by a page table. */
+#define LARGE_PGSIZE PTSPAN
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -77,9 +88,18 @@ static inline uint32_t pde_create (uint32_t *pt) {
    PDE, which must "present", points to. */
 static inline uint32_t *pde_get_pt (uint32_t pde) {
   ASSERT (pde & PTE_P);
+  ASSERT (!(pde & PTE_PS));
   return ptov (pde & PTE_ADDR);
 }
 
+/* TASK 3 : Returns a PDE that maps the 4 MB page at PAGE, which
+   must be 4 MB aligned, for the kernel only.  If WRITABLE is true
+   the page is writable as well as readable. */
+static inline uint32_t pde_create_large (void *page, bool writable) {
+  ASSERT (vtop (page) % LARGE_PGSIZE == 0);
+  return vtop (page) | PTE_PS | PTE_P | (writable ? PTE_W : 0);
+}
+
 /* Returns a PTE that points to PAGE.
    The PTE's page is readable.
    If WRITABLE is true then it will be writable as well.
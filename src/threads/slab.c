@@ -0,0 +1,333 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* TASK 3 : Slab allocator.
+
+   malloc() rounds each request up to a power of 2 and serves all
+   requests of a size class from one free list under one lock.  The
+   kernel's most common objects waste much of their block that
+   way, and every allocation and free takes the lock.  Instead, a
+   subsystem can create a cache for one kind of object, which
+   allocates objects of exactly that size from pages of their own,
+   called slabs.
+
+   A slab is a page with a header and an array of objects.  The
+   header links the free objects through an array of indexes
+   rather than through the objects, so an object freed after use
+   keeps the state its constructor gave it and needs no
+   constructing on its next allocation.  Slabs with free objects
+   are kept on one list and full slabs on another; a slab that
+   empties is given back to the page allocator, unless it is the
+   cache's only one with free objects.
+
+   On top of the slabs, each CPU has a magazine of freed objects
+   for each cache.  Allocations take from the magazine, and frees
+   go to it, with interrupts off but without the cache's lock,
+   which is taken only when the magazine is empty or full. */
+
+/* Objects a CPU's magazine holds. */
+#define MAGAZINE_SIZE 16
+
+/* A CPU's freed objects of one cache. */
+struct magazine
+  {
+    size_t cnt;                 /* Number of objects in OBJS. */
+    void *objs[MAGAZINE_SIZE];  /* Free objects, last freed last. */
+  };
+
+/* A cache of objects of one size. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size, rounded up. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t obj_ofs;             /* Offset of first object in a slab. */
+    kmem_ctor *ctor;            /* Constructor, or a null pointer. */
+
+    struct lock lock;           /* Protects the members below. */
+    struct list partial;        /* Slabs with free objects. */
+    struct list full;           /* Slabs with none. */
+    size_t slab_cnt;            /* Number of slabs. */
+    size_t alloc_cnt;           /* Objects not free in a slab, those
+                                   in magazines included. */
+
+    struct magazine mags[SMP_MAX_CPUS]; /* Per-CPU magazines.  Used
+                                           with interrupts off. */
+    struct list_elem elem;      /* Element in kmem_caches. */
+  };
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab0bec
+
+/* Marks the end of a slab's free list. */
+#define SLAB_END UINT16_MAX
+
+/* Header at the start of each slab. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's partial or full. */
+    size_t in_use;              /* Objects not free in this slab. */
+    uint16_t free;              /* Index of first free object. */
+    uint16_t next[];            /* Index of free object after each
+                                   free object. */
+  };
+
+/* All caches, for statistics. */
+static struct list kmem_caches;
+static struct lock kmem_caches_lock;
+
+static void *slab_alloc (struct kmem_cache *);
+static void slab_free (struct kmem_cache *, void *);
+static struct slab *obj_to_slab (const struct kmem_cache *, void *);
+
+/* Initializes the list of caches. */
+void
+kmem_init (void)
+{
+  list_init (&kmem_caches);
+  lock_init_named (&kmem_caches_lock, "kmem_caches");
+}
+
+/* Creates and returns a cache of SIZE-byte objects called NAME.
+   If CTOR is nonnull, it is run on each object as its slab is
+   created.  Caches are created at startup and never destroyed, so
+   this panics if out of memory. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor *ctor)
+{
+  struct kmem_cache *c;
+  size_t n;
+
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("kmem_cache_create: out of memory for \"%s\"", name);
+  c->name = name;
+  c->obj_size = ROUND_UP (size, sizeof (void *));
+  c->ctor = ctor;
+
+  /* Fit as many objects as the page holds after the header and
+     an index for each. */
+  n = (PGSIZE - sizeof (struct slab)) / (c->obj_size + sizeof (uint16_t));
+  while (ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                   sizeof (void *)) + n * c->obj_size > PGSIZE)
+    n--;
+  ASSERT (n > 0 && n < SLAB_END);
+  c->objs_per_slab = n;
+  c->obj_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                         sizeof (void *));
+
+  lock_init_named (&c->lock, name);
+  list_init (&c->partial);
+  list_init (&c->full);
+  c->slab_cnt = 0;
+  c->alloc_cnt = 0;
+  memset (c->mags, 0, sizeof c->mags);
+
+  lock_acquire (&kmem_caches_lock);
+  list_push_back (&kmem_caches, &c->elem);
+  lock_release (&kmem_caches_lock);
+  return c;
+}
+
+/* Obtains and returns an object from cache C, or a null pointer
+   if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  enum intr_level old_level;
+  struct magazine *m;
+  void *obj = NULL;
+
+  old_level = intr_disable ();
+  m = &c->mags[this_cpu ()->id];
+  if (m->cnt > 0)
+    obj = m->objs[--m->cnt];
+  intr_set_level (old_level);
+
+  if (obj == NULL)
+    {
+      lock_acquire (&c->lock);
+      obj = slab_alloc (c);
+      lock_release (&c->lock);
+    }
+  return obj;
+}
+
+/* Frees OBJ, which must have been obtained from cache C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  enum intr_level old_level;
+  struct magazine *m;
+  void *spill[MAGAZINE_SIZE / 2];
+  size_t i;
+
+  if (obj == NULL)
+    return;
+  ASSERT (obj_to_slab (c, obj) != NULL);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has to keep its constructed state. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  old_level = intr_disable ();
+  m = &c->mags[this_cpu ()->id];
+  if (m->cnt < MAGAZINE_SIZE)
+    {
+      m->objs[m->cnt++] = obj;
+      intr_set_level (old_level);
+      return;
+    }
+
+  /* The magazine is full: give back its older half, with OBJ, to
+     the slabs. */
+  memcpy (spill, m->objs, sizeof spill);
+  m->cnt -= MAGAZINE_SIZE / 2;
+  memmove (m->objs, m->objs + MAGAZINE_SIZE / 2, m->cnt * sizeof *m->objs);
+  intr_set_level (old_level);
+
+  lock_acquire (&c->lock);
+  for (i = 0; i < MAGAZINE_SIZE / 2; i++)
+    slab_free (c, spill[i]);
+  slab_free (c, obj);
+  lock_release (&c->lock);
+}
+
+/* Prints, for each cache, the objects in use and how much of its
+   slabs' memory they fill. */
+void
+kmem_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&kmem_caches); e != list_end (&kmem_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      size_t cached = 0;
+      size_t in_use;
+      unsigned i;
+
+      for (i = 0; i < cpu_cnt; i++)
+        cached += c->mags[i].cnt;
+      in_use = c->alloc_cnt - cached;
+      printf ("Slab %s: %zu objects in use, %zu cached, %zu slabs, "
+              "%zu%% utilization\n", c->name, in_use, cached, c->slab_cnt,
+              c->slab_cnt > 0
+              ? in_use * c->obj_size * 100 / (c->slab_cnt * PGSIZE) : 0);
+    }
+}
+
+/* Returns the IDX'th object in slab S of cache C. */
+static void *
+slab_obj (const struct kmem_cache *c, struct slab *s, size_t idx)
+{
+  return (uint8_t *) s + c->obj_ofs + idx * c->obj_size;
+}
+
+/* Takes a free object from C's slabs, adding a slab if none has
+   one.  Returns a null pointer if out of memory.  C's lock must be
+   held. */
+static void *
+slab_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t idx;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  if (list_empty (&c->partial))
+    {
+      s = palloc_get_page (0);
+      if (s == NULL)
+        return NULL;
+      s->magic = SLAB_MAGIC;
+      s->cache = c;
+      s->in_use = 0;
+      s->free = 0;
+      for (idx = 0; idx < c->objs_per_slab; idx++)
+        {
+          s->next[idx] = idx + 1 < c->objs_per_slab ? idx + 1 : SLAB_END;
+          if (c->ctor != NULL)
+            c->ctor (slab_obj (c, s, idx));
+        }
+      list_push_front (&c->partial, &s->elem);
+      c->slab_cnt++;
+    }
+
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  idx = s->free;
+  s->free = s->next[idx];
+  s->in_use++;
+  if (s->free == SLAB_END)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+  c->alloc_cnt++;
+  return slab_obj (c, s, idx);
+}
+
+/* Returns OBJ to its slab in C, freeing the slab if that leaves it
+   empty and another slab has free objects.  C's lock must be
+   held. */
+static void
+slab_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = obj_to_slab (c, obj);
+  size_t idx = ((uint8_t *) obj - (uint8_t *) s - c->obj_ofs) / c->obj_size;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+  ASSERT (s->in_use > 0);
+
+  if (s->free == SLAB_END)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  s->next[idx] = s->free;
+  s->free = idx;
+  s->in_use--;
+  c->alloc_cnt--;
+
+  if (s->in_use == 0 && list_begin (&c->partial) != list_rbegin (&c->partial))
+    {
+      list_remove (&s->elem);
+      s->magic = 0;
+      palloc_free_page (s);
+      c->slab_cnt--;
+    }
+}
+
+/* Returns the slab that OBJ, an object of cache C, is in. */
+static struct slab *
+obj_to_slab (const struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and OBJ is an object in it. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT ((size_t) pg_ofs (obj) >= c->obj_ofs);
+  ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->obj_size == 0);
+
+  return s;
+}
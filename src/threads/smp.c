@@ -0,0 +1,518 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/pagedir.h"
+#include "userprog/tss.h"
+#endif
+
+/* TASK 1: Symmetric multiprocessing.
+
+   At boot only the bootstrap processor (BSP) runs.  smp_init()
+   finds the other processors in the BIOS's MultiProcessor
+   Specification tables [MP], then starts each application
+   processor (AP) through its local APIC with the INIT-SIPI-SIPI
+   sequence.  Each AP runs the real-mode code in mpentry.S, which
+   brings it into protected mode with paging and calls
+   ap_main().
+
+   Only the BSP receives interrupts from the PIC, so on each timer
+   tick it sends a tick IPI to the other CPUs, which then do their
+   own scheduling.  With a single CPU none of this happens and the
+   kernel behaves exactly as before. */
+
+/* All CPUs.  cpus[0] is the BSP. */
+struct cpu cpus[SMP_MAX_CPUS];
+
+/* Number of CPUs online.  cpus[0...cpu_cnt - 1] are valid. */
+unsigned cpu_cnt = 1;
+
+/* True once the APs are being started.  From then on the giant
+   lock in interrupt.c is in use. */
+bool smp_active;
+
+/* Passed to mpentry.S and ap_main() for the AP being started. */
+uint32_t ap_boot_pgdir;         /* Physical address of page directory. */
+uint8_t *ap_boot_stack;         /* Initial stack pointer. */
+static struct cpu *ap_boot_cpu; /* CPU being started. */
+
+/* Start-up code in mpentry.S. */
+extern const uint8_t ap_start[], ap_start_end[];
+
+void ap_main (void) NO_RETURN;
+
+/* MP floating pointer structure.  See [MP] 4.1. */
+struct mp_fptr
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of mp_config. */
+    uint8_t length;             /* In 16-byte units. */
+    uint8_t revision;
+    uint8_t checksum;           /* All bytes sum to 0. */
+    uint8_t type;               /* 0 if mp_config is present. */
+    uint8_t imcr;
+    uint8_t reserved[3];
+  };
+
+/* MP configuration table header.  See [MP] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Including entries. */
+    uint8_t revision;
+    uint8_t checksum;           /* All bytes sum to 0. */
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_length;
+    uint16_t entry_cnt;
+    uint32_t lapic_addr;        /* Physical address of local APICs. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  };
+
+/* MP configuration table processor entry.  See [MP] 4.3.1.
+   The other entry types are all 8 bytes long. */
+struct mp_proc
+  {
+    uint8_t type;               /* MP_PROC. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;
+    uint8_t flags;              /* MP_PROC_* flags. */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+  };
+
+#define MP_PROC 0               /* Processor entry type. */
+#define MP_PROC_ENABLED 0x01    /* Processor is usable. */
+#define MP_PROC_BSP 0x02        /* Processor is the BSP. */
+
+/* Local APIC registers, as byte offsets.  See [IA32-v3a] 10.4.1
+   "The Local APIC Block Diagram". */
+#define LAPIC_ID    0x020       /* Local APIC ID. */
+#define LAPIC_TPR   0x080       /* Task priority. */
+#define LAPIC_EOI   0x0b0       /* End of interrupt. */
+#define LAPIC_SVR   0x0f0       /* Spurious interrupt vector. */
+#define LAPIC_ESR   0x280       /* Error status. */
+#define LAPIC_ICRLO 0x300       /* Interrupt command, low word. */
+#define LAPIC_ICRHI 0x310       /* Interrupt command, high word. */
+#define LAPIC_TIMER 0x320       /* LVT timer. */
+#define LAPIC_LINT0 0x350       /* LVT local interrupt 0. */
+#define LAPIC_LINT1 0x360       /* LVT local interrupt 1. */
+#define LAPIC_ERROR 0x370       /* LVT error. */
+
+#define SVR_ENABLE       0x00000100 /* APIC software enable. */
+#define LVT_MASKED       0x00010000 /* Interrupt masked. */
+#define LVT_NMI          0x00000400 /* NMI delivery mode. */
+#define LVT_EXTINT       0x00000700 /* ExtINT delivery mode. */
+#define ICR_INIT         0x00000500 /* INIT delivery mode. */
+#define ICR_STARTUP      0x00000600 /* STARTUP delivery mode. */
+#define ICR_BUSY         0x00001000 /* Delivery status: send pending. */
+#define ICR_ASSERT       0x00004000 /* Level assert. */
+#define ICR_LEVEL        0x00008000 /* Level triggered. */
+#define ICR_ALL_BUT_SELF 0x000c0000 /* Destination: all but self. */
+
+/* Page table entry bits for uncached memory-mapped I/O. */
+#define PTE_PWT 0x8             /* Write-through. */
+#define PTE_PCD 0x10            /* Cache disable. */
+
+/* Local APIC registers, mapped at the same virtual address as
+   their physical address.  Every CPU sees its own local APIC
+   there. */
+static volatile uint32_t *lapic;
+
+static size_t mp_probe (uint8_t ap_ids[SMP_MAX_CPUS], uint32_t *lapic_addr);
+static bool lapic_map (uint32_t paddr);
+static void lapic_init (bool bsp);
+static void lapic_ipi (uint8_t apic_id, uint32_t icr);
+static uint32_t *ap_pgdir_create (void);
+static bool start_ap (uint8_t apic_id);
+static intr_handler_func ipi_tick, ipi_resched, ipi_tlb;
+
+/* Finds the other processors and starts them.  Must be called
+   by the BSP with interrupts on, after the thread system and the
+   timer have been initialized. */
+void
+smp_init (void)
+{
+  uint8_t ap_ids[SMP_MAX_CPUS];
+  uint32_t lapic_addr;
+  uint32_t *pgdir;
+  size_t ap_cnt, i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  ap_cnt = mp_probe (ap_ids, &lapic_addr);
+  if (ap_cnt == 0 || !lapic_map (lapic_addr))
+    return;
+
+  lapic_init (true);
+  cpus[0].apic_id = lapic[LAPIC_ID / 4] >> 24;
+  intr_register_ipi (IPI_TICK, ipi_tick, "IPI Tick");
+  intr_register_ipi (IPI_RESCHED, ipi_resched, "IPI Reschedule");
+  intr_register_ipi (IPI_TLB, ipi_tlb, "IPI TLB Shootdown");
+
+  /* Copy the start-up code into low memory, where a STARTUP IPI
+     can reach it. */
+  memcpy (ptov (LOADER_AP_BASE), ap_start, ap_start_end - ap_start);
+  pgdir = ap_pgdir_create ();
+  ap_boot_pgdir = vtop (pgdir);
+
+  intr_start_smp ();
+  for (i = 0; i < ap_cnt; i++)
+    start_ap (ap_ids[i]);
+
+  palloc_free_page (pgdir);
+  printf ("SMP: %u CPUs online.\n", cpu_cnt);
+}
+
+/* Sends a tick IPI to every other CPU.  Called by the timer
+   interrupt handler on the BSP. */
+void
+smp_send_tick (void)
+{
+  if (smp_active)
+    lapic_ipi (0, IPI_TICK | ICR_ALL_BUT_SELF);
+}
+
+/* Asks idle CPU C to look for a thread to run. */
+void
+smp_send_resched (struct cpu *c)
+{
+  ASSERT (smp_active);
+  lapic_ipi (c->apic_id, IPI_RESCHED);
+}
+
+/* TASK 3 : Asks CPU C to flush the TLB entries that
+   pagedir_shootdown_ipi() is told about. */
+void
+smp_send_tlb (struct cpu *c)
+{
+  ASSERT (smp_active);
+  lapic_ipi (c->apic_id, IPI_TLB);
+}
+
+/* Acknowledges an IPI on the local APIC. */
+void
+lapic_eoi (void)
+{
+  lapic[LAPIC_EOI / 4] = 0;
+}
+
+/* Entry point of an AP, called by mpentry.S on the stack of the
+   AP's idle thread.  Interrupts are off and the giant lock is not
+   held. */
+void
+ap_main (void)
+{
+  struct cpu *c = ap_boot_cpu;
+
+  /* Leave the start-up page directory for the kernel's. */
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+
+  /* TASK 3 : The identity mapping of low memory shares its page
+     table with the kernel mapping, so its TLB entries may be
+     global, and survive the switch.  Only turning global pages off
+     and on again drops them. */
+  if (init_cr4 & CR4_PGE)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 & ~CR4_PGE) : "memory");
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4) : "memory");
+    }
+
+  intr_init_ap ();
+#ifdef USERPROG
+  gdt_init_ap (c->id);
+#endif
+  lapic_init (false);
+
+  /* Tell the BSP we are up, then wait until it counts us among
+     the online CPUs before taking part in scheduling. */
+  c->started = true;
+  while (!c->online)
+    asm volatile ("pause");
+
+  intr_start_ap ();
+  thread_start_ap ();
+}
+
+/* Returns the sum of the SIZE bytes starting at P. */
+static uint8_t
+sum (const void *p, size_t size)
+{
+  const uint8_t *b = p;
+  uint8_t s = 0;
+
+  while (size-- > 0)
+    s += *b++;
+  return s;
+}
+
+/* Looks for an MP floating pointer structure in the SIZE bytes of
+   physical memory at PADDR. */
+static struct mp_fptr *
+mp_search (uint32_t paddr, size_t size)
+{
+  uint8_t *p = ptov (paddr);
+  uint8_t *end = p + size;
+
+  for (; p + sizeof (struct mp_fptr) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && sum (p, sizeof (struct mp_fptr)) == 0)
+      return (struct mp_fptr *) p;
+  return NULL;
+}
+
+/* Reads the MP tables.  Stores the local APIC IDs of usable APs,
+   up to SMP_MAX_CPUS - 1 of them, in AP_IDS and the physical
+   address of the local APICs in *LAPIC_ADDR, and returns the
+   number of APs.  Returns 0 if there are no MP tables or they
+   describe a single processor.  See [MP] 4. */
+static size_t
+mp_probe (uint8_t ap_ids[SMP_MAX_CPUS], uint32_t *lapic_addr)
+{
+  const uint8_t *bda = ptov (0x400);
+  uint32_t ram_end = init_ram_pages * PGSIZE;
+  struct mp_fptr *mp;
+  struct mp_config *conf;
+  uint8_t *p, *end;
+  size_t ap_cnt = 0;
+
+  /* The floating pointer is in the first kB of the Extended BIOS
+     Data Area, the last kB of base memory, or the BIOS ROM. */
+  mp = mp_search (*(uint16_t *) (bda + 0x0e) << 4, 1024);
+  if (mp == NULL)
+    mp = mp_search (*(uint16_t *) (bda + 0x13) * 1024 - 1024, 1024);
+  if (mp == NULL)
+    mp = mp_search (0xf0000, 0x10000);
+  if (mp == NULL || mp->config == 0 || mp->type != 0)
+    return 0;
+
+  if (mp->config + sizeof *conf > ram_end)
+    return 0;
+  conf = ptov (mp->config);
+  if (memcmp (conf->signature, "PCMP", 4)
+      || mp->config + conf->length > ram_end
+      || sum (conf, conf->length) != 0)
+    return 0;
+  *lapic_addr = conf->lapic_addr;
+
+  p = (uint8_t *) (conf + 1);
+  end = (uint8_t *) conf + conf->length;
+  while (p < end)
+    {
+      struct mp_proc *proc = (struct mp_proc *) p;
+
+      if (proc->type != MP_PROC)
+        {
+          /* Bus, I/O APIC, and interrupt assignment entries. */
+          if (proc->type > 4)
+            break;
+          p += 8;
+          continue;
+        }
+
+      if ((proc->flags & MP_PROC_ENABLED) && !(proc->flags & MP_PROC_BSP))
+        {
+          if (ap_cnt < SMP_MAX_CPUS - 1)
+            ap_ids[ap_cnt++] = proc->apic_id;
+          else
+            printf ("smp: ignoring CPU with APIC ID %"PRIu8".\n",
+                    proc->apic_id);
+        }
+      p += sizeof *proc;
+    }
+  return ap_cnt;
+}
+
+/* Maps the local APIC registers at physical address PADDR into
+   the kernel page table, uncached, at the same virtual address.
+   This happens before any process page directory is created, so
+   they all inherit the mapping. */
+static bool
+lapic_map (uint32_t paddr)
+{
+  void *vaddr = (void *) paddr;
+  uint32_t *pde, *pt;
+
+  if (pg_ofs (vaddr) != 0
+      || vaddr < ptov (init_ram_pages * PGSIZE))
+    {
+      printf ("smp: local APIC at %#"PRIx32" cannot be mapped.\n", paddr);
+      return false;
+    }
+
+  pde = init_page_dir + pd_no (vaddr);
+  if (*pde == 0)
+    *pde = pde_create (palloc_get_page (PAL_ASSERT | PAL_ZERO));
+  pt = pde_get_pt (*pde);
+  pt[pt_no (vaddr)] = paddr | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+
+  lapic = vaddr;
+  return true;
+}
+
+/* Writes VALUE to local APIC register REG. */
+static void
+lapic_write (int reg, uint32_t value)
+{
+  lapic[reg / 4] = value;
+}
+
+/* Enables the local APIC of the CPU we are running on.  On the
+   BSP the PIC stays connected through LINT0, in virtual wire
+   mode; on APs it is masked so that only the BSP sees device
+   interrupts.  See [IA32-v3a] 10.4.3 "Enabling or Disabling the
+   Local APIC". */
+static void
+lapic_init (bool bsp)
+{
+  lapic_write (LAPIC_SVR, SVR_ENABLE | IPI_SPURIOUS);
+  lapic_write (LAPIC_TIMER, LVT_MASKED);
+  lapic_write (LAPIC_LINT0, bsp ? LVT_EXTINT : LVT_MASKED);
+  lapic_write (LAPIC_LINT1, bsp ? LVT_NMI : LVT_MASKED);
+  lapic_write (LAPIC_ERROR, LVT_MASKED);
+
+  /* Clear the error status, which takes back-to-back writes, and
+     any interrupt left unacknowledged. */
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_EOI, 0);
+
+  /* Accept interrupts of every priority. */
+  lapic_write (LAPIC_TPR, 0);
+}
+
+/* Sends an IPI described by ICR to the local APIC with ID
+   APIC_ID, and waits until it has been sent. */
+static void
+lapic_ipi (uint8_t apic_id, uint32_t icr)
+{
+  enum intr_level old_level = intr_disable ();
+
+  lapic_write (LAPIC_ICRHI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICRLO, icr);
+  while (lapic[LAPIC_ICRLO / 4] & ICR_BUSY)
+    asm volatile ("pause");
+
+  intr_set_level (old_level);
+}
+
+/* Returns a page directory for APs to start with: the kernel
+   mappings, plus the first 4 MB of physical memory mapped at
+   virtual address 0 so that the start-up code can turn on paging
+   while running from low memory. */
+static uint32_t *
+ap_pgdir_create (void)
+{
+  uint32_t *pd = palloc_get_page (PAL_ASSERT);
+
+  memcpy (pd, init_page_dir, PGSIZE);
+  pd[0] = init_page_dir[pd_no (PHYS_BASE)];
+  return pd;
+}
+
+/* Starts the AP with local APIC ID APIC_ID as the next CPU in
+   cpus[], waiting until it is up.  Returns false if it could not
+   be started, in which case it is held in reset and its slot in
+   cpus[] is free for the next AP. */
+static bool
+start_ap (uint8_t apic_id)
+{
+  struct cpu *c = &cpus[cpu_cnt];
+  enum intr_level old_level;
+  int64_t start;
+  int i;
+
+  c->id = cpu_cnt;
+  c->apic_id = apic_id;
+  if (!thread_init_cpu (c))
+    return false;
+#ifdef USERPROG
+  tss_init_cpu (c->id);
+#endif
+  ap_boot_cpu = c;
+  ap_boot_stack = (uint8_t *) c->idle + PGSIZE;
+
+  /* INIT, then two STARTUPs naming the page with the start-up
+     code.  See [MP] B.4 "Application Processor Startup". */
+  lapic_ipi (apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  timer_udelay (200);
+  lapic_ipi (apic_id, ICR_INIT | ICR_LEVEL);
+  timer_mdelay (10);
+  for (i = 0; i < 2; i++)
+    {
+      lapic_ipi (apic_id, ICR_STARTUP | (LOADER_AP_BASE >> PGBITS));
+      timer_udelay (200);
+    }
+
+  start = timer_ticks ();
+  while (!c->started && timer_elapsed (start) < TIMER_FREQ)
+    barrier ();
+  if (!c->started)
+    {
+      /* The AP might still come up later, on the stack and the
+         cpus[] slot that the next AP will be given.  Assert INIT
+         and leave it asserted, which holds the AP in reset until
+         the next STARTUP, which is never sent, and only then give
+         back what it was given. */
+      lapic_ipi (apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+      timer_udelay (200);
+      printf ("smp: CPU with APIC ID %"PRIu8" did not start.\n", apic_id);
+      ap_boot_cpu = NULL;
+      ap_boot_stack = NULL;
+#ifdef USERPROG
+      tss_free_cpu (c->id);
+#endif
+      thread_free_cpu (c);
+      memset (c, 0, sizeof *c);
+      return false;
+    }
+
+  old_level = intr_disable ();
+  c->online = true;
+  cpu_cnt++;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Tick IPI handler: the BSP saw a timer interrupt. */
+static void
+ipi_tick (struct intr_frame *args)
+{
+  thread_tick ();
+  profile_tick (args);
+}
+
+/* Reschedule IPI handler: another CPU made threads ready while
+   we were idle. */
+static void
+ipi_resched (struct intr_frame *args UNUSED)
+{
+  intr_yield_on_return ();
+}
+
+/* TASK 3 : TLB shootdown IPI handler: another CPU changed a page
+   table that we may have cached. */
+static void
+ipi_tlb (struct intr_frame *args UNUSED)
+{
+#ifdef USERPROG
+  pagedir_shootdown_ipi ();
+#endif
+}
@@ -0,0 +1,81 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+/* TASK 1: Symmetric multiprocessing. */
+
+/* Maximum number of CPUs brought up. */
+#define SMP_MAX_CPUS 8
+
+/* Number of run queue levels, one per priority. */
+#define RQ_LEVELS (PRI_MAX - PRI_MIN + 1)
+
+/* Interrupt vectors used for inter-processor interrupts (IPIs).
+   These are delivered by the local APIC rather than the PIC. */
+#define IPI_TICK     0xf0       /* Timer tick, broadcast by the BSP. */
+#define IPI_RESCHED  0xf1       /* Ready threads are waiting. */
+#define IPI_TLB      0xf2       /* TLB entries must be flushed. */
+#define IPI_SPURIOUS 0xff       /* Local APIC spurious interrupt. */
+
+/* Per-CPU state.  cpus[0] is always the bootstrap processor (BSP)
+   that ran the loader; the rest are application processors (APs)
+   started by smp_init(). */
+struct cpu
+  {
+    unsigned id;                        /* Index into cpus[]. */
+    uint8_t apic_id;                    /* Local APIC ID. */
+    volatile bool started;              /* Set by an AP once it is up. */
+    volatile bool online;               /* Set by the BSP to release an AP. */
+
+    /* Owned by thread.c. */
+    struct thread *cur;                 /* Running thread. */
+    struct thread *idle;                /* This CPU's idle thread. */
+    struct list ready_queues[RQ_LEVELS];/* One FIFO per priority level. */
+    uint64_t ready_bitmap;              /* Bit P set iff ready_queues[P]
+                                           non-empty. */
+    size_t ready_cnt;                   /* # of threads in the run queue. */
+    unsigned thread_ticks;              /* # of timer ticks since last yield. */
+    long long idle_ticks;               /* # of timer ticks spent idle. */
+    long long kernel_ticks;             /* # of timer ticks in kernel threads. */
+    long long user_ticks;               /* # of timer ticks in user programs. */
+
+    /* Owned by interrupt.c. */
+    bool in_external_intr;              /* Processing an external interrupt? */
+    bool yield_on_return;               /* Yield on interrupt return? */
+
+#ifdef USERPROG
+    /* Owned by userprog/pagedir.c. */
+    uint32_t *pagedir;                  /* Page directory in CR3. */
+#endif
+  };
+
+extern struct cpu cpus[SMP_MAX_CPUS];
+extern unsigned cpu_cnt;
+extern bool smp_active;
+
+void smp_init (void);
+void smp_send_tick (void);
+void smp_send_resched (struct cpu *);
+void smp_send_tlb (struct cpu *);
+void lapic_eoi (void);
+
+/* Returns the CPU we are running on.
+
+   Until the APs are started everything runs on the BSP.  After
+   that, schedule() keeps each running thread's `cpu' member up
+   to date; interrupts must be off, since otherwise the caller
+   could migrate to another CPU as soon as this returns. */
+static inline struct cpu *
+this_cpu (void)
+{
+  if (!smp_active)
+    return &cpus[0];
+  return running_thread ()->cpu;
+}
+
+#endif /* threads/smp.h */
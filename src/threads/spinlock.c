@@ -0,0 +1,68 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include "threads/synch.h"
+
+/* Atomically stores NEW into *P and returns the old value.
+   `xchg' with a memory operand is implicitly locked.  See
+   [IA32-v2b] "XCHG". */
+static inline uint32_t
+xchg (volatile uint32_t *p, uint32_t new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Initializes spinlock L as released. */
+void
+spinlock_init (struct spinlock *l)
+{
+  ASSERT (l != NULL);
+  l->locked = 0;
+}
+
+/* Acquires spinlock L, busy-waiting until it is available. */
+void
+spinlock_acquire (struct spinlock *l)
+{
+  ASSERT (l != NULL);
+
+  while (xchg (&l->locked, 1) != 0)
+    {
+      /* Spin on a plain read until the lock looks free, so that
+         waiting CPUs don't keep stealing the cache line from the
+         holder.  `pause' tells the CPU this is a spin-wait loop.
+         See [IA32-v2b] "PAUSE". */
+      while (l->locked != 0)
+        asm volatile ("pause");
+    }
+}
+
+/* Tries to acquire spinlock L without waiting.  Returns true if
+   successful, false if L was already held. */
+bool
+spinlock_try_acquire (struct spinlock *l)
+{
+  ASSERT (l != NULL);
+  return xchg (&l->locked, 1) == 0;
+}
+
+/* Releases spinlock L, which the caller must hold. */
+void
+spinlock_release (struct spinlock *l)
+{
+  ASSERT (spinlock_held (l));
+
+  /* x86 does not reorder stores with earlier loads or stores, so
+     a compiler barrier is enough to keep the critical section's
+     accesses before the releasing store. */
+  barrier ();
+  l->locked = 0;
+}
+
+/* Returns true if spinlock L is held by some CPU. */
+bool
+spinlock_held (const struct spinlock *l)
+{
+  ASSERT (l != NULL);
+  return l->locked != 0;
+}
@@ -0,0 +1,24 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* TASK 1: A spinlock, for mutual exclusion between CPUs.
+
+   Unlike a `struct lock', a spinlock never sleeps: a CPU that
+   finds it held busy-waits until it is released.  It must
+   therefore only be held for short periods, and a CPU must not
+   try to acquire a spinlock it already holds. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* Nonzero while held. */
+  };
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+bool spinlock_try_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held (const struct spinlock *);
+
+#endif /* threads/spinlock.h */
@@ -30,7 +30,11 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+static void sema_block (struct semaphore *);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -67,16 +71,25 @@ sema_down (struct semaphore *sema)
 
   old_level = intr_disable ();
   while (sema->value == 0)
-    {
-      //TASK 1
-      donate_priority();
-      list_push_back (&sema->waiters, &thread_current ()->elem);
-      thread_block ();
-    }
+    sema_block (sema);
   sema->value--;
   intr_set_level (old_level);
 }
 
+/* TASK 1: Waits once on SEMA, whose value is 0, until sema_up()
+   wakes the current thread.  The value may be 0 again by the time
+   it runs, so the caller must check it again.  Interrupts must be
+   off. */
+static void
+sema_block (struct semaphore *sema)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  donate_priority();
+  list_push_back (&sema->waiters, &thread_current ()->elem);
+  thread_block ();
+}
+
 /* Down or "P" operation on a semaphore, but only if the
    semaphore is not already 0.  Returns true if the semaphore is
    decremented, false otherwise.
@@ -116,6 +129,14 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)) {
+    /* TASK 1: Blocked threads' MLFQS priorities are only brought up
+       to date lazily, so refresh the waiters before choosing one. */
+    if (thread_mlfqs) {
+      struct list_elem *e;
+      for (e = list_begin (&sema->waiters); e != list_end (&sema->waiters);
+           e = list_next (e))
+        thread_mlfqs_refresh (list_entry (e, struct thread, elem));
+    }
     list_sort(&sema->waiters, &is_lower_priority, NULL);
     thread_unblock (list_entry (list_pop_front (&sema->waiters),
                                 struct thread, elem));
@@ -189,6 +210,214 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->stat = NULL;
+  lock->hold_start = 0;
+}
+
+/* TASK 1: Lock profiling.
+
+   With the "-o=lockstat" kernel command-line option, every lock
+   initialized with lock_init_named() counts its acquisitions,
+   how many of them found the lock held, the total time spent
+   waiting for it and the longest time it was held.  Locks
+   sharing a name, such as the per-frame locks, share a record.
+   Locks set up with plain lock_init() are never profiled, and
+   nothing is recorded when profiling is off. */
+bool lock_profiling;
+
+/* Profile record for the locks with a given name. */
+struct lock_stat
+  {
+    const char *name;           /* Name passed to lock_init_named(). */
+    unsigned acquired;          /* Number of acquisitions. */
+    unsigned contended;         /* Acquisitions that found it held. */
+    int64_t wait_ns;            /* Total time spent waiting, in ns. */
+    int64_t max_hold_ns;        /* Longest time held, in ns. */
+  };
+
+/* Maximum number of distinct lock names profiled. */
+#define LOCK_STAT_MAX 32
+
+static struct lock_stat lock_stats[LOCK_STAT_MAX];
+static size_t lock_stat_cnt;
+
+/* Initializes LOCK like lock_init() and, if lock profiling is
+   on, attaches it to the profile record for NAME, which must
+   remain valid for as long as the kernel runs. */
+void
+lock_init_named (struct lock *lock, const char *name)
+{
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (name != NULL);
+
+  lock_init (lock);
+  if (!lock_profiling)
+    return;
+
+  old_level = intr_disable ();
+  for (i = 0; i < lock_stat_cnt; i++)
+    if (!strcmp (lock_stats[i].name, name))
+      break;
+  if (i == lock_stat_cnt && lock_stat_cnt < LOCK_STAT_MAX)
+    lock_stats[lock_stat_cnt++].name = name;
+  if (i < lock_stat_cnt)
+    lock->stat = &lock_stats[i];
+  intr_set_level (old_level);
+}
+
+/* Records that the current thread just acquired profiled LOCK,
+   having started to wait for it at WAIT_START, or with
+   WAIT_START negative if it was free. */
+static void
+lock_stat_acquired (struct lock *lock, int64_t wait_start)
+{
+  struct lock_stat *stat = lock->stat;
+  int64_t now = timer_now_ns ();
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  stat->acquired++;
+  if (wait_start >= 0)
+    {
+      stat->contended++;
+      stat->wait_ns += now - wait_start;
+    }
+  intr_set_level (old_level);
+
+  lock->hold_start = now;
+}
+
+/* Records that the current thread is about to release profiled
+   LOCK. */
+static void
+lock_stat_released (struct lock *lock)
+{
+  struct lock_stat *stat = lock->stat;
+  int64_t held = timer_now_ns () - lock->hold_start;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (held > stat->max_hold_ns)
+    stat->max_hold_ns = held;
+  intr_set_level (old_level);
+}
+
+/* Returns true if lock_stat A has waited less in total than B. */
+static bool
+lock_stat_less (const struct lock_stat *a, const struct lock_stat *b)
+{
+  return a->wait_ns < b->wait_ns;
+}
+
+/* Prints the lock profile, most waited-for locks first.  Does
+   nothing unless lock profiling is on. */
+void
+lock_print_stats (void)
+{
+  struct lock_stat sorted[LOCK_STAT_MAX];
+  enum intr_level old_level;
+  size_t cnt, i, j;
+
+  if (!lock_profiling)
+    return;
+
+  /* Take a consistent snapshot, then insertion sort it by total
+     wait time. */
+  old_level = intr_disable ();
+  cnt = lock_stat_cnt;
+  memcpy (sorted, lock_stats, cnt * sizeof *sorted);
+  intr_set_level (old_level);
+
+  for (i = 1; i < cnt; i++)
+    {
+      struct lock_stat s = sorted[i];
+      for (j = i; j > 0 && lock_stat_less (&sorted[j - 1], &s); j--)
+        sorted[j] = sorted[j - 1];
+      sorted[j] = s;
+    }
+
+  printf ("Lock profile:\n");
+  printf ("  %-16s %10s %10s %12s %12s\n",
+          "lock", "acquired", "contended", "wait (us)", "max hold (us)");
+  for (i = 0; i < cnt; i++)
+    printf ("  %-16s %10u %10u %12lld %12lld\n",
+            sorted[i].name, sorted[i].acquired, sorted[i].contended,
+            sorted[i].wait_ns / 1000, sorted[i].max_hold_ns / 1000);
+}
+
+/* TASK 1: Adaptive spinning.
+
+   Blocking on a lock costs two trips through schedule(), which
+   is wasted if the holder is running on another CPU and about to
+   release it.  So, with interrupts on, lock_acquire() first spins
+   for as long as the holder keeps running, up to LOCK_SPIN_MAX
+   iterations.  It gives up as soon as the holder blocks or is
+   preempted, since then it won't release the lock soon and may
+   need our priority donated, or as soon as other threads are
+   blocked on the lock, so that we don't barge ahead of a
+   higher-priority waiter.
+
+   The spinner reads the lock's holder and semaphore without the
+   giant lock.  Those reads are only hints; the lock is taken
+   with lock_try_acquire() as usual.  Set to false by the
+   "-nospin" kernel command-line option. */
+bool lock_adaptive = true;
+
+/* Maximum number of iterations to spin on a lock. */
+#define LOCK_SPIN_MAX 16384
+
+/* Takes LOCK if it is free, without profiling or waiting.
+   Returns true if successful. */
+static bool
+lock_take (struct lock *lock)
+{
+  enum intr_level old_level = intr_disable ();
+  bool success = lock->semaphore.value > 0;
+
+  if (success)
+    {
+      lock->semaphore.value--;
+      thread_current ()->lock_waiting = NULL;
+      lock->holder = thread_current ();
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* TASK 1: Spins while LOCK's holder is running on another CPU,
+   trying to acquire LOCK.  Returns true if successful, false if
+   the caller should block instead. */
+static bool
+lock_spin (struct lock *lock)
+{
+  unsigned spins;
+
+  if (!lock_adaptive || !smp_active || intr_get_level () == INTR_OFF)
+    return false;
+
+  for (spins = 0; spins < LOCK_SPIN_MAX; spins++)
+    {
+      struct thread *holder = *(struct thread *volatile *) &lock->holder;
+
+      if (*(volatile unsigned *) &lock->semaphore.value != 0)
+        {
+          if (lock_take (lock))
+            return true;
+          continue;
+        }
+
+      /* HOLDER is null while the lock changes hands, in which
+         case keep spinning.  A holder that has since exited
+         leaves a stale pointer, but its page stays mapped, so
+         reading its status is harmless. */
+      if ((holder != NULL && holder->status != THREAD_RUNNING)
+          || !list_empty (&lock->semaphore.waiters))
+        return false;
+      asm volatile ("pause");
+    }
+  return false;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -202,10 +431,30 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int64_t wait_start = -1;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  /* TASK 1: Note when a profiled lock's wait starts, if it has
+     to wait at all. */
+  if (lock->stat != NULL)
+    {
+      if (lock_take (lock))
+        {
+          lock_stat_acquired (lock, -1);
+          return;
+        }
+      wait_start = timer_now_ns ();
+    }
+
+  /* TASK 1: Spin briefly if the holder is running elsewhere. */
+  if (lock_spin (lock))
+    goto acquired;
+
   /*
   When new thread tries to acquire the lock, using lock_acquire,
   the lock_acquire function checks the priority of the thread which has the
@@ -214,16 +463,31 @@ lock_acquire (struct lock *lock)
   */
 
   /* TASK 1: If in priority donation mode, set thread as waiting for the lock
-             and insert current's donation_thread into list threads_donated */
-  if(!thread_mlfqs && lock->holder != NULL) {
-    thread_current()->lock_waiting = lock;
-    list_insert_ordered(&lock->holder->threads_donated,
-                &thread_current()->donation_thread, &is_lower_priority, NULL);
+             and insert current's donation_thread into list threads_donated.
+             With interrupts off no other CPU can release the lock, so the
+             holder read here stays valid until the insertion is done.  Each
+             time the thread wakes up to find the lock taken again, it donates
+             to whoever took it. */
+  old_level = intr_disable ();
+  if (lock->semaphore.value == 0)
+    cur->stats.lock_blocks++;
+  while (lock->semaphore.value == 0) {
+    struct thread *holder = lock->holder;
+    if (!thread_mlfqs && holder != NULL) {
+      cur->lock_waiting = lock;
+      list_insert_ordered (&holder->threads_donated,
+                           &cur->donation_thread, &is_lower_priority, NULL);
+    }
+    sema_block (&lock->semaphore);
   }
+  lock->semaphore.value--;
+  cur->lock_waiting = NULL;
+  lock->holder = cur;
+  intr_set_level (old_level);
 
-  sema_down (&lock->semaphore);
-  thread_current()->lock_waiting = NULL;
-  lock->holder = thread_current();
+ acquired:
+  if (lock->stat != NULL)
+    lock_stat_acquired (lock, wait_start);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -240,11 +504,9 @@ lock_try_acquire (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
-  success = sema_try_down (&lock->semaphore);
-  if (success) {
-    thread_current()->lock_waiting = NULL;
-    lock->holder = thread_current ();
-  }
+  success = lock_take (lock);
+  if (success && lock->stat != NULL)
+    lock_stat_acquired (lock, -1);
   return success;
 }
 
@@ -256,16 +518,26 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock)
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  if (lock->stat != NULL)
+    lock_stat_released (lock);
+
+  /* TASK 1: Interrupts stay off from clearing the holder until the
+     lock is free, so that a thread acquiring it on another CPU sees
+     either the holder with its list of donors intact or no holder
+     and a free lock. */
+  old_level = intr_disable ();
   lock->holder = NULL;
-  //TASK 1
   if(!thread_mlfqs) {
     remove_with_lock(lock);
     update_priority();
   }
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -280,6 +552,294 @@ lock_held_by_current_thread (const struct lock *lock)
 }
 
 
+/* TASK 1: A thread waiting in rwlock_acquire_shared() or
+   rwlock_acquire_exclusive(). */
+struct rwlock_waiter
+  {
+    struct list_elem elem;      /* In read_waiters or write_waiters. */
+    struct thread *thread;      /* Waiting thread. */
+    bool granted;               /* Set by the thread that hands it over. */
+  };
+
+static void rwlock_wait (struct rwlock *, struct list *queue);
+static void rwlock_grant (struct rwlock *, bool after_writer);
+static void rwlock_donate (struct rwlock *, int priority);
+static struct rwlock_hold *rwlock_hold_add (struct thread *,
+                                            struct rwlock *);
+static struct rwlock_hold *rwlock_hold_find (struct thread *,
+                                             const struct rwlock *);
+
+/* Initializes RW as a reader-writer lock that is not held. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  rw->writer = NULL;
+  list_init (&rw->readers);
+  list_init (&rw->read_waiters);
+  list_init (&rw->write_waiters);
+}
+
+/* Acquires RW for shared access, sleeping until no thread holds
+   or is waiting for it exclusively.  The current thread must not
+   already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_shared (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer == NULL && list_empty (&rw->write_waiters))
+    list_push_back (&rw->readers, &rwlock_hold_add (cur, rw)->elem);
+  else
+    rwlock_wait (rw, &rw->read_waiters);
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for exclusive access, sleeping until no other
+   thread holds it.  The current thread must not already hold
+   RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_exclusive (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer == NULL && list_empty (&rw->readers))
+    {
+      rw->writer = cur;
+      rwlock_hold_add (cur, rw);
+    }
+  else
+    rwlock_wait (rw, &rw->write_waiters);
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold shared. */
+void
+rwlock_release_shared (struct rwlock *rw)
+{
+  struct rwlock_hold *h;
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  h = rwlock_hold_find (thread_current (), rw);
+  ASSERT (h != NULL && rw->writer != thread_current ());
+  list_remove (&h->elem);
+  h->rwlock = NULL;
+
+  if (list_empty (&rw->readers))
+    rwlock_grant (rw, false);
+  if (!thread_mlfqs)
+    update_priority ();
+  check_max_priority ();
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold exclusively. */
+void
+rwlock_release_exclusive (struct rwlock *rw)
+{
+  struct rwlock_hold *h;
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  h = rwlock_hold_find (thread_current (), rw);
+  ASSERT (h != NULL && rw->writer == thread_current ());
+  h->rwlock = NULL;
+  rw->writer = NULL;
+
+  rwlock_grant (rw, true);
+  if (!thread_mlfqs)
+    update_priority ();
+  check_max_priority ();
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds RW, shared or
+   exclusively. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rwlock_hold_find (thread_current (), rw) != NULL;
+}
+
+/* Returns the highest priority of any thread waiting for RW, or
+   PRI_MIN - 1 if none is.  Interrupts must be off. */
+int
+rwlock_max_waiter_priority (struct rwlock *rw)
+{
+  struct list *queues[2] = { &rw->read_waiters, &rw->write_waiters };
+  int max = PRI_MIN - 1;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < 2; i++)
+    {
+      struct list_elem *e;
+      for (e = list_begin (queues[i]); e != list_end (queues[i]);
+           e = list_next (e))
+        {
+          struct rwlock_waiter *w = list_entry (e, struct rwlock_waiter,
+                                                elem);
+          if (w->thread->priority > max)
+            max = w->thread->priority;
+        }
+    }
+  return max;
+}
+
+/* Queues the current thread on QUEUE, one of RW's wait queues,
+   donates its priority to RW's holders, and blocks until a
+   releasing thread hands RW over to it.  Interrupts must be
+   off. */
+static void
+rwlock_wait (struct rwlock *rw, struct list *queue)
+{
+  struct rwlock_waiter w;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  w.thread = thread_current ();
+  w.granted = false;
+  w.thread->stats.lock_blocks++;
+  list_push_back (queue, &w.elem);
+  rwlock_donate (rw, w.thread->priority);
+
+  while (!w.granted)
+    thread_block ();
+}
+
+/* Returns true if rwlock_waiter A has lower priority than B. */
+static bool
+rwlock_waiter_less (const struct list_elem *a, const struct list_elem *b,
+                    void *aux UNUSED)
+{
+  return (list_entry (a, struct rwlock_waiter, elem)->thread->priority
+          < list_entry (b, struct rwlock_waiter, elem)->thread->priority);
+}
+
+/* Hands RW over to the waiters that may have it now that it has
+   no writer.  If AFTER_WRITER is true, all the waiting readers
+   are let in, even if writers are waiting too.  Otherwise, the
+   highest-priority waiting writer is preferred once there are no
+   readers.  Interrupts must be off. */
+static void
+rwlock_grant (struct rwlock *rw, bool after_writer)
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (rw->writer == NULL);
+
+  if (list_empty (&rw->readers) && !list_empty (&rw->write_waiters)
+      && !(after_writer && !list_empty (&rw->read_waiters)))
+    {
+      struct rwlock_waiter *w;
+
+      w = list_entry (list_max (&rw->write_waiters, rwlock_waiter_less, NULL),
+                      struct rwlock_waiter, elem);
+      list_remove (&w->elem);
+      rw->writer = w->thread;
+      rwlock_hold_add (w->thread, rw);
+      w->granted = true;
+      thread_unblock (w->thread);
+    }
+  else
+    while (!list_empty (&rw->read_waiters))
+      {
+        struct rwlock_waiter *w = list_entry (list_pop_front (&rw->read_waiters),
+                                              struct rwlock_waiter, elem);
+        list_push_back (&rw->readers, &rwlock_hold_add (w->thread, rw)->elem);
+        w->granted = true;
+        thread_unblock (w->thread);
+      }
+
+  /* The threads still waiting donated to the old holders, so
+     donate again to the new ones. */
+  for (e = list_begin (&rw->write_waiters); e != list_end (&rw->write_waiters);
+       e = list_next (e))
+    rwlock_donate (rw, list_entry (e, struct rwlock_waiter,
+                                   elem)->thread->priority);
+  for (e = list_begin (&rw->read_waiters); e != list_end (&rw->read_waiters);
+       e = list_next (e))
+    rwlock_donate (rw, list_entry (e, struct rwlock_waiter,
+                                   elem)->thread->priority);
+}
+
+/* Donates PRIORITY to every thread that holds RW.  Interrupts
+   must be off. */
+static void
+rwlock_donate (struct rwlock *rw, int priority)
+{
+  struct list_elem *e;
+
+  if (thread_mlfqs)
+    return;
+
+  if (rw->writer != NULL)
+    donate_priority_to (rw->writer, priority);
+  for (e = list_begin (&rw->readers); e != list_end (&rw->readers);
+       e = list_next (e))
+    donate_priority_to (list_entry (e, struct rwlock_hold, elem)->thread,
+                        priority);
+}
+
+/* Records that thread T holds RW in a free slot of T's
+   rwlock_holds[] and returns the slot.  Panics if T already holds
+   RWLOCK_HOLD_MAX rwlocks. */
+static struct rwlock_hold *
+rwlock_hold_add (struct thread *t, struct rwlock *rw)
+{
+  int i;
+
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+    if (t->rwlock_holds[i].rwlock == NULL)
+      {
+        t->rwlock_holds[i].rwlock = rw;
+        t->rwlock_holds[i].thread = t;
+        return &t->rwlock_holds[i];
+      }
+  PANIC ("%s holds more than %d rwlocks", t->name, RWLOCK_HOLD_MAX);
+}
+
+/* Returns the slot of T's rwlock_holds[] recording that T holds
+   RW, or a null pointer if T does not hold RW. */
+static struct rwlock_hold *
+rwlock_hold_find (struct thread *t, const struct rwlock *rw)
+{
+  int i;
+
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+    if (t->rwlock_holds[i].rwlock == rw)
+      return &t->rwlock_holds[i];
+  return NULL;
+}
+
 /* TASK 1: Function used as criterium to sort list of semaphores
            priority-wise */
 static bool is_lower_sema_priority(const struct list_elem *a,
@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore
@@ -30,13 +31,61 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct lock_stat *stat;     /* TASK 1: Profile record, or null. */
+    int64_t hold_start;         /* TASK 1: When the holder took it, in ns,
+                                   if profiled. */
   };
 
+/* TASK 1: Spin on contended locks whose holder is running? */
+extern bool lock_adaptive;
+
+/* TASK 1: Profile named locks? */
+extern bool lock_profiling;
+
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_print_stats (void);
+
+/* TASK 1: Reader-writer lock.
+
+   Any number of threads may hold an rwlock shared, or a single
+   thread may hold it exclusively.  Threads that want it shared
+   queue behind any thread waiting for it exclusively, so that a
+   steady stream of readers cannot starve a writer; when a writer
+   releases it, every queued reader gets in before the next
+   writer.  A thread that waits donates its priority to all of the
+   rwlock's holders. */
+struct rwlock
+  {
+    struct thread *writer;      /* Exclusive holder, or NULL. */
+    struct list readers;        /* rwlock_holds of shared holders. */
+    struct list read_waiters;   /* Threads waiting to share it. */
+    struct list write_waiters;  /* Threads waiting to hold it alone. */
+  };
+
+/* TASK 1: One rwlock held by a thread.  Each thread has
+   RWLOCK_HOLD_MAX of these, so that is the most rwlocks it may
+   hold at once. */
+struct rwlock_hold
+  {
+    struct rwlock *rwlock;      /* The rwlock, or NULL if unused. */
+    struct thread *thread;      /* Holding thread. */
+    struct list_elem elem;      /* In rwlock's `readers' if shared. */
+  };
+
+#define RWLOCK_HOLD_MAX 4
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_shared (struct rwlock *);
+void rwlock_acquire_exclusive (struct rwlock *);
+void rwlock_release_shared (struct rwlock *);
+void rwlock_release_exclusive (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+int rwlock_max_waiter_priority (struct rwlock *);
 
 /* Condition variable. */
 struct condition
@@ -9,13 +9,16 @@
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/fixedpointrealarith.h"
 #include "devices/timer.h"
 #ifdef USERPROG
+#include "threads/slab.h"
 #include "userprog/process.h"
+#include "userprog/syscall.h"
 #endif
 
 /* Random value for struct thread's `magic' member.
@@ -23,18 +26,23 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running.
-   Implemented as a priority-based sorted list. */
-static struct list ready_list;
+/* Run queues of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+
+   TASK 1: Each CPU has its own run queue in its `struct cpu'
+   (see smp.h), so that CPUs normally pick threads without
+   looking at each other's.  A run queue has one FIFO list per
+   priority level, plus a bitmap with bit P set whenever the list
+   for priority P is non-empty.  Enqueueing appends to a single
+   list and picking the next thread is a single bit scan, so
+   neither depends on the number of ready threads.  A CPU whose
+   run queue is empty, or holds only lower-priority threads than
+   another CPU's, steals from that CPU. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
@@ -49,14 +57,9 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
-
-/* Scheduling. */
+/* Scheduling.  Statistics and the number of timer ticks since
+   the last yield are kept per CPU, in `struct cpu'. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -65,10 +68,17 @@ bool thread_mlfqs;
 
 int load_avg;
 
+/* TASK 1: Number of seconds (load_avg updates) since boot.
+   Threads that are not running or ready do not have their
+   recent_cpu decayed every second; instead each thread records
+   in mlfqs_stamp the second it was last updated for, and catches
+   up in one step when it next becomes ready. */
+static unsigned mlfqs_seconds;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
-static struct thread *running_thread (void);
+static void idle_loop (void) NO_RETURN;
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
@@ -77,6 +87,16 @@ static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 
+static void ready_init (struct cpu *);
+static void ready_push (struct cpu *, struct thread *);
+static void ready_remove (struct thread *);
+static struct thread *ready_peek_max (struct cpu *);
+static struct cpu *ready_steal_victim (struct cpu *, int priority);
+static void thread_requeue (struct thread *, int priority);
+static void wake_idle_cpu (void);
+static bool all_cpus_idle (void);
+static void mlfqs_refresh_ready (struct cpu *);
+
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
@@ -95,16 +115,68 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  lock_init_named (&tid_lock, "tid_lock");
+  ready_init (&cpus[0]);
   list_init (&all_list);
 
-
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  initial_thread->cpu = &cpus[0];
+  cpus[0].cur = initial_thread;
+}
+
+/* TASK 1: Prepares the run queue and idle thread of CPU C, an AP
+   that smp_init() is about to start.  The idle thread is marked
+   running, because the AP starts out on its stack.  Returns
+   false if out of memory. */
+bool
+thread_init_cpu (struct cpu *c)
+{
+  struct thread *t;
+  char name[16];
+
+  t = palloc_get_page (PAL_ZERO);
+  if (t == NULL)
+    return false;
+
+  snprintf (name, sizeof name, "idle%u", c->id);
+  init_thread (t, name, PRI_MIN);
+  t->tid = allocate_tid ();
+  t->status = THREAD_RUNNING;
+  t->cpu = c;
+
+  ready_init (c);
+  c->idle = c->cur = t;
+  return true;
+}
+
+/* TASK 1: Frees the idle thread of CPU C, an AP that failed to
+   start, undoing thread_init_cpu(). */
+void
+thread_free_cpu (struct cpu *c)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  list_remove (&c->idle->allelem);
+  intr_set_level (old_level);
+
+  palloc_free_page (c->idle);
+  c->idle = c->cur = NULL;
+}
+
+/* TASK 1: Runs an AP's idle thread.  Called by ap_main() once the
+   AP is online, with interrupts off. */
+void
+thread_start_ap (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (thread_current () == this_cpu ()->idle);
+
+  idle_loop ();
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -123,7 +195,7 @@ thread_start (void)
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to initialize cpus[0].idle. */
   sema_down (&idle_started);
 }
 
@@ -132,35 +204,103 @@ thread_start (void)
 void
 thread_tick (void)
 {
+  struct cpu *c = this_cpu ();
   struct thread *t = thread_current ();
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  if (t == c->idle)
+    c->idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    c->user_ticks++;
 #endif
   else
-    kernel_ticks++;
+    c->kernel_ticks++;
+  if (t != c->idle)
+    t->stats.run_ticks++;
 
   /* TASK 1: Handling advanced scheduler mode. */
   if (thread_mlfqs) {
     recalculate_mlfqs ();
   }
-  thread_ticks++;
+  c->thread_ticks++;
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++c->thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
-/* Prints thread statistics. */
+/* TASK 0: Accounts for TICKS timer ticks that passed without a
+   timer interrupt because the system was idle (see
+   timer_idle_enter()).  Every CPU was running its idle thread
+   throughout.  Interrupts must be off. */
+void
+thread_idle_ticks (unsigned ticks)
+{
+  unsigned i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < cpu_cnt; i++)
+    cpus[i].idle_ticks += ticks;
+}
+
+/* Prints thread statistics, totalled over all CPUs and, if there
+   is more than one, for each CPU. */
 void
 thread_print_stats (void)
 {
+  long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      idle_ticks += cpus[i].idle_ticks;
+      kernel_ticks += cpus[i].kernel_ticks;
+      user_ticks += cpus[i].user_ticks;
+    }
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+
+  if (cpu_cnt > 1)
+    for (i = 0; i < cpu_cnt; i++)
+      printf ("CPU %u: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
+              i, cpus[i].idle_ticks, cpus[i].kernel_ticks,
+              cpus[i].user_ticks);
+
+  lock_print_stats ();
+}
+
+/* Copies the statistics of up to MAX live threads into STATS,
+   filling in each entry's identity fields, and returns the
+   number of entries written.  Idle threads are skipped. */
+size_t
+thread_get_stats (struct thread_stats *stats, size_t max)
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+  size_t cnt = 0;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&all_list); e != list_end (&all_list) && cnt < max;
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      struct thread_stats *s = &stats[cnt];
+
+      if (t->status == THREAD_DYING
+          || (t->cpu != NULL && t == t->cpu->idle))
+        continue;
+
+      *s = t->stats;
+      s->tid = t->tid;
+      strlcpy (s->name, t->name, sizeof s->name);
+      s->priority = t->priority;
+      cnt++;
+    }
+  intr_set_level (old_level);
+
+  return cnt;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -259,6 +399,7 @@ thread_block (void)
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
+  thread_current ()->stats.voluntary_switches++;
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
 }
@@ -280,8 +421,11 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_insert_ordered (&ready_list, &t->elem, is_lower_priority, NULL);
+  if (thread_mlfqs)
+    thread_mlfqs_refresh (t);
   t->status = THREAD_READY;
+  ready_push (this_cpu (), t);
+  wake_idle_cpu ();
   intr_set_level (old_level);
 }
 
@@ -362,9 +506,10 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread)
-    list_insert_ordered (&ready_list, &cur->elem, is_lower_priority, NULL);
+  cur->stats.involuntary_switches++;
   cur->status = THREAD_READY;
+  if (cur != this_cpu ()->idle)
+    ready_push (this_cpu (), cur);
   schedule ();
   intr_set_level (old_level);
 }
@@ -386,8 +531,8 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* TASK 1: Sets the current thread's priority to NEW_PRIORITY.
-   This function assumes ready_list is a priority-wise sorted list. */
+/* TASK 1: Sets the current thread's priority to NEW_PRIORITY,
+   yielding if a ready thread now has a higher priority. */
 void
 thread_set_priority (int new_priority)
 {
@@ -429,14 +574,13 @@ thread_set_nice (int nice)
 
   priority_thread_mlfqs(thread_current (), NULL);
 
-  if (!list_empty(&ready_list)) {
-    struct thread *next = list_entry (list_max (&ready_list,
-                                       &is_lower_priority , NULL),
-                                       struct thread, elem);
+  enum intr_level old_level = intr_disable ();
+  struct thread *next = ready_peek_max (this_cpu ());
+  bool yield = next != NULL && thread_current ()->priority < next->priority;
+  intr_set_level (old_level);
 
-    if(thread_current ()->priority < next->priority) {
-      thread_yield ();
-    }
+  if (yield) {
+    thread_yield ();
   }
 }
 
@@ -472,37 +616,47 @@ thread_get_recent_cpu (void)
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it initializes the BSP's idle thread, "up"s the semaphore
+   passed to it to enable thread_start() to continue, and
+   immediately blocks.  After that, the idle thread never appears
+   in the ready list.  It is returned by next_thread_to_run() as
+   a special case when the ready list is empty.
+
+   TASK 1: Each AP has its own idle thread, set up by
+   thread_init_cpu(). */
 static void
 idle (void *idle_started_ UNUSED)
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  cpus[0].idle = thread_current ();
   sema_up (idle_started);
 
+  idle_loop ();
+}
+
+/* Body of the idle threads. */
+static void
+idle_loop (void)
+{
   for (;;)
     {
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
 
+      /* TASK 0: If no CPU has anything to run, stop the periodic
+         timer interrupt until the next timer event is due.  Only
+         the BSP receives it. */
+      if (this_cpu () == &cpus[0] && all_cpus_idle ())
+        timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
-         The `sti' instruction disables interrupts until the
-         completion of the next instruction, so these two
-         instructions are executed atomically.  This atomicity is
-         important; otherwise, an interrupt could be handled
-         between re-enabling interrupts and waiting for the next
-         one to occur, wasting as much as one clock tick worth of
-         time.
-
-         See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-      asm volatile ("sti; hlt" : : : "memory");
+         This must be atomic; otherwise, an interrupt could be
+         handled between re-enabling interrupts and waiting for
+         the next one to occur, wasting as much as one clock tick
+         worth of time. */
+      intr_wait ();
     }
 }
 
@@ -517,7 +671,8 @@ kernel_thread (thread_func *function, void *aux)
   thread_exit ();       /* If function() returns, kill the thread. */
 }
 
-/* Returns the running thread. */
+/* Returns the running thread.  Unlike thread_current(), this
+   works even in the middle of a thread switch. */
 struct thread *
 running_thread (void)
 {
@@ -558,6 +713,7 @@ init_thread (struct thread *t, const char *name, int priority)
 
   /* TASK 1: Handling the advanced scheduler priority system */
   if (thread_mlfqs) {
+      t->mlfqs_stamp = mlfqs_seconds;
       priority_thread_mlfqs (t, NULL);
   } else {
       t->base_priority = priority;
@@ -584,9 +740,9 @@ init_thread (struct thread *t, const char *name, int priority)
   t->nice = NICE_DEFAULT;
   t->cpu_num = CPU_NUM_DEFAULT;
 
+#ifdef VM
   t->mapid = 0;
-
-
+#endif
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -602,18 +758,197 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* TASK 1: Initializes CPU C's run queue as empty. */
+static void
+ready_init (struct cpu *c)
+{
+  int i;
+
+  for (i = 0; i < RQ_LEVELS; i++)
+    list_init (&c->ready_queues[i]);
+  c->ready_bitmap = 0;
+  c->ready_cnt = 0;
+}
+
+/* TASK 1: Returns the highest priority level with a non-empty
+   run queue on CPU C.  The run queue must not be empty. */
+static inline int
+ready_max_level (const struct cpu *c)
+{
+  uint32_t hi = c->ready_bitmap >> 32;
+  uint32_t lo = c->ready_bitmap;
+
+  ASSERT (c->ready_bitmap != 0);
+
+  /* `bsr' only scans 32 bits at a time, so look at the upper
+     half of the bitmap first.  See [IA32-v2a] "BSR". */
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  return 31 - __builtin_clz (lo);
+}
+
+/* TASK 1: Appends ready thread T to CPU C's run queue for its
+   priority level.  Interrupts must be off. */
+static void
+ready_push (struct cpu *c, struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  list_push_back (&c->ready_queues[t->priority], &t->elem);
+  c->ready_bitmap |= (uint64_t) 1 << t->priority;
+  c->ready_cnt++;
+  t->cpu = c;
+}
+
+/* TASK 1: Removes ready thread T from the run queue it is on.
+   Interrupts must be off. */
+static void
+ready_remove (struct thread *t)
+{
+  struct cpu *c = t->cpu;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  list_remove (&t->elem);
+  if (list_empty (&c->ready_queues[t->priority]))
+    c->ready_bitmap &= ~((uint64_t) 1 << t->priority);
+  c->ready_cnt--;
+}
+
+/* TASK 1: Returns the first thread at the highest non-empty
+   priority level of CPU C's run queue without removing it, or a
+   null pointer if the run queue is empty.  Interrupts must be
+   off. */
+static struct thread *
+ready_peek_max (struct cpu *c)
+{
+  if (c->ready_bitmap == 0)
+    return NULL;
+  return list_entry (list_front (&c->ready_queues[ready_max_level (c)]),
+                     struct thread, elem);
+}
+
+/* TASK 1: Work stealing.  Returns the CPU other than C whose run
+   queue holds the highest-priority ready thread, if that
+   priority is above PRIORITY, or a null pointer if there is
+   none.  Among CPUs with equally high-priority threads, prefers
+   the one with the most ready threads.  Interrupts must be
+   off. */
+static struct cpu *
+ready_steal_victim (struct cpu *c, int priority)
+{
+  struct cpu *victim = NULL;
+  unsigned i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *v = &cpus[i];
+      int level;
+
+      if (v == c || v->ready_bitmap == 0)
+        continue;
+      level = ready_max_level (v);
+      if (level > priority
+          || (victim != NULL && level == priority
+              && v->ready_cnt > victim->ready_cnt))
+        {
+          victim = v;
+          priority = level;
+        }
+    }
+  return victim;
+}
+
+/* TASK 1: Sets T's priority to PRIORITY.  If T is in a run queue
+   it is moved to the back of its new level on the same CPU, so a
+   thread whose priority did not change keeps its place.
+   Interrupts must be off. */
+static void
+thread_requeue (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->priority == priority)
+    return;
+
+  if (t->status == THREAD_READY)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t->cpu, t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* TASK 1: If another CPU is idle, asks it to look for a thread to
+   run, so that a thread just made ready on this CPU need not wait
+   for the next timer tick to be stolen.  Interrupts must be
+   off. */
+static void
+wake_idle_cpu (void)
+{
+  struct cpu *c;
+  unsigned i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!smp_active)
+    return;
+
+  c = this_cpu ();
+  for (i = 0; i < cpu_cnt; i++)
+    if (&cpus[i] != c && cpus[i].cur == cpus[i].idle)
+      {
+        smp_send_resched (&cpus[i]);
+        return;
+      }
+}
+
+/* TASK 0: Returns true if every CPU is running its idle thread
+   and has nothing in its run queue.  Interrupts must be off. */
+static bool
+all_cpus_idle (void)
+{
+  unsigned i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].cur != cpus[i].idle || cpus[i].ready_cnt != 0)
+      return false;
+  return true;
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   the idle thread.
+
+   TASK 1: A higher-priority thread on another CPU's run queue is
+   stolen in preference to anything on our own, as is any thread
+   at all when our own run queue is empty. */
 static struct thread *
 next_thread_to_run (void)
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  struct cpu *c = this_cpu ();
+  struct thread *t = ready_peek_max (c);
+  struct cpu *victim;
+
+  victim = ready_steal_victim (c, t != NULL ? t->priority : PRI_MIN - 1);
+  if (victim != NULL)
+    t = ready_peek_max (victim);
+  if (t == NULL)
+    return c->idle;
+
+  ready_remove (t);
+  return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -643,7 +978,7 @@ thread_schedule_tail (struct thread *prev)
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  this_cpu ()->thread_ticks = 0;
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -672,6 +1007,7 @@ thread_schedule_tail (struct thread *prev)
 static void
 schedule (void)
 {
+  struct cpu *c = this_cpu ();
   struct thread *cur = running_thread ();
   struct thread *next = next_thread_to_run ();
   struct thread *prev = NULL;
@@ -680,6 +1016,10 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  /* TASK 1: NEXT now runs on this CPU. */
+  next->cpu = c;
+  c->cur = next;
+
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
@@ -699,19 +1039,13 @@ allocate_tid (void)
   return tid;
 }
 
-/* Returns the thread associated with a sema_elem */
-struct thread *thread_for_sema_list_elem (const struct list_elem *lelem) {
-  struct semaphore sema = list_entry (lelem, struct semaphore_elem, elem)->semaphore;
-  return list_entry (list_front (&sema.waiters), struct thread, elem);
-}
-
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
 
 
-/* TASK 0: Function used as criterium to sort ready_list priority-wise */
+/* TASK 0: Function used as criterium to sort thread lists priority-wise */
 bool is_lower_priority (const struct list_elem *a,
                           const struct list_elem *b, void *aux UNUSED) {
   ASSERT(a != NULL);
@@ -728,15 +1062,15 @@ bool is_lower_priority (const struct list_elem *a,
            with the highest priority, if not it changes running thread. */
 void check_max_priority(void) {
 
-  if(list_empty(&ready_list)) {
+  struct cpu *c = this_cpu ();
+  struct thread* t = ready_peek_max (c);
+  if(t == NULL) {
     return;
   }
 
-  struct thread* t = list_entry(list_front(&ready_list), struct thread, elem);
-
   if(intr_context()) {
-    thread_ticks++;
-    if(thread_current ()->priority < t->priority || (thread_ticks >= TIME_SLICE
+    c->thread_ticks++;
+    if(thread_current ()->priority < t->priority || (c->thread_ticks >= TIME_SLICE
                         && thread_current()-> priority == t->priority)) {
       intr_yield_on_return();
     }
@@ -760,28 +1094,58 @@ void donate_priority(void) {
     if(l->holder == NULL) return;
     if(l->holder->priority >= t->priority) return;
 
-    l->holder->priority = t->priority;
+    thread_requeue (l->holder, t->priority);
     t = l->holder;
     l = t->lock_waiting;
   }
 }
 
 
+/* TASK 1: Raises T's priority to PRIORITY, if lower, on behalf of
+           a thread waiting for an rwlock that T holds, and passes
+           the donation on along the locks T is waiting for.
+           Interrupts must be off. */
+void donate_priority_to (struct thread *t, int priority) {
+  int depth = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (t != NULL && depth < DEPTH_LIMIT && t->priority < priority) {
+    depth++;
+    thread_requeue (t, priority);
+    t = t->lock_waiting != NULL ? t->lock_waiting->holder : NULL;
+  }
+}
+
+
 /* TASK 1: Updates priority member in thread struct with the effective
-           priority (i.e. taking into account donations) */
+           priority (i.e. taking into account donations, including
+           those from threads waiting for rwlocks it holds) */
 void update_priority(void) {
   struct thread *t = thread_current();
+  enum intr_level old_level = intr_disable ();
+  int i;
+
   t->priority = t->base_priority;
-  if(list_empty(&t->threads_donated)) {
-    return;
+  if(!list_empty(&t->threads_donated)) {
+    struct thread *t2 = list_entry(list_front(&t->threads_donated),
+                                 struct thread, donation_thread);
+
+    if(t2->priority > t->priority) {
+       t->priority = t2->priority;
+     }
   }
-  struct thread *t2 = list_entry(list_front(&t->threads_donated),
-                               struct thread, donation_thread);
 
-  if(t2->priority > t->priority) {
-     t->priority = t2->priority;
-   }
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++) {
+    struct rwlock *rw = t->rwlock_holds[i].rwlock;
+    if (rw != NULL) {
+      int p = rwlock_max_waiter_priority (rw);
+      if (p > t->priority)
+        t->priority = p;
+    }
   }
+  intr_set_level (old_level);
+}
 
 
 /* TASK 1: Removes from list threads_donated threads waiting for lock l */
@@ -800,26 +1164,115 @@ void remove_with_lock(struct lock* l) {
 
 
 /* TASK 1: Function for advanced scheduling.
-           Recalculates CPU time for the current thread (once per second). */
+           Called on every timer tick.  Charges the tick to the running
+           thread and recomputes its priority every TIME_SLICE ticks.
+           Once per second, updates load_avg and decays recent_cpu for
+           the running and ready threads only; blocked threads catch up
+           in thread_mlfqs_refresh() when they are unblocked, so the
+           cost of a tick does not depend on how many threads sleep.
+           The once-per-second work is done by the BSP for all CPUs. */
 void recalculate_mlfqs(void)
 {
   ASSERT (thread_mlfqs);
 
+  struct cpu *c = this_cpu ();
   struct thread *t = thread_current ();
+  int64_t now = timer_ticks ();
+
+  if (now % TIMER_FREQ == 0 && c == &cpus[0]) {
+    unsigned i;
 
-  if (timer_ticks () % TIMER_FREQ == 0) {
     load_avg_thread_mlfqs ();
-    thread_foreach (&cpu_thread_mlfqs, NULL);
+    mlfqs_seconds++;
+    for (i = 0; i < cpu_cnt; i++) {
+      if (cpus[i].cur != cpus[i].idle)
+        thread_mlfqs_refresh (cpus[i].cur);
+      mlfqs_refresh_ready (&cpus[i]);
+    }
   }
-  if (thread_current () != idle_thread) {
+  if (t != c->idle) {
     t->cpu_num = add_x_n(t->cpu_num, 1);
   }
 
-  if (timer_ticks () % TIME_SLICE == 0) {
-    thread_foreach (&priority_thread_mlfqs, NULL);
+  if (now % TIME_SLICE == 0 && t != c->idle) {
+    priority_thread_mlfqs (t, NULL);
   }
 }
 
+/* TASK 1: Returns fixed-point X raised to the power N, by repeated
+           squaring. */
+static int
+pow_x_n (int x, unsigned n)
+{
+  int result = convert_to_fixed_point (1);
+  while (n > 0) {
+    if (n & 1)
+      result = mul_x_y (result, x);
+    x = mul_x_y (x, x);
+    n >>= 1;
+  }
+  return result;
+}
+
+/* TASK 1: Brings T's recent_cpu up to date with the seconds that have
+           passed since its mlfqs_stamp, then recomputes its priority,
+           moving T between run queue levels only if it changed.
+
+           With c = (2*load_avg)/(2*load_avg + 1), a thread that spent
+           the last K seconds off the CPU has
+
+             recent_cpu' = c^K * recent_cpu + nice * (1 + c + ... + c^(K-1))
+                         = c^K * recent_cpu + nice * (1 - c^K) * (2*load_avg + 1)
+
+           using the current load_avg for every missed second.  For a
+           single second this is exactly the per-second update. */
+void thread_mlfqs_refresh (struct thread *t)
+{
+  ASSERT (thread_mlfqs);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  unsigned missed = mlfqs_seconds - t->mlfqs_stamp;
+  if (missed == 0)
+    return;
+  t->mlfqs_stamp = mlfqs_seconds;
+
+  if (missed == 1) {
+    cpu_thread_mlfqs (t, NULL);
+  } else {
+    int load_avg_curr = mul_x_n(load_avg, 2);
+    int denom = add_x_n(load_avg_curr, 1);
+    int coeff_k = pow_x_n (div_x_y(load_avg_curr, denom), missed);
+    int series = mul_x_y(sub_x_y(convert_to_fixed_point(1), coeff_k), denom);
+    t->cpu_num = add_x_y(mul_x_y(coeff_k, t->cpu_num),
+                         mul_x_n(series, t->nice));
+  }
+  priority_thread_mlfqs (t, NULL);
+}
+
+/* TASK 1: Brings every thread in CPU C's run queue up to date
+           after a load_avg update.  A thread that moves to a lower
+           level is visited again there, which is harmless because it
+           is already up to date. */
+static void
+mlfqs_refresh_ready (struct cpu *c)
+{
+  int level;
+
+  for (level = PRI_MAX; level >= PRI_MIN; level--)
+    {
+      struct list *q = &c->ready_queues[level];
+      struct list_elem *e, *next;
+
+      if ((c->ready_bitmap & ((uint64_t) 1 << level)) == 0)
+        continue;
+      for (e = list_begin (q); e != list_end (q); e = next)
+        {
+          next = list_next (e);
+          thread_mlfqs_refresh (list_entry (e, struct thread, elem));
+        }
+    }
+}
+
 /* TASK 1: Function for advanced scheduling.
            Sets thread's priority using the advanced scheduler system. */
 void priority_thread_mlfqs(struct thread* t, void *aux UNUSED)
@@ -839,7 +1292,9 @@ void priority_thread_mlfqs(struct thread* t, void *aux UNUSED)
   if (priority_num < PRI_MIN)
     priority_num = PRI_MIN;
 
-  t->priority = priority_num;
+  enum intr_level old_level = intr_disable ();
+  thread_requeue (t, priority_num);
+  intr_set_level (old_level);
 }
 
 
@@ -847,8 +1302,6 @@ void priority_thread_mlfqs(struct thread* t, void *aux UNUSED)
 void cpu_thread_mlfqs (struct thread *t, void *aux UNUSED)
 {
   ASSERT (thread_mlfqs);
-  /* For cpu to be calculated, we need the following condition: */
-  ASSERT(timer_ticks () % TIME_SLICE == 0);
 
   int cpu_recent = t->cpu_num;
 
@@ -885,10 +1338,13 @@ void load_avg_thread_mlfqs (void)
   /*  (59/60)*load_avg  */
   int load_avg_mul = mul_x_y(load_avg_curr, fp_59_div_60);
 
-  /* Size of ready threads */
-  int ready_threads = list_size (&ready_list);
-  if (thread_current() != idle_thread) {
-    ready_threads++;
+  /* Size of ready threads, plus the running threads of all CPUs */
+  int ready_threads = 0;
+  unsigned i;
+  for (i = 0; i < cpu_cnt; i++) {
+    ready_threads += cpus[i].ready_cnt;
+    if (cpus[i].cur != cpus[i].idle)
+      ready_threads++;
   }
 
   /*  (1/60) * ready_threads  */
@@ -910,7 +1366,7 @@ int
 thread_add_new_file (struct file *file)
 {
   struct thread *cur = thread_current ();
-  struct file_handle *handle = malloc (sizeof (struct file_handle));
+  struct file_handle *handle = kmem_cache_alloc (file_handle_cache);
 
   handle->file = file;
   handle->fd = cur->next_fd++;
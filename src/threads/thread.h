@@ -4,9 +4,12 @@
 #include <debug.h>
 #include <list.h>
 #include <hash.h>
+#include <stats.h>
 #include <stdint.h>
 #include "threads/synch.h"
 
+struct cpu;
+
 /* States in a thread's life cycle. */
 enum thread_status
   {
@@ -110,6 +113,10 @@ struct thread
     int priority;                       /* Priority. */
     int eff_priority;                   /* TASK 1 : Effective priority */
     struct list_elem allelem;           /* List element for all threads list. */
+    struct cpu *cpu;                    /* TASK 1: CPU running this thread,
+                                           or whose run queue holds it. */
+    struct thread_stats stats;          /* Counters reported by the stats
+                                           system call. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
@@ -154,17 +161,21 @@ struct thread
     struct list_elem donation_thread; /* thread element that is donated */
     struct lock* lock_waiting;        /* lock that thread is waiting for */
     struct list threads_donated;      /* list of threads */
+    struct rwlock_hold rwlock_holds[RWLOCK_HOLD_MAX];
+                                      /* rwlocks held, for donation */
 
     /* TASK 1: Advanced scheduling */
     int cpu_num;                        /* Time spent in the CPU recently */
     int nice;                           /* Index of greediness for CPU */
+    unsigned mlfqs_stamp;               /* Second at which cpu_num was last
+                                           brought up to date */
 
 #ifdef VM
     /* TASK 3: VM */
     mapid_t mapid;
-    struct lock sup_page_table_lock;
-    struct hash sup_page_table;
-    struct list mmapped_files;
+    struct rwlock sup_page_table_lock;
+    struct list vm_areas;               /* Supplementary page table: areas
+                                           of the address space, by start */
 #endif
 
 	/* Owned by thread.c. */
@@ -199,9 +210,14 @@ extern bool thread_mlfqs;
 
 void thread_init (void);
 void thread_start (void);
+bool thread_init_cpu (struct cpu *);
+void thread_free_cpu (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
 void thread_print_stats (void);
+size_t thread_get_stats (struct thread_stats *, size_t max);
+void thread_idle_ticks (unsigned ticks);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -209,6 +225,7 @@ tid_t thread_create (const char *name, int priority, thread_func *, void *);
 void thread_block (void);
 void thread_unblock (struct thread *);
 
+struct thread *running_thread (void);
 struct thread *thread_current (void);
 tid_t thread_tid (void);
 const char *thread_name (void);
@@ -228,12 +245,11 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-struct thread *thread_for_sema_list_elem (const struct list_elem *);
-
 /* TASK 1 : Priority Checking */
 bool is_lower_priority (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 void update_priority(void);
 void donate_priority(void);
+void donate_priority_to (struct thread *, int priority);
 void check_max_priority(void);
 void remove_with_lock(struct lock* l);
 
@@ -245,6 +261,7 @@ void recalculate_mlfqs(void);
 void priority_thread_mlfqs(struct thread* t, void *aux UNUSED);
 void cpu_thread_mlfqs (struct thread *t, void *aux UNUSED);
 void load_avg_thread_mlfqs (void);
+void thread_mlfqs_refresh (struct thread *t);
 
 /* TASK 2 */
 struct thread *get_tid_thread(tid_t tid);
@@ -171,12 +171,24 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  thread_current ()->stats.page_faults++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  /* TASK 3 : Writing to the zero page, or to a page shared
+     copy-on-write since a fork(), by the process or by the kernel on
+     its behalf */
+  if (!not_present && write && fault_addr != NULL
+      && is_user_vaddr (fault_addr)) {
+    struct page_table_entry *pte
+      = get_page_table_entry (thread_current (), pg_round_down (fault_addr));
+    if (pte != NULL && pte->writable && page_write_fault (pte))
+      return;
+  }
+
   /* TASK 2 : Try to access a kernel address in user mode. */
 	if (user && (!is_user_vaddr(fault_addr) || !fault_addr)) {
 		exit(-1);
@@ -194,14 +206,14 @@ page_fault (struct intr_frame *f)
     void* vaddr = pg_round_down(fault_addr);
 
     /* Get page at address */
-    struct page_table_entry* pte = get_page_table_entry(&curr->sup_page_table, vaddr);
+    struct page_table_entry* pte = get_page_table_entry(curr, vaddr);
 
     /* If page is not null, then load page in physical memory */
     if(pte != NULL) {
-      load = load_page(pte);
+      load = load_page(pte, write);
     /* If page not found, then check if address is valid in stack */
     } else if (is_stack_access(fault_addr, f->esp)) {
-        load = grow_stack(fault_addr);
+        load = grow_stack(fault_addr, write);
     }
     return;
   }
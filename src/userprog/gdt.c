@@ -43,7 +43,7 @@ gdt_init (void)
   gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc (0);
   gdt[SEL_UCSEG / sizeof *gdt] = make_code_desc (3);
   gdt[SEL_UDSEG / sizeof *gdt] = make_data_desc (3);
-  gdt[SEL_TSS / sizeof *gdt] = make_tss_desc (tss_get ());
+  gdt[SEL_TSS / sizeof *gdt] = make_tss_desc (tss_get (0));
 
   /* Load GDTR, TR.  See [IA32-v3a] 2.4.1 "Global Descriptor
      Table Register (GDTR)", 2.4.4 "Task Register (TR)", and
@@ -52,6 +52,21 @@ gdt_init (void)
   asm volatile ("lgdt %0" : : "m" (gdtr_operand));
   asm volatile ("ltr %w0" : : "q" (SEL_TSS));
 }
+
+/* TASK 1: Loads the GDT on the AP with index ID, adding a TSS
+   descriptor for it.  Each CPU needs its own, because `ltr'
+   marks the descriptor busy. */
+void
+gdt_init_ap (unsigned id)
+{
+  uint64_t gdtr_operand;
+
+  gdt[SEL_TSS_CPU (id) / sizeof *gdt] = make_tss_desc (tss_get (id));
+
+  gdtr_operand = make_gdtr_operand (sizeof gdt - 1, gdt);
+  asm volatile ("lgdt %0" : : "m" (gdtr_operand));
+  asm volatile ("ltr %w0" : : "q" (SEL_TSS_CPU (id)));
+}
 
 /* System segment or code/data segment? */
 enum seg_class
@@ -1,13 +1,37 @@
 #include "userprog/pagedir.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+
+/* TASK 3 : Let kernel threads run on the page directory already
+   loaded?  See pagedir_activate_kernel().  Cleared by the
+   "-nolazytlb" kernel option. */
+bool pagedir_lazy = true;
+
+/* TASK 3 : Statistics, updated with interrupts off. */
+static long long load_cnt;      /* # of page directories loaded. */
+static long long kept_cnt;      /* # of switches to a kernel thread
+                                   that kept a process's loaded. */
+
+/* TASK 3 : TLB shootdown in progress, see shootdown().  Set with
+   interrupts off. */
+static bool shootdown_busy;             /* A shootdown is in progress. */
+static uint32_t *shootdown_pd;          /* Page directory changed. */
+static const void *shootdown_vpage;     /* Page changed. */
+static volatile unsigned shootdown_cnt; /* # of CPUs yet to flush. */
 
 static uint32_t *active_pd (void);
-static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
+static void invalidate_page_here (uint32_t *, const void *);
+static void shootdown (uint32_t *, const void *);
+static void unload_pd (struct cpu *);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -23,7 +47,11 @@ pagedir_create (void)
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.
+
+   TASK 3 : PD may still be loaded on other CPUs, by kernel threads
+   that borrowed it.  They are made to load the kernel's page
+   directory instead before any of PD's page tables is freed. */
 void
 pagedir_destroy (uint32_t *pd)
 {
@@ -33,6 +61,8 @@ pagedir_destroy (uint32_t *pd)
     return;
 
   ASSERT (pd != init_page_dir);
+  shootdown (pd, NULL);
+
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
     if (*pde & PTE_P)
       {
@@ -80,6 +110,11 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
         return NULL;
     }
 
+  /* A 4 MB page of the kernel mapping has no page table, and so
+     no page table entry. */
+  if (*pde & PTE_PS)
+    return NULL;
+
   /* Return the page table entry. */
   pt = pde_get_pt (*pde);
   return &pt[pt_no (vaddr)];
@@ -151,8 +186,12 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   pte = lookup_page (pd, upage, false);
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
-      *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      /* TASK 3 : Another CPU running PD's process may be setting
+         the accessed or dirty bit meanwhile, so don't overwrite
+         the entry with a copy read before it did. */
+      asm volatile ("lock andl %1, %0"
+                    : "+m" (*pte) : "ir" (~(uint32_t) PTE_P) : "memory");
+      invalidate_page (pd, upage);
     }
 }
 
@@ -180,11 +219,36 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
 
+/* Returns true if the PTE for virtual page VPAGE in PD is
+   writable.  Returns false if PD contains no PTE for VPAGE. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & PTE_W) != 0;
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_page (pd, vpage);
+    }
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD has been
    accessed recently, that is, between the time the PTE was
    installed and the last time it was cleared.  Returns false if
@@ -208,8 +272,12 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
         *pte |= PTE_A;
       else
         {
+          /* TASK 3 : Other CPUs may keep using their cached entry
+             without setting the bit again.  That only makes the
+             page look idle when it is not, which is not worth an
+             IPI for each page the clock passes. */
           *pte &= ~(uint32_t) PTE_A;
-          invalidate_pagedir (pd);
+          invalidate_page_here (pd, vpage);
         }
     }
 }
@@ -219,15 +287,73 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
 void
 pagedir_activate (uint32_t *pd)
 {
+  enum intr_level old_level;
+  struct cpu *c;
+
   if (pd == NULL)
     pd = init_page_dir;
 
+  old_level = intr_disable ();
+  c = this_cpu ();
+
+  /* TASK 3 : Switching between threads of the same address space
+     need not flush the TLB.  Changes to PD made on other CPUs
+     meanwhile were shot down here too. */
+  if (active_pd () == pd)
+    {
+      intr_set_level (old_level);
+      return;
+    }
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base
      Address of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+  load_cnt++;
+
+  c->pagedir = pd;
+  intr_set_level (old_level);
+}
+
+/* TASK 3 : Lazy TLB.  Called on a switch to a kernel thread, which
+   has no page directory of its own.
+
+   Every page directory maps the kernel, and a kernel thread never
+   touches user memory, so the thread runs on whichever page
+   directory is loaded, usually that of the process that ran
+   before it.  That process is often the next to run again, after
+   waiting a moment on a kernel thread or on a device while the
+   idle thread ran, and then finds its TLB entries still there
+   rather than having to refill them.  The borrowed page directory
+   stays loaded until another is needed; until then this CPU counts
+   as having it loaded, so invalidate_page() shoots down its TLB
+   entries like those of a CPU running the process, and
+   pagedir_destroy() allows for it. */
+void
+pagedir_activate_kernel (void)
+{
+  enum intr_level old_level;
+
+  if (!pagedir_lazy)
+    {
+      pagedir_activate (NULL);
+      return;
+    }
+
+  old_level = intr_disable ();
+  if (active_pd () != init_page_dir)
+    kept_cnt++;
+  intr_set_level (old_level);
+}
+
+/* TASK 3 : Prints page directory statistics. */
+void
+pagedir_print_stats (void)
+{
+  printf ("Paging: %lld page directory loads, %lld kept for kernel threads\n",
+          load_cnt, kept_cnt);
 }
 
 /* Returns the currently active page directory. */
@@ -245,19 +371,125 @@ active_pd (void)
 
 /* Seom page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
-   table.  When this happens, we have to "invalidate" the TLB by
-   re-activating it.
+   table.  When this happens, we have to "invalidate" the TLB
+   entry for the page that changed.
 
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   This function invalidates VPAGE's entry if PD is the active
+   page directory.  (If PD is not active then its entries are not
+   in the TLB, so there is no need to invalidate anything.)
+
+   TASK 3 : Other CPUs may have PD loaded too, either running a
+   thread of PD's process or lending it to a kernel thread, see
+   pagedir_activate_kernel().  They are sent a shootdown IPI, and
+   by the time this returns none of them can use the old entry
+   any more. */
 static void
-invalidate_pagedir (uint32_t *pd)
+invalidate_page (uint32_t *pd, const void *vpage)
 {
-  if (active_pd () == pd)
+  invalidate_page_here (pd, vpage);
+  if (cpu_cnt > 1 && !is_kernel_vaddr (vpage))
+    shootdown (pd, vpage);
+}
+
+/* TASK 3 : Invalidates VPAGE's entry in the running CPU's TLB if
+   PD is the active page directory.
+
+   Kernel mappings are shared by every page directory, and global
+   ones stay in the TLB however often CR3 is loaded, so the entry
+   for a kernel VPAGE is always invalidated.  INVLPG drops only
+   that entry, where reloading CR3 would drop every other one too.
+   See [IA32-v3a] 3.12 "Translation Lookaside Buffers (TLBs)". */
+static void
+invalidate_page_here (uint32_t *pd, const void *vpage)
+{
+  if (is_kernel_vaddr (vpage) || active_pd () == pd)
+    asm volatile ("invlpg (%0)" : : "r" (vpage) : "memory");
+}
+
+/* TASK 3 : TLB shootdown.  Makes every other CPU that has PD
+   loaded drop its TLB entry for VPAGE, or if VPAGE is null, load
+   the kernel's page directory instead of PD, which is about to be
+   destroyed, and waits until they all have.  In the latter case
+   the running CPU unloads PD too, if it has it loaded.
+
+   Only one shootdown is in progress at a time.  The IPIs are sent
+   with interrupts off, so that no CPU can load or drop PD
+   meanwhile, but the wait has to be with interrupts on: a CPU
+   takes the giant lock to handle the IPI, and we would otherwise
+   be holding it. */
+static void
+shootdown (uint32_t *pd, const void *vpage)
+{
+  enum intr_level old_level;
+  struct cpu *self;
+  unsigned i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  for (;;)
+    {
+      old_level = intr_disable ();
+      if (!shootdown_busy)
+        break;
+      intr_set_level (old_level);
+      thread_yield ();
+    }
+
+  self = this_cpu ();
+  shootdown_pd = pd;
+  shootdown_vpage = vpage;
+  shootdown_cnt = 0;
+  for (i = 0; i < cpu_cnt; i++)
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      if (cpus[i].pagedir != pd)
+        continue;
+      if (&cpus[i] != self)
+        {
+          shootdown_cnt++;
+          smp_send_tlb (&cpus[i]);
+        }
+      else if (vpage == NULL)
+        unload_pd (self);
+    }
+  shootdown_busy = shootdown_cnt > 0;
+  intr_set_level (old_level);
+
+  if (!shootdown_busy)
+    return;
+  while (shootdown_cnt > 0)
+    asm volatile ("pause" : : : "memory");
+
+  old_level = intr_disable ();
+  shootdown_busy = false;
+  intr_set_level (old_level);
+}
+
+/* TASK 3 : Loads the kernel's page directory on the running CPU,
+   C, in place of one about to be destroyed.  Only a kernel thread,
+   which borrowed it, can be running on that one, so any other page
+   directory will do.  Interrupts must be off. */
+static void
+unload_pd (struct cpu *c)
+{
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+  c->pagedir = init_page_dir;
+  load_cnt++;
+}
+
+/* TASK 3 : Handles a TLB shootdown IPI from shootdown(). */
+void
+pagedir_shootdown_ipi (void)
+{
+  struct cpu *c = this_cpu ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (c->pagedir == shootdown_pd)
+    {
+      if (shootdown_vpage != NULL)
+        asm volatile ("invlpg (%0)" : : "r" (shootdown_vpage) : "memory");
+      else
+        unload_pd (c);
     }
+  shootdown_cnt--;
 }
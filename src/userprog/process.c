@@ -16,14 +16,18 @@
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/prefetch.h"
 #include "vm/swap.h"
 
 #define MAX_ARGS 50
 
 static thread_func start_process NO_RETURN;
+static thread_func fork_child NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
@@ -91,10 +95,8 @@ start_process (void *file_name_)
   struct thread* cur = thread_current ();
 
   /* TASK 3 : Initialise swap elements */
-  page_table_init(&cur->sup_page_table);
-  list_init(&cur->mmapped_files);
+  page_table_init(cur);
   thread_current()->mapid = 0;
-  swap_init();
 
 
   /* Initialize interrupt frame and load executable. */
@@ -183,6 +185,122 @@ and jump to it. */
 
 }
 
+/* TASK 3 : What process_fork() hands over to fork_child() */
+struct fork_args
+  {
+    struct intr_frame if_;      /* Parent's registers at the system call */
+    struct thread *parent;      /* Forking process */
+    struct semaphore linked;    /* Upped once the child is the parent's */
+    struct semaphore done;      /* Upped once the child is done with this */
+    bool success;               /* Did the child copy the parent? */
+  };
+
+/* TASK 3 : Creates a child process that is a copy of the current
+   one, which made a system call with registers F, and returns its
+   pid.  The child returns from the same system call with 0.
+   Returns TID_ERROR if the child cannot be created.
+
+   The child starts with the same open files, at the same
+   positions, and shares the parent's pages copy-on-write, so
+   forking costs a few words per page rather than a page copy. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  struct fork_args args;
+  tid_t tid;
+
+  args.if_ = *f;
+  args.parent = thread_current ();
+  args.success = false;
+  sema_init (&args.linked, 0);
+  sema_init (&args.done, 0);
+
+  tid = thread_create (args.parent->name, PRI_DEFAULT, fork_child, &args);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+
+  /* The child must not exit before thread_create() has made it our
+     child, and must not be left using ARGS once we return */
+  sema_up (&args.linked);
+  sema_down (&args.done);
+  return args.success ? tid : TID_ERROR;
+}
+
+/* TASK 3 : Gives the current process, a child being forked from
+   PARENT, copies of PARENT's executable, open files and address
+   space.  Returns false if out of memory */
+static bool
+fork_copy (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir == NULL)
+    return false;
+  process_activate ();
+
+  /* The executable is kept open, and read-only, by each process
+     running it */
+  cur->file = file_reopen (parent->file);
+  if (cur->file == NULL)
+    return false;
+  file_deny_write (cur->file);
+
+  /* Same file descriptors, in the same order, each with its own
+     position */
+  for (e = list_rbegin (&parent->file_list);
+       e != list_rend (&parent->file_list); e = list_prev (e)) {
+    struct file_handle *ph = list_entry (e, struct file_handle, elem);
+    struct file_handle *handle = kmem_cache_alloc (file_handle_cache);
+    if (handle == NULL)
+      return false;
+    handle->file = file_reopen (ph->file);
+    if (handle->file == NULL) {
+      kmem_cache_free (file_handle_cache, handle);
+      return false;
+    }
+    file_seek (handle->file, file_tell (ph->file));
+    handle->fd = ph->fd;
+    list_push_front (&cur->file_list, &handle->elem);
+  }
+  cur->next_fd = parent->next_fd;
+
+  return page_table_fork (parent);
+}
+
+/* TASK 3 : A thread function that makes a forked child a copy of
+   its parent and returns to user mode from the parent's fork()
+   system call */
+static void
+fork_child (void *args_)
+{
+  struct fork_args *args = args_;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_;
+  bool success;
+
+  page_table_init (cur);
+  cur->mapid = 0;
+
+  sema_down (&args->linked);
+  if_ = args->if_;
+  if_.eax = 0;
+  success = args->success = fork_copy (args->parent);
+  sema_up (&args->done);
+
+  if (!success) {
+    if (cur->file != NULL) {
+      file_allow_write (cur->file);
+      file_close (cur->file);
+    }
+    thread_exit ();
+  }
+
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -251,8 +369,12 @@ process_exit (void)
   /* TASK 2: unblock parent thread */
   sema_up (&cur->alive_sema);
 
-  /* TASK 3: remove the supplementary page table */
-  page_table_destroy(&cur->sup_page_table);
+  /* TASK 3: release this process's frames, then remove the
+     supplementary page table, once the prefetch worker is done
+     with it */
+  prefetch_cancel(cur);
+  frame_free_thread(cur);
+  page_table_destroy(cur);
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -282,8 +404,12 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  TASK 3 : A kernel thread has
+     none and keeps the ones loaded, see pagedir_activate_kernel(). */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
+  else
+    pagedir_activate_kernel ();
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -472,6 +598,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
    /* TASK 2: prevent writes to an executable read-only file */
   t->file = file;
   file_deny_write (file);
+
+  /* TASK 3: start reading the pages the process will want first */
+  prefetch_exec ((void *) ehdr.e_entry);
   goto success_done;
 
  done:
@@ -552,30 +681,15 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  //file_seek (file, ofs);
+  /* Insert the segment in page table, as one area.  Pages with
+     nothing to read are pages of zeros, that map the zero page
+     until written */
+  bool file_inserted = insert_file (file, ofs, upage, read_bytes,
+                                    zero_bytes, writable, FILE_BIT);
 
-  while (read_bytes > 0 || zero_bytes > 0)
-    {
-      /* Calculate how to fill this page.
-         We will read PAGE_READ_BYTES bytes from FILE
-         and zero the final PAGE_ZERO_BYTES bytes. */
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-      /* Insert file in page table */
-      bool file_inserted = insert_file (file, ofs, upage, page_read_bytes,
-                                 page_zero_bytes, writable, FILE_BIT);
-
-      if (!file_inserted) {
-        printf("Failed file insert in load_segemnt_vm\n");
-        return false;
-      }
-
-      /* Advance. */
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      ofs += PGSIZE;
-      upage += PGSIZE;
+  if (!file_inserted) {
+    printf("Failed file insert in load_segemnt_vm\n");
+    return false;
   }
 
   return true;
@@ -583,12 +697,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory.  It is written straight away, with the
+   arguments, so it gets its frame now. */
 static bool
 setup_stack (void **esp)
 {
    bool success = false;
-   success = grow_stack(((uint8_t *) PHYS_BASE) - PGSIZE);
+   success = grow_stack(((uint8_t *) PHYS_BASE) - PGSIZE, true);
    if(success){
        *esp = PHYS_BASE;
    }
@@ -5,6 +5,8 @@
 #include "threads/synch.h"
 #include "vm/page.h"
 
+struct intr_frame;
+
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t tid);
 void process_exit (void);
@@ -12,5 +14,6 @@ void process_activate (void);
 
 /* TASK 3 */
 bool install_page ( void *upage, void *kpage, bool writable);
+tid_t process_fork (struct intr_frame *f);
 
 #endif /* userprog/process.h */
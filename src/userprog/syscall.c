@@ -1,16 +1,21 @@
 #include "userprog/syscall.h"
 #include "userprog/pagedir.h"
+#include <round.h>
 #include <stdio.h>
 #include <syscall-nr.h>
 #include "lib/string.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "devices/shutdown.h"
 #include "devices/input.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/prefetch.h"
 
 #define MAX_NUM_SYSCALLS 322
 #define STDOUT_FILENO 1
@@ -18,8 +23,11 @@
 #define MAX_BUFFER_LENGTH 512
 #define MAX_SYSCALL_ARGS 3
 #define FILE_OPEN_FAILURE -1
+#define MAX_STATS_THREADS 64
 
 static void check_memory_access(const void *);
+static void check_buffer_access (const void *, size_t, bool);
+static bool copy_to_user (void *, const void *, size_t);
 static void acquire_filelock (void);
 static void release_filelock (void);
 static void syscall_handler (struct intr_frame *);
@@ -39,6 +47,9 @@ static syscall_dispatcher syscall_map[MAX_NUM_SYSCALLS];
 static struct lock filelock;
 static struct lock mapid_lock;
 
+/* TASK 3 : Cache that file handles come from */
+struct kmem_cache *file_handle_cache;
+
 /* TASK 2: Checks that the pointer is legal:
      - checks that it is not a null pointer;
      - checks that it is pointing to a user virtual address and not kernel;
@@ -52,6 +63,58 @@ check_memory_access(const void *ptr) {
   }
 }
 
+/* TASK 3 : Checks that every page of the SIZE bytes at BUFFER is a
+   page of the process, writable if WRITE, whether or not it is
+   resident, and exits if not. */
+static void
+check_buffer_access (const void *buffer, size_t size, bool write)
+{
+  struct thread *cur = thread_current ();
+  const uint8_t *page;
+
+  if (size == 0)
+    return;
+  if (buffer == NULL || !is_user_vaddr ((const uint8_t *) buffer + size - 1)
+      || (const uint8_t *) buffer + size - 1 < (const uint8_t *) buffer)
+    exit (-1);
+  for (page = pg_round_down (buffer);
+       page <= (const uint8_t *) buffer + size - 1; page += PGSIZE)
+    {
+      struct page_table_entry *pte
+        = get_page_table_entry (cur, (void *) page);
+      if (pte == NULL || (write && !pte->writable))
+        exit (-1);
+    }
+}
+
+/* TASK 3 : Copies SIZE bytes from kernel buffer SRC to user buffer
+   DST a page at a time, bringing each page in and pinning it while
+   it is written, since the kernel cannot take page faults on user
+   memory.  Returns false if a page of DST cannot be written. */
+static bool
+copy_to_user (void *dst, const void *src, size_t size)
+{
+  uint8_t *udst = dst;
+  const uint8_t *ksrc = src;
+
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (udst);
+      void *kpage = page_pin (pg_round_down (udst), true);
+
+      if (kpage == NULL)
+        return false;
+      if (chunk > size)
+        chunk = size;
+      memcpy (udst, ksrc, chunk);
+      frame_unpin (kpage);
+      udst += chunk;
+      ksrc += chunk;
+      size -= chunk;
+    }
+  return true;
+}
+
 /* TASK 2: Acquires lock over file system */
 static void
 acquire_filelock (void)
@@ -89,10 +152,14 @@ syscall_init (void)
   syscall_map[SYS_CLOSE]    = (syscall_dispatcher) close;
   syscall_map[SYS_MMAP]     = (syscall_dispatcher) mmap;
   syscall_map[SYS_MUNMAP]   = (syscall_dispatcher) munmap;
+  syscall_map[SYS_STATS]    = (syscall_dispatcher) stats;
 
   /* File system code is regarded as a critical section. */
-  lock_init (&filelock);
-  lock_init (&mapid_lock);
+  lock_init_named (&filelock, "filelock");
+  lock_init_named (&mapid_lock, "mapid_lock");
+
+  file_handle_cache = kmem_cache_create ("file_handle",
+                                         sizeof (struct file_handle), NULL);
 }
 
 /* TASK 2: This function parses the input system call code and redirects
@@ -111,6 +178,13 @@ syscall_handler (struct intr_frame *f)
   int* stack_ptr = f->esp;
   syscall_num = *stack_ptr;
 
+  /* TASK 3 : fork() starts the child from the caller's registers,
+     so it needs the whole frame rather than the arguments */
+  if (syscall_num == SYS_FORK) {
+    f->eax = process_fork (f);
+    return;
+  }
+
   syscall_procedure = syscall_map[syscall_num];
   syscall_ret_val = syscall_procedure (*(stack_ptr + 1),
                                        *(stack_ptr + 2),
@@ -153,6 +227,9 @@ exit (int status)
   printf ("%s: exit(%d)\n", proper_thread_name, status);
 
 
+  /* TASK 3: The prefetch worker may still be reading the file */
+  prefetch_cancel (cur);
+
   /* TASK 2: Allow the file to be written and closed if file exists  */
   if (cur->file) {
     file_allow_write(cur->file);
@@ -161,13 +238,14 @@ exit (int status)
 
   /* TASK 3: Deletes all the mapped files dependencies */
   lock_acquire(&mapid_lock);
-  struct list *mmaps = &cur->mmapped_files;
-  struct list_elem *e = list_begin(mmaps);
+  struct list *areas = &cur->vm_areas;
+  struct list_elem *e = list_begin(areas);
 
-  while (e != list_end(mmaps)) {
-    struct vm_mmap *mmap = list_entry (e, struct vm_mmap, list_elem);
+  while (e != list_end(areas)) {
+    struct vm_area *area = list_entry (e, struct vm_area, elem);
     struct list_elem *next = list_next(e);
-    delete_mmap_entry(mmap);
+    if (area->mapid != MAP_FAILED)
+      delete_mmap_entry(area);
     e = next;
   }
   lock_release(&mapid_lock);
@@ -314,6 +392,8 @@ read (int fd, void *buffer, unsigned size)
     bytes_read = file_read (handle->file, buffer, size);
     release_filelock ();
   }
+  if (bytes_read > 0)
+    cur->stats.bytes_read += bytes_read;
   return bytes_read;
 }
 
@@ -364,6 +444,8 @@ write (int fd, const void *buffer, unsigned size)
     bytes_written = file_write (handle->file, buffer, size);
     release_filelock ();
   }
+  if (bytes_written > 0)
+    cur->stats.bytes_written += bytes_written;
   return bytes_written;
 }
 
@@ -409,10 +491,41 @@ close (int fd)
   acquire_filelock ();
   list_remove(&handle->elem); /* Removes file for thread's list of files */
   file_close(handle->file);   /* closes the file */
-  free(handle);               /* frees memory calloced for struct sys_file */
+  kmem_cache_free (file_handle_cache, handle);
   release_filelock ();
 }
 
+/* Copies the statistics of up to MAX live threads into BUFFER
+   and returns the number of entries written.  The threads are
+   sampled into a kernel buffer first, since they are walked with
+   interrupts off and BUFFER might not be resident. */
+int
+stats (struct thread_stats *buffer, int max)
+{
+  struct thread_stats *sample;
+  size_t cnt;
+
+  if (max <= 0)
+    return 0;
+  if (max > MAX_STATS_THREADS)
+    max = MAX_STATS_THREADS;
+
+  check_buffer_access (buffer, max * sizeof *buffer, true);
+
+  sample = malloc (max * sizeof *sample);
+  if (sample == NULL)
+    return -1;
+  cnt = thread_get_stats (sample, max);
+  if (!copy_to_user (buffer, sample, cnt * sizeof *sample))
+    {
+      free (sample);
+      exit (-1);
+    }
+  free (sample);
+
+  return cnt;
+}
+
 /* TASK 3 : Mapping */
 
 mapid_t mmap (int fd, void *addr) {
@@ -438,31 +551,22 @@ mapid_t mmap (int fd, void *addr) {
 			fd == STDIN_FILENO || fd == STDOUT_FILENO || !is_user_vaddr(addr))
 		return -1;
 
-	off_t offs = 0;
+	/* The whole file is mapped by one area, and the rest of its last
+	   page is zeros */
+	size_t zero_bytes = ROUND_UP (read_bytes, PGSIZE) - read_bytes;
 
 	lock_acquire(&mapid_lock);
 
 	cur->mapid++;
-	while (read_bytes > 0) {
-
-		/* Calculate how to fill this page.
-		   We will read PAGE_READ_BYTES bytes from FILE
-		   and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		/* Add mmap to page table/ fail if mapping already exists */
-		if (!insert_file(f, offs, addr, page_read_bytes, page_zero_bytes, NULL, MMAP_BIT)) {
-			lock_release(&mapid_lock);
-			munmap(cur->mapid);
-			cur->mapid--;
-			return -1;
-		}
 
-	    /* Advance. */
-	    read_bytes -= page_read_bytes;
-	    offs += page_read_bytes;
-	    addr += PGSIZE;
+	/* Add mmap to page table/ fail if mapping already exists */
+	if (!insert_file(f, 0, addr, read_bytes, zero_bytes, true, MMAP_BIT)) {
+		cur->mapid--;
+		lock_release(&mapid_lock);
+		acquire_filelock();
+		file_close(f);
+		release_filelock();
+		return -1;
 	}
 
 	lock_release(&mapid_lock);
@@ -474,38 +578,38 @@ mapid_t mmap (int fd, void *addr) {
 void munmap (mapid_t mapping) {
 
 	struct thread *curr = thread_current();
-	struct list *mmaps = &curr->mmapped_files;
-
-	struct list_elem *e = list_begin(mmaps);
+	struct vm_area *area;
 
-  /* Free each mapped page */
-	while (e != list_end(mmaps)) {
-		struct vm_mmap *mmap = list_entry (e, struct vm_mmap, list_elem);
+	if (mapping == MAP_FAILED)
+		return;
 
-		struct list_elem *next = list_next(e);
-
-		if (mmap->mapid == mapping) {
-			delete_mmap_entry(mmap);
-		}
-
-		e = next;
+  /* Free the mapped pages */
+	lock_acquire(&mapid_lock);
+	area = get_mmap_area(curr, mapping);
+	if (area != NULL) {
+		delete_mmap_entry(area);
 	}
-
+	lock_release(&mapid_lock);
 }
 
 /* TASK 3 : Frees Mapped File */
-void delete_mmap_entry(struct vm_mmap *mmap) {
+void delete_mmap_entry(struct vm_area *area) {
 
 	struct thread *curr = thread_current();
+	size_t i;
+
+	for (i = 0; i < area->page_cnt; i++) {
+		struct page_table_entry *pte = &area->pages[i];
+		struct file_d file_d;
 
-	struct page_table_entry *pte = mmap->pte;
-	if (pte->loaded) {
-		if (pagedir_is_dirty(curr->pagedir, pte->vaddr)) {
+		if (!pte->loaded)
+			continue;
+		if (pagedir_is_dirty(curr->pagedir, pte->vaddr)
+		    && page_file_data(curr, pte->vaddr, &file_d)) {
 
 			/* Write to file if modified */
-			file_write_at(pte->page_sourcefile->filename,
-        pte->vaddr, pte->page_sourcefile->read_bytes,
-        pte->page_sourcefile->file_offset);
+			file_write_at(file_d.filename, pte->vaddr, file_d.read_bytes,
+			              file_d.file_offset);
 		}
 
 		/* Free frames if they have been loaded */
@@ -513,11 +617,11 @@ void delete_mmap_entry(struct vm_mmap *mmap) {
 		pagedir_clear_page(curr->pagedir, pte->vaddr);
 	}
 
-	/* Delete from hash page table and mmap list */
-	list_remove(&mmap->list_elem);
-	hash_delete(&curr->sup_page_table, &pte->elem);
-
-	/* Free page and mmap */
-	free(mmap->pte);
-	free(mmap);
+	/* Delete from page table, then close the mapping's own reference
+	   to the file */
+	struct file *file = area->file;
+	delete_vm_area(curr, area);
+	acquire_filelock();
+	file_close(file);
+	release_filelock();
 }
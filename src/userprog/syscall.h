@@ -7,6 +7,9 @@
 #include "lib/user/syscall.h"
 #include "vm/frame.h"
 
+/* TASK 3 : Cache that file handles come from. */
+extern struct kmem_cache *file_handle_cache;
+
 /* Tasks 2 and later. */
 void syscall_init (void);
 
@@ -27,6 +30,6 @@ void close (int fd);
 /* TASK 3 */
 mapid_t mmap(int fd, void* addr);
 void munmap(mapid_t mapping);
-void delete_mmap_entry(struct vm_mmap *mmap);
+void delete_mmap_entry(struct vm_area *area);
 
 #endif /* userprog/syscall.h */
@@ -4,6 +4,7 @@
 #include "userprog/gdt.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/vaddr.h"
 
 /* The Task-State Segment (TSS).
@@ -72,35 +73,55 @@ struct tss
     uint16_t trace, bitmap;
   };
 
-/* Kernel TSS. */
-static struct tss *tss;
+/* Kernel TSS.  TASK 1: One per CPU, since each CPU switches to
+   the kernel stack of the thread it is running. */
+static struct tss *tss[SMP_MAX_CPUS];
 
-/* Initializes the kernel TSS. */
+/* Initializes the BSP's kernel TSS. */
 void
 tss_init (void) 
 {
+  tss_init_cpu (0);
+  tss_update ();
+}
+
+/* TASK 1: Initializes the kernel TSS of the CPU with index ID. */
+void
+tss_init_cpu (unsigned id)
+{
+  ASSERT (id < SMP_MAX_CPUS);
+
   /* Our TSS is never used in a call gate or task gate, so only a
      few fields of it are ever referenced, and those are the only
      ones we initialize. */
-  tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
-  tss->ss0 = SEL_KDSEG;
-  tss->bitmap = 0xdfff;
-  tss_update ();
+  tss[id] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  tss[id]->ss0 = SEL_KDSEG;
+  tss[id]->bitmap = 0xdfff;
+}
+
+/* TASK 1: Frees the kernel TSS of the CPU with index ID, which
+   failed to start. */
+void
+tss_free_cpu (unsigned id)
+{
+  ASSERT (id < SMP_MAX_CPUS && tss[id] != NULL);
+
+  palloc_free_page (tss[id]);
+  tss[id] = NULL;
 }
 
-/* Returns the kernel TSS. */
+/* Returns the kernel TSS of the CPU with index ID. */
 struct tss *
-tss_get (void) 
+tss_get (unsigned id) 
 {
-  ASSERT (tss != NULL);
-  return tss;
+  ASSERT (id < SMP_MAX_CPUS && tss[id] != NULL);
+  return tss[id];
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
-   of the thread stack. */
+/* Sets the ring 0 stack pointer in the running CPU's TSS to point
+   to the end of the thread stack. */
 void
 tss_update (void) 
 {
-  ASSERT (tss != NULL);
-  tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  tss_get (this_cpu ()->id)->esp0 = (uint8_t *) thread_current () + PGSIZE;
 }
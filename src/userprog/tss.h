@@ -5,7 +5,9 @@
 
 struct tss;
 void tss_init (void);
-struct tss *tss_get (void);
+void tss_init_cpu (unsigned id);
+void tss_free_cpu (unsigned id);
+struct tss *tss_get (unsigned id);
 void tss_update (void);
 
 #endif /* userprog/tss.h */
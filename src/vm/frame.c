@@ -1,22 +1,41 @@
 #include "vm/frame.h"
 #include <hash.h>
 #include <list.h>
-#include "threads/malloc.h"
+#include "threads/init.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include "userprog/syscall.h"
 #include "vm/page.h"
+#include "vm/share.h"
 #include "vm/swap.h"
 
 static struct lock frame_lock;
 static struct list eviction_list;
 
+/* TASK 3 : Frame table, mapping each frame's kernel address to its
+   struct frame, so that lookups don't have to walk eviction_list */
+static struct hash frame_table;
+
+/* TASK 3 : Signalled, with the frame lock, when the clock has
+   finished evicting a frame */
+static struct condition frame_evicted;
+
+/* TASK 3 : Cache the frame structs come from */
+static struct kmem_cache *frame_cache;
+
+/* TASK 3 : Page-out daemon state, see pageout_daemon() */
+static struct semaphore pageout_sema;  /* Upped to wake the daemon */
+static bool pageout_waking;            /* Daemon woken but not done? */
+static thread_func pageout_daemon NO_RETURN;
+
 /* Task 3 : Frames helper functions to initialise */
-static void acquire_framelock (void);
-static void release_framelock (void);
+static unsigned frame_hash (const struct hash_elem *, void *aux UNUSED);
+static bool frame_less (const struct hash_elem *, const struct hash_elem *,
+                        void *aux UNUSED);
 
 /* TASK 3 : Acquires lock over frame table */
 void
@@ -32,153 +51,508 @@ release_framelock (void)
   lock_release (&frame_lock);
 }
 
+/* TASK 3 : Returns a hash value for a frame, from its kernel address */
+static unsigned
+frame_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, hash_elem);
+  return hash_bytes (&f->addr, sizeof f->addr);
+}
+
+/* TASK 3 : Returns true if frame 'a' has a lower kernel address than
+   frame 'b' */
+static bool
+frame_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  const struct frame *fa = hash_entry (a, struct frame, hash_elem);
+  const struct frame *fb = hash_entry (b, struct frame, hash_elem);
+  return fa->addr < fb->addr;
+}
+
 /* TASK 3 : Initializes the frame hash table and lock */
 void
 frame_init (void)
 {
   list_init(&eviction_list);
-  lock_init(&frame_lock);
+  hash_init(&frame_table, frame_hash, frame_less, NULL);
+  lock_init_named(&frame_lock, "frame_lock");
+  cond_init(&frame_evicted);
+  frame_cache = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+
+  /* Start the page-out daemon, keeping the watermarks sensible */
+  if (pageout_high <= pageout_low)
+    pageout_high = pageout_low + 1;
+  sema_init (&pageout_sema, 0);
+  thread_create ("pageout", PRI_DEFAULT, pageout_daemon, NULL);
 }
 
-/* TASK 3 : Evicts a frame and replaces it with a new one */
-void*
-frame_evict (enum palloc_flags flags)
+/* TASK 3 : CLOCK (second-chance) page replacement.
+
+   The frames in eviction_list form a circle, and clock_hand points
+   at the next frame to consider.  A frame whose page has been
+   accessed since the hand last passed it, through either its user
+   mapping or its kernel alias, gets a second chance: its accessed
+   bits are cleared and the hand moves on.  The first frame found
+   unaccessed is evicted.  The hand stays where it stopped, so each
+   eviction continues the sweep instead of starting it over.
+
+   Frames are pinned, by holding their single_frame_lock, while
+   they are being filled in and while they are being evicted; the
+   hand skips pinned frames.
+
+   With the "-evict=fifo" kernel option the accessed bits are
+   ignored, which turns the clock into FIFO replacement, for
+   comparison. */
+bool frame_evict_fifo;
+
+/* The next frame the clock hand will consider, or NULL to start
+   from the beginning of eviction_list. */
+static struct list_elem *clock_hand;
+
+static bool frame_is_accessed (struct frame *);
+static bool frame_is_dirty (struct frame *);
+static void frame_unlink (struct frame *);
+static struct frame *clock_next (void);
+static void frame_write_out (struct frame *);
+static bool frame_wait_evicted (struct frame *);
+
+/* TASK 3 : Returns true if frame F's page has been accessed through
+   its user mapping or its kernel alias, clearing both accessed
+   bits */
+static bool
+frame_is_accessed (struct frame *f)
 {
-  struct list_elem *e = list_begin (&eviction_list);
-  struct frame *victim = list_entry (e, struct frame, list_elem);
-  struct page_table_entry* pte = get_page_table_entry(&victim->thread->sup_page_table
-  , victim->upage);
-
-  lock_acquire(&victim->single_frame_lock);
-  while(true) {
-    if(!victim->writable){
-        bool accessable = true;
-        for (e = list_begin(&eviction_list); e != list_end(&eviction_list); e = list_next(e)){
-          /* Check that the frame has been accessed */
-          if(pagedir_is_accessed (victim->thread->pagedir, victim->upage)) {
-              pagedir_set_accessed (victim->thread->pagedir, victim->upage, false);
-              accessable = false;
-          }
-        }
-        if (accessable) {
-          for (e = list_begin(&eviction_list); e != list_end(&eviction_list); e = list_next(e)){
-            /* If frame has been accessed and has a MMAP_BIT, then unmap */
-            if(accessable && pte->bit_set == MMAP_BIT ) {
-                    munmap(pte->mapid);
-                    goto mmap;
-            }
-            break;
-          }
-        }
-    }
+  if (f->shared != NULL)
+    return share_is_accessed (f->shared, f->addr);
 
-    if ( e == list_end (&eviction_list)) {
-      e = list_begin (&eviction_list);
-    }
-    victim = list_entry (e, struct frame, list_elem);
+  uint32_t *pd = f->thread->pagedir;
+  bool accessed = (pagedir_is_accessed (pd, f->upage)
+                   || pagedir_is_accessed (init_page_dir, f->addr));
+
+  if (accessed) {
+    pagedir_set_accessed (pd, f->upage, false);
+    pagedir_set_accessed (init_page_dir, f->addr, false);
   }
+  return accessed;
+}
+
+/* TASK 3 : Returns true if frame F's page has been written through
+   its user mapping or its kernel alias */
+static bool
+frame_is_dirty (struct frame *f)
+{
+  return (pagedir_is_dirty (f->thread->pagedir, f->upage)
+          || pagedir_is_dirty (init_page_dir, f->addr));
+}
+
+/* TASK 3 : Removes frame F from the frame table and the eviction
+   list, moving the clock hand off it first.  The frame lock must be
+   held */
+static void
+frame_unlink (struct frame *f)
+{
+  if (clock_hand == &f->list_elem)
+    clock_hand = list_next (clock_hand);
+  hash_delete (&frame_table, &f->hash_elem);
+  list_remove (&f->list_elem);
+}
 
-  lock_release(&victim->single_frame_lock);
+/* TASK 3 : Returns the frame under the clock hand and advances the
+   hand, wrapping around at the end of eviction_list.  The frame
+   lock must be held and eviction_list must not be empty */
+static struct frame *
+clock_next (void)
+{
+  if (clock_hand == NULL || clock_hand == list_end (&eviction_list))
+    clock_hand = list_begin (&eviction_list);
+  struct frame *f = list_entry (clock_hand, struct frame, list_elem);
+  clock_hand = list_next (clock_hand);
+  return f;
+}
+
+/* TASK 3 : Writes the page in frame F, which has been unmapped from
+   its owner, to wherever it will be read back from:
+     - a dirty memory mapped page goes back to its file, and a clean
+       one is just dropped;
+     - an anonymous page, or a file page that has been modified,
+       goes to swap, and stays there until it is faulted back in;
+     - a clean file page is dropped, to be read from its file
+       again.
+   Unless the owner is the running thread, its page table is held
+   shared meanwhile, so that the owner cannot unmap the page's area
+   and free it under the write. */
+static void
+frame_write_out (struct frame *f)
+{
+  struct thread *t = f->thread;
+  struct rwlock *table_lock = &t->sup_page_table_lock;
+  bool lock = (t != thread_current ()
+               && !rwlock_held_by_current_thread (table_lock));
+  struct page_table_entry *pte;
+  bool dirty = frame_is_dirty (f);
+  struct file_d file_d;
 
-  /* If frame has not been modified and not been accessed */
-  if(check_pagedir_not_dirty(victim, pte)&& !pagedir_is_accessed (victim->thread->pagedir, victim->upage)) {
-        pte->loaded = false;
-        acquire_framelock();
-        list_remove(e);
-        list_push_back(&eviction_list, e);
-        release_framelock();
+  if (lock)
+    rwlock_acquire_shared (table_lock);
+  pte = get_page_table_entry (t, f->upage);
+  if (pte == NULL) {
+    if (lock)
+      rwlock_release_shared (table_lock);
+    return;
   }
 
-  mmap:
+  if (pte->bit_set == MMAP_BIT) {
+    if (dirty && page_file_data (f->thread, f->upage, &file_d))
+      file_write_at (file_d.filename, f->addr, file_d.read_bytes,
+                     file_d.file_offset);
+  } else if (pte->bit_set == SWAP_BIT || dirty) {
+    pte->swap_index = swap_store (f->addr);
+    pte->bit_set = SWAP_BIT;
+  }
+
+  /* The owner may already be faulting on the page; make sure it
+     sees where the page went before it sees that it is gone */
+  barrier ();
+  pte->loaded = false;
+  if (lock)
+    rwlock_release_shared (table_lock);
+}
+
+/* TASK 3 : If frame F is being evicted, waits until the clock has
+   freed it and returns true.  F must not be used after that.
+   Otherwise returns false.  The frame lock must be held */
+static bool
+frame_wait_evicted (struct frame *f)
+{
+  void *addr = f->addr;
+
+  if (!f->evicting)
+    return false;
+  do
+    cond_wait (&frame_evicted, &frame_lock);
+  while ((f = frame_lookup (addr)) != NULL && f->evicting);
+  return true;
+}
+
+/* TASK 3 : Waits until the clock has freed a frame it was evicting.
+   For a thread that found a page unmapped but not yet marked as not
+   loaded, which happens while the page is being saved.  The frame
+   lock must be held */
+void
+frame_wait_eviction (void)
+{
+  cond_wait (&frame_evicted, &frame_lock);
+}
+
+/* TASK 3 : Evicts a frame chosen by the clock, returning its page to
+   the user pool.  Returns false if there was nothing to evict because
+   every frame is pinned */
+static bool
+frame_evict_one (void)
+{
+  struct frame *victim = NULL;
+  size_t scanned, limit;
+
+  acquire_framelock();
+
+  /* Two full turns clear every accessed bit, so the third finds a
+     victim unless all frames are pinned */
+  limit = 3 * list_size (&eviction_list);
+  for (scanned = 0; scanned < limit; scanned++) {
+    struct frame *f = clock_next ();
+    if (lock_held_by_current_thread (&f->single_frame_lock)
+        || !lock_try_acquire (&f->single_frame_lock))
+      continue;
+    if (!frame_evict_fifo && frame_is_accessed (f)) {
+      lock_release (&f->single_frame_lock);
+      continue;
+    }
+    victim = f;
+    break;
+  }
+
+  if (victim == NULL) {
+    release_framelock();
+    return false;
+  }
+
+  /* Unmap the page so that its owner faults on it from now on.  The
+     frame stays in the table, pinned and marked as being evicted,
+     while its contents are saved, but the frame lock is not held
+     for that, so that other threads can allocate and free frames
+     meanwhile.  A shared page is unmapped from all of its owners
+     when it is saved, and is never dirty */
+  victim->evicting = true;
+  if (victim->shared == NULL)
+    pagedir_clear_page (victim->thread->pagedir, victim->upage);
+  release_framelock();
+
+  if (victim->shared != NULL)
+    share_evict (victim->shared);
+  else
+    frame_write_out (victim);
+
   acquire_framelock();
-  victim = palloc_get_page(flags);
+  frame_unlink (victim);
+  palloc_free_page (victim->addr);
+  cond_broadcast (&frame_evicted, &frame_lock);
   release_framelock();
 
-  return victim;
+  lock_release (&victim->single_frame_lock);
+  kmem_cache_free (frame_cache, victim);
+
+  return true;
+}
+
+/* TASK 3 : Evicts a frame chosen by the clock and returns a new page
+   allocated with FLAGS, or NULL if every frame is pinned or the
+   freed page was taken by another thread first */
+void*
+frame_evict (enum palloc_flags flags)
+{
+  if (!frame_evict_one ())
+    return NULL;
+  return palloc_get_page (flags);
 }
 
+/* TASK 3 : Page-out daemon.
+
+   Rather than leave every eviction to frame_alloc() on the faulting
+   thread, a kernel thread keeps a reserve of free user frames.  When
+   an allocation leaves fewer than pageout_low frames free, the
+   daemon is woken, and it evicts frames, writing dirty ones to swap
+   or their file, until pageout_high frames are free.  Most faults
+   then find a free frame straight away.  If the pool runs dry
+   anyway, frame_alloc() still evicts for itself.
 
-/* TASK 3: Helper function to check if pagedir accessed */
-bool check_pagedir_not_dirty(struct frame* frame, struct page_table_entry* pte) {
-  /* Check if frame has not been modified */
-  if(!pagedir_is_dirty(frame->thread->pagedir, frame->upage)) {
-      /* If page table entry is a SWAP_BIT, then swap frame out */
-      if(pte->bit_set == SWAP_BIT) {
-        struct swap_slot* ss = (struct swap_slot*)malloc(sizeof(struct swap_slot));
-        ss->swap_frame = frame;
-        size_t index = swap_store(frame->upage);
-        ss->swap_addr = index;
-        pagedir_clear_page(frame->thread->pagedir, pte->vaddr);
+   The watermarks are set by the "-pageout-low" and "-pageout-high"
+   kernel options. */
+size_t pageout_low = 16;
+size_t pageout_high = 32;
+
+/* TASK 3 : Wakes the page-out daemon if free user frames have fallen
+   below the low watermark and it is not already at work */
+static void
+pageout_check (void)
+{
+  enum intr_level old_level;
+  bool wake = false;
+
+  if (palloc_user_free_pages () >= pageout_low)
+    return;
+
+  old_level = intr_disable ();
+  if (!pageout_waking) {
+    pageout_waking = true;
+    wake = true;
+  }
+  intr_set_level (old_level);
+
+  if (wake)
+    sema_up (&pageout_sema);
+}
+
+/* TASK 3 : Body of the page-out daemon */
+static void
+pageout_daemon (void *aux UNUSED)
+{
+  for (;;) {
+    bool stuck = false;
+
+    sema_down (&pageout_sema);
+    while (palloc_user_free_pages () < pageout_high)
+      if (!frame_evict_one ()) {
+        stuck = true;
+        break;
       }
-      /* Free the frame */
-      frame_free(frame);
-      return true;
+
+    /* An allocation that found too few frames while the flag was
+       still set did not wake us, so look once more after clearing
+       it, unless every frame is pinned and there is nothing to do */
+    pageout_waking = false;
+    barrier ();
+    if (!stuck)
+      pageout_check ();
   }
-  return false;
 }
 
 
-/* TASK 3 : Allocates a new page, and adds it to the frame table */
+/* TASK 3 : Allocates a new user page for UPAGE, evicting another if
+   memory is short, and adds it to the frame table.  The new frame is
+   pinned, so that it is not evicted before it has been filled in and
+   mapped; the caller must then call frame_unpin() */
 void*
 frame_alloc (void * upage, enum palloc_flags flags)
 {
-  acquire_framelock();
-  void* kpage = palloc_get_page(flags);
-  release_framelock();
+  flags |= PAL_USER;
 
-  /* evict a frame if not enough memory or
-  Check that frame not mapped to kernel page */
-  if (kpage == NULL || frame_get(kpage) != NULL){
-    return frame_evict(flags);
+  void* kpage = palloc_get_page(flags);
+  pageout_check ();
+  while (kpage == NULL) {
+    acquire_framelock();
+    bool empty = list_empty (&eviction_list);
+    release_framelock();
+    if (empty)
+      return NULL;
+    kpage = frame_evict(flags);
   }
 
-  if(kpage != NULL) {
-
-    /* build up the frame */
-    struct frame *frame = (struct frame*)malloc(sizeof(struct frame));
-    frame->addr = kpage;
-    frame->upage = upage;
-    frame->frame_sourcefile = malloc(sizeof(struct file_d));
-    frame->writable = false;
-    frame->thread = thread_current();
-    lock_init(&frame->single_frame_lock);
+  /* build up the frame */
+  struct frame *frame = kmem_cache_alloc (frame_cache);
+  if (frame == NULL) {
+    palloc_free_page (kpage);
+    return NULL;
+  }
+  frame->addr = kpage;
+  frame->upage = upage;
+  frame->writable = false;
+  frame->thread = thread_current();
+  frame->shared = NULL;
+  frame->evicting = false;
+  lock_init_named(&frame->single_frame_lock, "single_frame_lock");
+  lock_acquire(&frame->single_frame_lock);
 
-    /* Initialize frame's page list */
-    acquire_framelock();
+  /* Add the frame to the frame table and the eviction list, just
+     behind the clock hand so that it is considered last */
+  acquire_framelock();
+  hash_insert (&frame_table, &frame->hash_elem);
+  if (clock_hand != NULL)
+    list_insert (clock_hand, &frame->list_elem);
+  else
     list_push_back (&eviction_list, &frame->list_elem);
-    release_framelock();
-  }
+  release_framelock();
+
   return kpage;
 }
 
+/* TASK 3 : Unpins the frame at kernel address ADDR, allocated by the
+   current thread with frame_alloc(), making it a candidate for
+   eviction */
+void
+frame_unpin (void *addr)
+{
+  struct frame *frame = frame_get (addr);
+  if (frame != NULL && lock_held_by_current_thread (&frame->single_frame_lock))
+    lock_release (&frame->single_frame_lock);
+}
+
 
 /* TASK 3 : Free's a frame and removes it from frame table */
 void
 frame_free (void * addr)
 {
+  if (addr == NULL)
+    return;
+
   acquire_framelock();
-  /* Get frame mapped to address and unmap the address */
-  struct frame *frame = frame_get(addr);
-  list_remove (&frame->list_elem);
+  /* Get frame mapped to address and unmap the address.  It may have
+     been evicted in the meantime, or still be on its way out, in
+     which case there is nothing left to do */
+  struct frame *frame = frame_lookup(addr);
+  if (frame == NULL || frame_wait_evicted (frame)) {
+    release_framelock();
+    return;
+  }
+  frame_unlink (frame);
   palloc_free_page(addr);
   release_framelock();
-  if (frame->frame_sourcefile) {
-	     free(frame->frame_sourcefile);
+  if (lock_held_by_current_thread (&frame->single_frame_lock))
+    lock_release (&frame->single_frame_lock);
+  kmem_cache_free (frame_cache, frame);
+}
+
+/* TASK 3 : Frees every frame owned by thread T, which is exiting.
+   Must be called before T's page directory and page table are
+   destroyed, since frame_evict() may use them until then.  Shared
+   frames are left for share_release() to unmap as T's page table
+   is destroyed */
+void
+frame_free_thread (struct thread *t)
+{
+  struct list_elem *e, *next;
+  struct list freed;
+
+  list_init (&freed);
+
+  acquire_framelock();
+  for (e = list_begin (&eviction_list); e != list_end (&eviction_list);
+       e = next) {
+    struct frame *frame = list_entry (e, struct frame, list_elem);
+    next = list_next (e);
+    if (frame->thread == t && frame->shared == NULL) {
+      /* The clock may be saving the page to T's swap slot or file;
+         it unlinks the frame when done, so look again from the
+         start */
+      if (frame->evicting) {
+        cond_wait (&frame_evicted, &frame_lock);
+        next = list_begin (&eviction_list);
+        continue;
+      }
+      pagedir_clear_page (t->pagedir, frame->upage);
+      frame_unlink (frame);
+      palloc_free_page (frame->addr);
+      list_push_back (&freed, &frame->list_elem);
+    }
+  }
+  release_framelock();
+
+  while (!list_empty (&freed)) {
+    struct frame *frame = list_entry (list_pop_front (&freed),
+                                      struct frame, list_elem);
+    kmem_cache_free (frame_cache, frame);
+  }
+}
+
+/* TASK 3 : Marks the frame at kernel address ADDR, pinned by the
+   current thread, as holding shared page SP.  From now on it is
+   evicted through SP rather than its allocating thread, and it
+   outlives that thread */
+void
+frame_set_shared (void *addr, struct share_page *sp)
+{
+  acquire_framelock();
+  struct frame *frame = frame_lookup(addr);
+  ASSERT (frame != NULL && lock_held_by_current_thread (&frame->single_frame_lock));
+  frame->shared = sp;
+  release_framelock();
+}
+
+/* TASK 3 : Frees the frame at kernel address ADDR, if it still holds
+   shared page SP.  It may not: the clock may have evicted it, and
+   its page may have been handed out again since */
+void
+frame_free_shared (void *addr, struct share_page *sp)
+{
+  acquire_framelock();
+  struct frame *frame = frame_lookup(addr);
+  if (frame == NULL || frame->shared != sp || frame_wait_evicted (frame)) {
+    release_framelock();
+    return;
   }
-  free(frame);
+  frame_unlink (frame);
+  palloc_free_page (addr);
+  release_framelock();
+  kmem_cache_free (frame_cache, frame);
+}
+
+/* TASK 3: Returns pointer to vm_frame given kernel address, or NULL if
+   there is none.  The frame lock must be held. */
+struct frame *
+frame_lookup (void *addr)
+{
+  struct frame key;
+  struct hash_elem *e;
+
+  key.addr = addr;
+  e = hash_find (&frame_table, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct frame, hash_elem) : NULL;
 }
 
 /* TASK 3: Returns pointer to vm_frame given kernel address */
 struct frame* frame_get(void *addr) {
-	struct list_elem *elem;
-  /* Go through eviction list and get frame with the address addr */
-	for (elem = list_begin(&eviction_list); elem != list_end(&eviction_list);
-		 elem = list_next(elem)) {
-			struct frame *fr = list_entry(elem, struct frame, list_elem);
-			if(fr->addr == addr) {
-				return fr;
-			}
-	}
-  /* If no frame found with address addr, then return NULL */
-	return NULL;
+  acquire_framelock();
+  struct frame *frame = frame_lookup(addr);
+  release_framelock();
+  return frame;
 }
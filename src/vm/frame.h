@@ -7,32 +7,45 @@
 #include "threads/palloc.h"
 #include "vm/page.h"
 
+struct share_page;
+
 struct frame
 {
   void *addr;                          /* page's physical memory address */
   void *upage;                         /* page's user virtual memory address */
   struct thread *thread;               /* owner thread of page */
-  struct file_d *frame_sourcefile;     /* info stored if frame is memory mapped
-                                          file */
   bool writable;                       /* boolean checking whether the frame
                                           table is writable */
   struct list_elem list_elem;          /* Used to store the frame in the page table. */
-  struct lock single_frame_lock;       /* Lock for synchronisation */
+  struct hash_elem hash_elem;          /* Element of the frame table, keyed
+                                          by addr */
+  struct lock single_frame_lock;       /* Held while the frame is pinned */
+  bool evicting;                       /* Being written out by the clock,
+                                          which will free it */
+  struct share_page *shared;           /* Shared read-only page it holds, in
+                                          which case thread and upage are
+                                          meaningless, or NULL */
 };
 
-struct file_d
-{
-  struct file *filename;               /* File associated with frame */
-  int file_offset;                     /* Offset of the file */
-  size_t read_bytes;                   /* Bytes to read in file */
-  size_t zero_bytes;                   /* Bytes to set to sero in file */
-};
+/* TASK 3 : Use FIFO rather than CLOCK replacement? */
+extern bool frame_evict_fifo;
+
+/* TASK 3 : Free user frame watermarks for the page-out daemon */
+extern size_t pageout_low;
+extern size_t pageout_high;
 
 void frame_init (void);
+void acquire_framelock (void);
+void release_framelock (void);
+struct frame *frame_lookup (void *addr);
 void* frame_evict (enum palloc_flags flags);
-bool check_pagedir_not_dirty(struct frame* frame, struct page_table_entry* pte);
 void* frame_alloc(void * upage, enum palloc_flags flags);
+void frame_unpin (void *addr);
 struct frame* frame_get(void *addr);
 void frame_free (void * addr);
+void frame_free_thread (struct thread *t);
+void frame_wait_eviction (void);
+void frame_set_shared (void *addr, struct share_page *sp);
+void frame_free_shared (void *addr, struct share_page *sp);
 
 #endif /* vm/frame.h */
@@ -2,129 +2,333 @@
 #include <stdio.h>
 #include <string.h>
 #include <stddef.h>
-#include <hash.h>
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
+#include "threads/init.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "filesys/file.h"
+#include "vm/share.h"
 #include "vm/swap.h"
 #include "vm/frame.h"
 
-static struct lock page_lock;
+/* TASK 3 : The zero page.  Pages of a process that are all zeros,
+   its BSS and new stack pages, are ZERO_BIT pages: they have
+   nothing to load, so a read maps this one page of zeros,
+   read-only, into every process that reads one, at the cost of no
+   frame.  Only the first write to such a page gives it a frame of
+   its own, see load_zero().  The zero page is a kernel page, so it
+   is never evicted. */
+static void *zero_page;
 
-/* Task 3 : Hash's helper functions to initialise */
-static unsigned page_hash_table(const struct hash_elem *h_elem, void *aux UNUSED);
-static bool is_lower_hash_elem(const struct hash_elem* a, const struct hash_elem* b, void *aux UNUSED);
-static void page_action_func (struct hash_elem *e, void *aux);
-
-static void acquire_pagelock (void);
-static void release_pagelock (void);
-
-/* TASK 3 : Acquires lock over sup page table */
-void
-acquire_pagelock (void)
+/* TASK 3 : Returns true if AREA covers user virtual address VADDR */
+static bool
+area_contains (const struct vm_area *area, const void *vaddr)
 {
-  lock_acquire (&page_lock);
+  return (vaddr >= area->start
+          && (size_t) (vaddr - area->start) < area->page_cnt * PGSIZE);
 }
 
-/* TASK 3 : Releases lock from sup page table */
-void
-release_pagelock (void)
+/* TASK 3 : Returns true if AREA overlaps the PAGE_CNT pages from
+   START */
+static bool
+area_overlaps (const struct vm_area *area, const void *start,
+               size_t page_cnt)
 {
-  lock_release (&page_lock);
+  const void *end = start + page_cnt * PGSIZE;
+  const void *area_end = area->start + area->page_cnt * PGSIZE;
+  return start < area_end && area->start < end;
 }
 
-/* TASK 3 : Returns a hash value for a sub page table. Hashes the page table's address as
-   addresses should be unique. */
-static unsigned
-page_hash_table(const struct hash_elem *h_elem, void *aux UNUSED) {
-  struct page_table_entry* pte = hash_entry(h_elem, struct page_table_entry, elem);
-  int hash = (int) pte->vaddr;
-  return hash_int(hash);
+/* TASK 3 : Allocates an area of PAGE_CNT pages from START, all of
+   them NONE_BIT pages, with no file.  Returns NULL if out of
+   memory */
+static struct vm_area *
+area_create (void *start, size_t page_cnt)
+{
+  struct vm_area *area;
+  size_t i;
+
+  area = malloc (sizeof *area + page_cnt * sizeof *area->pages);
+  if (area == NULL) {
+    return NULL;
+  }
+  area->start = start;
+  area->page_cnt = page_cnt;
+  area->file = NULL;
+  area->offset = 0;
+  area->read_bytes = 0;
+  area->mapid = MAP_FAILED;
+  for (i = 0; i < page_cnt; i++) {
+    struct page_table_entry *pte = &area->pages[i];
+    pte->vaddr = start + i * PGSIZE;
+    pte->shared = NULL;
+    pte->swap_index = -1;
+    pte->bit_set = NONE_BIT;
+    pte->writable = false;
+    pte->loaded = false;
+  }
+  return area;
 }
 
-/* TASK 3 : Returns true if a hash table 'a' comes before hash table 'b'. Orders hash tables
-   by their addresses. */
+/* TASK 3 : Adds AREA to thread T's page table, keeping the areas in
+   order of address.  Fails, returning false, if it overlaps an
+   area already there */
 static bool
-is_lower_hash_elem(const struct hash_elem* a, const struct hash_elem* b, void *aux UNUSED) {
-  const struct page_table_entry* pte_a;
-  const struct page_table_entry* pte_b;
-
-  pte_a = hash_entry(a, struct page_table_entry, elem);
-  pte_b = hash_entry(b, struct page_table_entry, elem);
-
-  return pte_a->vaddr < pte_b->vaddr;
-
+area_insert (struct thread *t, struct vm_area *area) {
+  struct list_elem *e;
+  bool success = true;
+
+  rwlock_acquire_exclusive (&t->sup_page_table_lock);
+  for (e = list_begin (&t->vm_areas); e != list_end (&t->vm_areas);
+       e = list_next (e)) {
+    struct vm_area *a = list_entry (e, struct vm_area, elem);
+    if (area_overlaps (a, area->start, area->page_cnt)) {
+      success = false;
+      break;
+    }
+    if (a->start > area->start) {
+      break;
+    }
+  }
+  if (success) {
+    list_insert (e, &area->elem);
+  }
+  rwlock_release_exclusive (&t->sup_page_table_lock);
+  return success;
 }
 
-/* TASK 3 : Free sup page table */
+/* TASK 3 : Free sup page table entry, giving back the swap slot of a
+   page that is swapped out, along with its place in the compressed
+   pool, or its reference to a shared page */
 static void
-page_action_func (struct hash_elem *e, void *aux UNUSED) {
-	struct page_table_entry *pte = hash_entry(e, struct page_table_entry, elem);
-	free(pte);
+page_action_func (struct thread *t, struct page_table_entry *pte) {
+	/* The zero page must not go when the page directory does */
+	if (pte->loaded && pte->bit_set == ZERO_BIT) {
+	  pagedir_clear_page (t->pagedir, pte->vaddr);
+	}
+	if (!share_release (pte) && !pte->loaded && pte->bit_set == SWAP_BIT) {
+	  struct swap_slot ss;
+	  ss.swap_addr = pte->swap_index;
+	  swap_free (&ss);
+	}
 }
 
-/* TASK 3: Initialise page table */
+/* TASK 3: Allocates the zero page */
 void
-page_table_init(struct hash* hash) {
-  hash_init(hash, page_hash_table, is_lower_hash_elem, NULL);
-  lock_init (&page_lock);
+page_init (void) {
+  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 }
 
-/* TASK 3: Destroy page table */
+/* TASK 3: Initialise thread T's page table.  Only T changes its
+   table, holding its sup_page_table_lock exclusively to do so.  Other
+   threads, the frame evictor and the prefetch worker, hold it shared
+   while they use an area or entry of T's, so that the area cannot be
+   freed under them and they do not queue behind one another. */
 void
-page_table_destroy (struct hash *hash) {
-  if(hash == NULL) {
-    return;
+page_table_init(struct thread *t) {
+  list_init (&t->vm_areas);
+  rwlock_init (&t->sup_page_table_lock);
+}
+
+/* TASK 3: Destroy thread T's page table.  T's frames must have been
+   freed first, which waits out any eviction of them, since an
+   eviction holds the table shared */
+void
+page_table_destroy (struct thread *t) {
+  rwlock_acquire_exclusive (&t->sup_page_table_lock);
+  while (!list_empty (&t->vm_areas)) {
+    struct vm_area *area = list_entry (list_pop_front (&t->vm_areas),
+                                       struct vm_area, elem);
+    size_t i;
+
+    for (i = 0; i < area->page_cnt; i++) {
+      if (area->pages[i].bit_set != NONE_BIT) {
+        page_action_func (t, &area->pages[i]);
+      }
+    }
+    free (area);
   }
-	hash_destroy(hash, page_action_func);
+  rwlock_release_exclusive (&t->sup_page_table_lock);
 }
 
-/* TASK 3: Get page table from hash table using key: virtual address */
-struct page_table_entry*
-get_page_table_entry(struct hash* hash_table, void* vaddr) {
+/* TASK 3: Fills the current process's page table, which is empty,
+   with a copy of PARENT's, for fork().  Resident pages end up
+   shared copy-on-write, see share_fork().  Memory mapped files are
+   not inherited.  Returns false if out of memory or an area cannot
+   be added, leaving the areas copied so far for
+   page_table_destroy() */
+bool
+page_table_fork (struct thread *parent) {
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+  bool success = true;
+
+  /* PARENT is blocked in fork(), so its table cannot change */
+  rwlock_acquire_shared (&parent->sup_page_table_lock);
+  for (e = list_begin (&parent->vm_areas);
+       success && e != list_end (&parent->vm_areas); e = list_next (e)) {
+    struct vm_area *parea = list_entry (e, struct vm_area, elem);
+    if (parea->mapid != MAP_FAILED) {
+      continue;
+    }
 
-  /* Initialise page table entry */
-  struct page_table_entry* pte = (struct page_table_entry*)malloc(sizeof(struct page_table_entry));
+    struct vm_area *area = area_create (parea->start, parea->page_cnt);
+    if (area == NULL) {
+      success = false;
+      break;
+    }
 
-  /* Set page's user address to given address */
-  pte->vaddr = vaddr;
+    /* Pages of the executable are read from the child's own copy
+       of it */
+    area->file = parea->file != NULL ? cur->file : NULL;
+    area->offset = parea->offset;
+    area->read_bytes = parea->read_bytes;
+
+    size_t i;
+    for (i = 0; success && i < area->page_cnt; i++) {
+      struct page_table_entry *ppte = &parea->pages[i];
+      struct page_table_entry *pte = &area->pages[i];
+      if (ppte->bit_set == NONE_BIT) {
+        continue;
+      }
+      pte->bit_set = FILE_BIT;
+      pte->writable = ppte->writable;
+      success = share_fork (parent, ppte, pte);
+    }
+
+    /* The parent's areas do not overlap, so this should not fail,
+       but if it does, page_table_destroy() will not see the area,
+       so its pages are given back here */
+    if (!area_insert (cur, area)) {
+      for (i = 0; i < area->page_cnt; i++) {
+        if (area->pages[i].bit_set != NONE_BIT) {
+          page_action_func (cur, &area->pages[i]);
+        }
+      }
+      free (area);
+      success = false;
+    }
+  }
+  rwlock_release_shared (&parent->sup_page_table_lock);
+  return success;
+}
 
-  /* Retrive page with user address in page table */
-  acquire_pagelock();
-  struct hash_elem *h_elem = hash_find(hash_table,  &pte->elem);
-  release_pagelock();
+/* TASK 3: Returns true if the running thread may look at thread T's
+   page table.  Only T itself adds or removes areas, so T may look at
+   its own table at any time, and any other thread must hold T's
+   sup_page_table_lock for as long as it uses what it finds there */
+static bool
+may_look_up (struct thread *t) {
+  return (t == thread_current ()
+          || rwlock_held_by_current_thread (&t->sup_page_table_lock));
+}
 
-  /* If page found with address, then return this page */
-  if(h_elem != NULL) {
-    return hash_entry(h_elem, struct page_table_entry, elem);
+/* TASK 3: Returns the area of thread T's page table that covers
+   user virtual address VADDR, or NULL if there is none.  The areas
+   are few, a handful for the executable and stack and one per
+   memory mapping, so they are kept in a list in order of address,
+   which is walked.  See may_look_up() for who may call this */
+struct vm_area *
+get_vm_area (struct thread *t, void *vaddr) {
+  struct list_elem *e;
+
+  ASSERT (may_look_up (t));
+  for (e = list_begin (&t->vm_areas); e != list_end (&t->vm_areas);
+       e = list_next (e)) {
+    struct vm_area *area = list_entry (e, struct vm_area, elem);
+    if (area_contains (area, vaddr)) {
+      return area;
+    }
+    if (area->start > vaddr) {
+      break;
+    }
   }
+  return NULL;
+}
 
-  /* Otherwise, return NULL */
+/* TASK 3: Returns the area of thread T's page table that maps memory
+   mapping MAPID, or NULL if there is none.  See may_look_up() for
+   who may call this */
+struct vm_area *
+get_mmap_area (struct thread *t, mapid_t mapid) {
+  struct list_elem *e;
+
+  ASSERT (may_look_up (t));
+  for (e = list_begin (&t->vm_areas); e != list_end (&t->vm_areas);
+       e = list_next (e)) {
+    struct vm_area *area = list_entry (e, struct vm_area, elem);
+    if (area->mapid == mapid) {
+      return area;
+    }
+  }
   return NULL;
 }
 
-/* TASK 3: Insert page table entry in hash table */
-bool
-insert_page_table_entry(struct hash* hash_table, struct page_table_entry* pte) {
-  if(pte == NULL) {
-    return false;
+/* TASK 3: Get page table entry from thread T's page table using
+   key: virtual address.  See may_look_up() for who may call this */
+struct page_table_entry*
+get_page_table_entry(struct thread *t, void* vaddr) {
+  struct vm_area *area = get_vm_area (t, vaddr);
+  struct page_table_entry *pte;
+
+  /* Otherwise, return NULL */
+  if (area == NULL) {
+    return NULL;
   }
-  bool res = false;
 
-  /* Insert page in page table */
-  if(hash_insert(hash_table, &pte->elem) == NULL) {
-    res = true;
+  /* A page in an area that nothing has been put in yet is no page */
+  pte = &area->pages[pg_no (vaddr) - pg_no (area->start)];
+  return pte->bit_set != NONE_BIT ? pte : NULL;
+}
+
+/* TASK 3: Removes AREA from thread T's page table and frees it.  Its
+   pages must not be loaded */
+void
+delete_vm_area (struct thread *t, struct vm_area *area) {
+  rwlock_acquire_exclusive (&t->sup_page_table_lock);
+  list_remove (&area->elem);
+  rwlock_release_exclusive (&t->sup_page_table_lock);
+  free (area);
+}
+
+/* TASK 3: Fills in FILE_D with where the page at VADDR, in AREA,
+   comes from in the area's file.  Returns false if the page has no
+   file behind it */
+static bool
+area_file_data (const struct vm_area *area, void *vaddr,
+                struct file_d *file_d) {
+  size_t ofs;
+
+  if (area == NULL || area->file == NULL) {
+    return false;
   }
-  return res;
+  ofs = pg_round_down (vaddr) - area->start;
+  file_d->filename = area->file;
+  file_d->file_offset = area->offset + ofs;
+  file_d->read_bytes = 0;
+  if (ofs < area->read_bytes) {
+    file_d->read_bytes = area->read_bytes - ofs < PGSIZE
+                         ? area->read_bytes - ofs : PGSIZE;
+  }
+  file_d->zero_bytes = PGSIZE - file_d->read_bytes;
+  return true;
 }
 
-/* TASK 3: Loads the frame into physical memory */
+/* TASK 3: Fills in FILE_D with where the page at VADDR of thread T
+   comes from in its area's file.  Returns false if the page has no
+   file behind it */
 bool
-load_page(struct page_table_entry* pte) {
+page_file_data (struct thread *t, void *vaddr, struct file_d *file_d) {
+  return area_file_data (get_vm_area (t, vaddr), vaddr, file_d);
+}
+
+/* TASK 3: Loads the frame into physical memory, for an access that
+   is a write if WRITE is true */
+bool
+load_page(struct page_table_entry* pte, bool write) {
   bool res = false;
   /* Check if page already loaded */
   if(pte->loaded) {
@@ -136,25 +340,79 @@ load_page(struct page_table_entry* pte) {
     case FILE_BIT :
     case MMAP_BIT: res = load_file(pte); break;
     case SWAP_BIT : res =  load_swap(pte); break;
+    case ZERO_BIT : res = load_zero(pte, write); break;
   }
   return res;
 }
 
+/* TASK 3 : Fault-around.
+
+   A program's text is mostly run in order, so a fault on one page
+   of it is a good sign that the pages around it will be wanted
+   soon.  So when a fault maps a read-only page of a file, the other
+   pages of the same area within an aligned window of
+   fault_around_pages pages are mapped too, but only those already
+   resident in the shared page table: fault-around never reads
+   anything, it only saves faults that would have found their pages
+   resident anyway, e.g. because the prefetch worker read them.
+
+   Set with the "-faultaround=N" kernel option; 0 turns it off. */
+size_t fault_around_pages = 16;
+
+static void
+fault_around (struct page_table_entry *pte) {
+  struct vm_area *area = get_vm_area (thread_current (), pte->vaddr);
+  uintptr_t first, last, pg;
+
+  if (fault_around_pages <= 1 || area == NULL) {
+    return;
+  }
+
+  /* The window, clipped to the area */
+  first = pg_no (pte->vaddr) / fault_around_pages * fault_around_pages;
+  last = first + fault_around_pages;
+  if (first < pg_no (area->start)) {
+    first = pg_no (area->start);
+  }
+  if (last > pg_no (area->start) + area->page_cnt) {
+    last = pg_no (area->start) + area->page_cnt;
+  }
+
+  for (pg = first; pg < last; pg++) {
+    struct page_table_entry *next = &area->pages[pg - pg_no (area->start)];
+    struct file_d file_d;
+
+    if (next == pte || next->loaded || next->writable
+        || next->bit_set != FILE_BIT
+        || !area_file_data (area, next->vaddr, &file_d)
+        || file_d.read_bytes == 0) {
+      continue;
+    }
+    share_map_resident (next, &file_d);
+  }
+}
+
 /* TASK 3: Loads frame into physical memory when executable or memory
-          mapped file */
+          mapped file.  Read-only pages of an executable are shared
+          between the processes running it, see vm/share.c */
 bool
 load_file(struct page_table_entry* pte) {
+  struct file_d file_d;
 
-  /* Get data from page table entry */
-  struct file_d* file_d = pte->page_sourcefile;
-  struct file* file = file_d->filename;
-  int offset = file_d->file_offset;
-  void* upage = pte->vaddr;
-  int zero_bytes = file_d->zero_bytes;
-  int read_bytes = file_d->read_bytes;
+  /* Get data from the page's area */
+  if (!page_file_data (thread_current (), pte->vaddr, &file_d)) {
+    return false;
+  }
+  if (pte->bit_set == FILE_BIT && !pte->writable && file_d.read_bytes > 0) {
+    if (!share_load (pte, &file_d)) {
+      return false;
+    }
+    fault_around (pte);
+    return true;
+  }
 
-  /* Seek the file */
-  file_seek(file, offset);
+  void* upage = pte->vaddr;
+  int read_bytes = file_d.read_bytes;
 
   // Allocate user page
   enum palloc_flags flag;
@@ -170,7 +428,8 @@ load_file(struct page_table_entry* pte) {
   }
 
   /* Load page */
-  int bytes_read = file_read(file, frame, read_bytes);
+  int bytes_read = file_read_at(file_d.filename, frame, read_bytes,
+                                file_d.file_offset);
 
   if(bytes_read != read_bytes) {
     /* File not read properly, so free frame and return false */
@@ -178,8 +437,8 @@ load_file(struct page_table_entry* pte) {
     return false;
   }
   /* zero out memory */
-  if (zero_bytes > 0) {
-    memset(frame + read_bytes, 0, zero_bytes);
+  if (file_d.zero_bytes > 0) {
+    memset(frame + read_bytes, 0, file_d.zero_bytes);
   }
 
   /* Add the page to the current process address space - add mapping
@@ -192,178 +451,325 @@ load_file(struct page_table_entry* pte) {
 
   }
   pte->loaded = true;
+  frame_unpin(frame);
+  if (read_bytes > 0) {
+    thread_current ()->stats.major_faults++;
+  }
+
+  return true;
+}
+
+/* TASK 3: Loads a page of zeros, see zero_page above.  A read maps
+   the zero page.  A write, whether the page is not loaded yet or
+   has the zero page mapped, gets a new zeroed frame instead, and
+   the page becomes an ordinary anonymous page */
+bool
+load_zero(struct page_table_entry* pte, bool write) {
+  if (!write || !pte->writable) {
+    if (!install_page (pte->vaddr, zero_page, false)) {
+      return false;
+    }
+    pte->loaded = true;
+    return true;
+  }
 
+  void* frame = frame_alloc(pte->vaddr, PAL_ZERO);
+  if (frame == NULL) {
+    return false;
+  }
+  if (pte->loaded) {
+    pagedir_clear_page (thread_current ()->pagedir, pte->vaddr);
+  }
+  if (!install_page (pte->vaddr, frame, true)) {
+    frame_free(frame);
+    return false;
+  }
+  pte->bit_set = SWAP_BIT;
+  pte->loaded = true;
+  frame_unpin(frame);
   return true;
 }
 
-/* TASK 3: Loads frame into physical memory when swap */
+/* TASK 3: Resolves a write fault on PTE, a writable page that is
+   mapped read-only: either the zero page, or a page shared
+   copy-on-write since a fork().  Returns false if the write cannot
+   be allowed */
+bool
+page_write_fault (struct page_table_entry *pte) {
+  if (pte->bit_set == ZERO_BIT) {
+    return load_zero (pte, true);
+  }
+  return share_cow_break (pte);
+}
+
+/* TASK 3: Brings the page at UPAGE of the current process into
+   memory for the kernel to access on the process's behalf, making
+   it writable too if WRITE, and pins its frame so that it stays
+   there.  Returns the page's kernel address, or NULL if UPAGE is
+   not a page the process may access that way.  The caller must
+   call frame_unpin() on the kernel address when done */
+void *
+page_pin (void *upage, bool write) {
+  struct thread *cur = thread_current ();
+  struct page_table_entry *pte;
+
+  if (!is_user_vaddr (upage)) {
+    return NULL;
+  }
+  pte = get_page_table_entry (cur, upage);
+  if (pte == NULL || (write && !pte->writable)) {
+    return NULL;
+  }
+
+  /* The page may be evicted again, or still be on its way out,
+     before its frame is pinned; if so, try again */
+  for (;;) {
+    struct frame *frame = NULL;
+    void *kpage;
+
+    if (!load_page (pte, write)) {
+      return NULL;
+    }
+    if (write && !pagedir_is_writable (cur->pagedir, upage)
+        && !page_write_fault (pte)) {
+      return NULL;
+    }
+
+    acquire_framelock ();
+    kpage = pagedir_get_page (cur->pagedir, upage);
+    if (kpage != NULL && (!write || pagedir_is_writable (cur->pagedir, upage))) {
+      frame = frame_lookup (kpage);
+    }
+    if (frame != NULL && lock_try_acquire (&frame->single_frame_lock)) {
+      release_framelock ();
+      return kpage;
+    }
+    release_framelock ();
+    thread_yield ();
+  }
+}
+
+/* TASK 3 : Swap read-ahead.
+
+   A process walking through an array bigger than memory faults its
+   pages back in one at a time, in the order they were evicted.
+   Since swap_get_free() gives pages evicted together consecutive
+   slots, a fault on one of them is a good hint that the pages
+   after it will be wanted next, and that reading them now costs
+   no seek.  So a swap-in fault brings in up to swap_readahead of
+   the following virtual pages as well, as long as each sits in the
+   slot right after the previous one, all with one disk request,
+   see swap_load_run().
+
+   Read-ahead stops early rather than evict anything for pages
+   that may never be used: once free user frames drop to the
+   page-out daemon's low watermark, it gives up.  The pages it
+   brings in are mapped with their accessed bits clear, so unused
+   ones are the clock's first victims.
+
+   Set with the "-readahead=N" kernel option; 0 turns it off. */
+size_t swap_readahead = 8;
+
+static bool swap_map (struct page_table_entry *pte, void *frame);
+static size_t swap_read_ahead (struct page_table_entry *pte,
+                               struct page_table_entry *run[],
+                               void *frames[]);
+
+/* TASK 3: Loads frame into physical memory when swap.  The pages
+   read ahead come in with the same disk request */
 bool
 load_swap(struct page_table_entry* pte) {
+  struct thread *cur = thread_current ();
+  struct page_table_entry *run[SWAP_RUN_PAGES];
+  void *frames[SWAP_RUN_PAGES];
+  size_t cnt, i;
+  bool success;
+
   if(!(pte->bit_set == SWAP_BIT || pte->bit_set == FILE_BIT)) {
     return false;
   }
 
-  /* Allocate user page */
-  void* upage = pte->vaddr;
-  void* frame = frame_alloc(upage, PAL_USER);
-  if (frame == NULL) {
+  /* Allocate user pages, pinned until they are mapped: the faulting
+     page's, then those of the pages to read ahead */
+  run[0] = pte;
+  frames[0] = frame_alloc (pte->vaddr, PAL_USER);
+  if (frames[0] == NULL) {
     return false;
   }
-  /* Add the page to the current process address space - add mapping
-    from vaddr to frame */
-  bool set_page = install_page(pte->vaddr, frame, pte->writable);
+  cnt = 1 + swap_read_ahead (pte, run + 1, frames + 1);
+
+  /* Swap from disk -> memory, before the pages are mapped so that
+     the process never sees one half read.  This releases the
+     slots */
+  swap_load_run (pte->swap_index, frames, cnt);
+  cur->stats.major_faults++;
+  cur->stats.swap_ins += cnt;
+
+  success = swap_map (pte, frames[0]);
+  for (i = 1; i < cnt; i++) {
+    swap_map (run[i], frames[i]);
+  }
+  return success;
+}
 
-  /* Get frame at address specified */
-  struct frame *f = frame_get(frame);
+/* TASK 3: Maps FRAME, into which PTE's page was just read back from
+   swap, and unpins it.  The page stays a swap page: its contents no
+   longer match any file */
+static bool
+swap_map (struct page_table_entry *pte, void *frame) {
+  /* The read went through the frame's kernel alias.  Don't let that
+     count as a use, or pages read ahead would never look idle to
+     the clock; the faulting page is about to be touched anyway */
+  pagedir_set_accessed (init_page_dir, frame, false);
 
-  if(!set_page) {
+  /* Add the page to the current process address space - add mapping
+    from vaddr to frame */
+  if(!install_page(pte->vaddr, frame, pte->writable)) {
     /* Page not set properly, so free frame and return false */
     frame_free(frame);
     return false;
   }
 
-  f->writable = true;
-
-  /* Swap from disk -> memory */
-  struct swap_slot* ss = (struct swap_slot*)malloc(sizeof(struct swap_slot));
-  ss->swap_addr = pte->swap_index;
-  swap_load(pte->vaddr, ss);
-  memset (f + pte->page_sourcefile->read_bytes, 0, pte->page_sourcefile->zero_bytes); // Set 0 bits at end of file if required
-  f->writable = false;
-
   /* Update page */
-  pte->phys_addr = frame;
-  pte->bit_set = FILE_BIT;
   pte->loaded = true;
+  frame_unpin(frame);
 
   return true;
 }
 
+/* TASK 3: Finds the pages following PTE that were swapped out to the
+   slots following its own, and allocates a pinned frame for each,
+   storing their entries in RUN and the frames in FRAMES.  Returns
+   how many it found.  See swap_readahead above. */
+static size_t
+swap_read_ahead (struct page_table_entry *pte,
+                 struct page_table_entry *run[], void *frames[]) {
+  struct thread *cur = thread_current ();
+  size_t i;
+
+  for (i = 0; i < swap_readahead && i + 1 < SWAP_RUN_PAGES; i++) {
+    void *upage = pte->vaddr + (i + 1) * PGSIZE;
+    if (!is_user_vaddr (upage)
+        || palloc_user_free_pages () <= pageout_low) {
+      break;
+    }
+
+    /* Only this thread loads its own pages, so a page that is not
+       loaded now stays that way until load_swap() is done with it */
+    struct page_table_entry *next = get_page_table_entry (cur, upage);
+    if (next == NULL || next->loaded || next->bit_set != SWAP_BIT
+        || next->swap_index != pte->swap_index
+                               + (int) ((i + 1) * SWAP_SLOT_SECTORS)) {
+      break;
+    }
+    frames[i] = frame_alloc (upage, PAL_USER);
+    if (frames[i] == NULL) {
+      break;
+    }
+    run[i] = next;
+  }
+  return i;
+}
+
 
-/* TASK 3 : Inserts page in page table */
+/* TASK 3 : Adds an area to the current process's page table for the
+   READ_BYTES + ZERO_BYTES bytes of memory from UPAGE, the first
+   READ_BYTES of them coming from FILE from OFFSET.  Pages with
+   nothing to read are pages of zeros, except in a memory mapped
+   file.  Fails if the area overlaps one already there */
 bool
 insert_file(struct file* file, off_t offset, uint8_t *upage,
                              uint32_t read_bytes, uint32_t zero_bytes,
                              bool writable, int bit_set) {
   struct thread* curr = thread_current();
-  struct page_table_entry* pte = (struct page_table_entry*)malloc(sizeof(struct page_table_entry));
+  size_t page_cnt = (read_bytes + zero_bytes) / PGSIZE;
+  struct vm_area *area;
+  size_t i;
+
+  ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
+  ASSERT (pg_ofs (upage) == 0);
 
-  /* Check that page table entry has initialised properly */
-  if(pte == NULL) {
+  if (page_cnt == 0 || !is_user_vaddr (upage + page_cnt * PGSIZE - 1)) {
+    return false;
+  }
+  area = area_create (upage, page_cnt);
+  if (area == NULL) {
     return false;
   }
 
-  /* Build up page table entry */
-  pte->bit_set = bit_set;
-  pte->vaddr = upage;
-
-  /* Build up page table entry's file data */
-  struct file_d* file_d = (struct file_d*)malloc(sizeof(struct file_d));
-  file_d->filename = file;
-  file_d->file_offset = offset;
-  file_d->read_bytes = read_bytes;
-  file_d->zero_bytes = zero_bytes;
+  /* Build up the area's file data, once for all of its pages */
+  area->file = file;
+  area->offset = offset;
+  area->read_bytes = read_bytes;
 
-  pte->page_sourcefile = file_d;
-  pte->loaded = false;
-  pte->writable = writable;
+  /* Memory mapped files are always writable */
+  if (bit_set == MMAP_BIT) {
+    writable = true;
+    area->mapid = curr->mapid;
+  }
 
-  /* Check for memory mapped files */
-  if(bit_set == MMAP_BIT) {
-    pte->writable = true;
-    pte->mapid = curr->mapid;
-    if (!check_mmap(pte)) {
-      free(pte);
-      return false;
+  for (i = 0; i < page_cnt; i++) {
+    struct page_table_entry *pte = &area->pages[i];
+    pte->bit_set = bit_set;
+    if (bit_set == FILE_BIT && i * PGSIZE >= read_bytes) {
+      pte->bit_set = ZERO_BIT;
     }
+    pte->writable = writable;
   }
 
-  bool success = false;
-  /* Check if kernel pages currently mapeed to upage */
-  if(pagedir_get_page(curr->pagedir, upage) == NULL) {
-    success = insert_page_table_entry(&curr->sup_page_table, pte);
+  if (!area_insert (curr, area)) {
+    free (area);
+    return false;
   }
-  return success;
+  return true;
 }
 
 
-/* TASK 3: Function for stack growth */
+/* TASK 3: Function for stack growth.  The new page is a page of
+   zeros, which only gets a frame when it is written, by the access
+   that faulted if WRITE is true.
+
+   Rather than an area for each page, the stack grows by areas of
+   STACK_AREA_PAGES pages, aligned to their size, whose pages stay
+   NONE_BIT pages until the stack reaches them.  Only where such an
+   area would overlap another does the stack grow by a single page */
 bool
-grow_stack(void* vaddr) {
+grow_stack(void* vaddr, bool write) {
+  struct thread *cur = thread_current ();
+  void *upage = pg_round_down (vaddr);
+  struct vm_area *area;
 
   /* Check that address is valid */
-  if((size_t)(PHYS_BASE - pg_round_down(vaddr) > MAXI_STACK_SIZE)) {
+  if((size_t)(PHYS_BASE - upage) > MAXI_STACK_SIZE) {
     return false;
   }
 
-  /* Initialise page table entry */
-  struct page_table_entry *pte = malloc(sizeof(struct page_table_entry));
-
-  if (pte == NULL) {
-    return false;
-  }
-    void* round_vaddr = pg_round_down(vaddr);
-
-    /* Build up page table entry at vaddr */
-    pte->vaddr = round_vaddr;
-    pte->loaded = true;
-    pte->writable = true;
-    pte->bit_set = SWAP_BIT;
-
-    /* Get a frame using frame allocate */
-    uint8_t *frame = frame_alloc(round_vaddr, PAL_USER);
-
-    /* If frame is NULL, then free page */
-    if(frame == NULL) {
-      free_pte(pte);
-      return false;
+  /* Find the area the page is in, or add one */
+  area = get_vm_area (cur, upage);
+  if (area == NULL) {
+    void *start = (void *) ((uintptr_t) upage
+                            & ~(uintptr_t) (STACK_AREA_PAGES * PGSIZE - 1));
+    area = area_create (start, STACK_AREA_PAGES);
+    if (area != NULL && !area_insert (cur, area)) {
+      free (area);
+      area = area_create (upage, 1);
+      if (area != NULL && !area_insert (cur, area)) {
+        free (area);
+        area = NULL;
+      }
     }
-
-    /* Check that frame is accessed */
-    bool set_page = install_page(pte->vaddr, frame, pte->writable);
-
-    /* If frame not accessed, then free page table entry */
-    if(!set_page) {
-      free(pte);
-      frame_free(frame);
+    if (area == NULL) {
       return false;
     }
+  }
 
-    /* Add the page to the current thread's page table */
-    if(hash_insert(&thread_current()->sup_page_table, &pte->elem) == NULL) {
-      return true;
-    }
-
+  /* Build up page table entry at vaddr */
+  struct page_table_entry *pte
+    = &area->pages[pg_no (upage) - pg_no (area->start)];
+  if (pte->bit_set != NONE_BIT) {
     return false;
-}
-
-/* TASK 3: Adds a new vm_mmap_struct to thread_current()'s mapped files */
-bool
-check_mmap(struct page_table_entry *pte) {
-	struct thread *cur = thread_current();
-	struct list *mmaps = &cur->mmapped_files;
-
-	struct vm_mmap *mmap = malloc(sizeof(struct vm_mmap));
-
-	if (!mmap) {
-	  return false;
-	}
-
-  /* Build up mmap struct */
-	mmap->mapid = cur->mapid;
-	mmap->pte = pte;
-
-	list_push_back (mmaps, &mmap->list_elem);
-
-	return true;
-}
-
-/* TASK 3: Freeing supplementary page table entry */
-void
-free_pte(struct page_table_entry* pte) {
-  free(pte->vaddr);
-  free(pte->phys_addr);
-  if (pte->page_sourcefile) {
-    free(pte->page_sourcefile);
   }
+  pte->writable = true;
+  pte->bit_set = ZERO_BIT;
+  return load_zero(pte, write);
 }
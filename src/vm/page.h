@@ -3,7 +3,7 @@
 
 #include <debug.h>
 #include <stdint.h>
-#include <hash.h>
+#include <list.h>
 #include <stdbool.h>
 #include "filesys/file.h"
 #include "filesys/off_t.h"
@@ -14,44 +14,82 @@
 #define SWAP_BIT 0	  	               /*bit referring to page in the swap partition*/
 #define FILE_BIT 1 	 	                 /*bit referring to page referring to a file*/
 #define MMAP_BIT 2  	                 /*bit referring to page representing a memory map file*/
+#define ZERO_BIT 3                       /*bit referring to page of zeros, not yet written*/
+#define NONE_BIT 4                       /*bit referring to no page, in an area's gap*/
 
 #define MAXI_STACK_SIZE (1 << 26)
 
-struct page_table_entry {
+/* Pages in each area that the stack grows by */
+#define STACK_AREA_PAGES 32
 
-  int bit_set;                         /* Used to store the page's current status. */
-  int swap_index;                      /* Index used for swapping */
-  mapid_t mapid;                       /* Unique id for memory mapped file */
-  void* phys_addr;                     /* page's physical memory address */
+struct share_page;
+
+/* TASK 3 : Most pages to read ahead on a swap-in fault */
+extern size_t swap_readahead;
+
+/* TASK 3 : Size of the window of resident file pages mapped around
+   a fault */
+extern size_t fault_around_pages;
+
+/* TASK 3 : State of one page of a process.  What it shares with
+   the pages around it lives in its vm_area instead */
+struct page_table_entry {
   void *vaddr;                         /* page's user virtual memory address */
-  struct file_d *page_sourcefile;      /* info stored if page table is memory mapped
-                                          file */
+  struct share_page *shared;           /* Shared copy of the page, or NULL */
+  int swap_index;                      /* Index used for swapping */
+  uint8_t bit_set;                     /* Used to store the page's current status. */
   bool writable;                       /* boolean checking whether the page
                                           table is writable */
   bool loaded;                         /* boolean checking whether the page
                                           table is loadable */
-  struct hash_elem elem;               /* Used to store the pte in the page table. */
 };
 
-/* TASK 3: Struct for virtual memory's mapped info. */
-struct vm_mmap
+/* TASK 3 : A virtual memory area: a run of pages set up together,
+   from a segment of the executable, by mmap(), or as a piece of
+   stack.  The file the pages come from and where they start in it
+   are stored once, here, and each page only has a small entry in
+   pages[], so that the supplementary page table costs a few words
+   per page and looking a page up allocates nothing. */
+struct vm_area
   {
-    mapid_t mapid;                 /* Unique memory mapped identification */
-    struct page_table_entry *pte; /* Pointer to the executing sup page table */
-    struct list_elem list_elem;   /* Used to store the memory map files  */
+    void *start;                   /* First page of the area */
+    size_t page_cnt;               /* Pages in the area */
+    struct file *file;             /* File the pages come from, or NULL */
+    off_t offset;                  /* Offset in FILE of the first page */
+    size_t read_bytes;             /* Bytes of FILE in the area, the rest
+                                      being zeros */
+    mapid_t mapid;                 /* Unique memory mapped identification,
+                                      or MAP_FAILED if not mapped */
+    struct list_elem elem;         /* Element of the owner's vm_areas */
+    struct page_table_entry pages[]; /* State of each page */
   };
 
-void page_table_init(struct hash* page_table_hash);
-void page_table_destroy (struct hash *hash);
-struct page_table_entry* get_page_table_entry(struct hash* hash_table, void* vaddr);
-bool insert_page_table_entry(struct hash* hash_table, struct page_table_entry* pte);
-bool load_page(struct page_table_entry* pte);
+/* TASK 3 : Where a page of a file comes from */
+struct file_d
+{
+  struct file *filename;               /* File associated with frame */
+  int file_offset;                     /* Offset of the file */
+  size_t read_bytes;                   /* Bytes to read in file */
+  size_t zero_bytes;                   /* Bytes to set to sero in file */
+};
+
+void page_init (void);
+void page_table_init(struct thread *t);
+void page_table_destroy (struct thread *t);
+bool page_table_fork (struct thread *parent);
+struct page_table_entry* get_page_table_entry(struct thread *t, void* vaddr);
+struct vm_area *get_vm_area (struct thread *t, void *vaddr);
+struct vm_area *get_mmap_area (struct thread *t, mapid_t mapid);
+void delete_vm_area (struct thread *t, struct vm_area *area);
+bool page_file_data (struct thread *t, void *vaddr, struct file_d *file_d);
+bool load_page(struct page_table_entry* pte, bool write);
 bool load_file(struct page_table_entry* pte);
 bool load_swap(struct page_table_entry* pte);
+bool load_zero(struct page_table_entry* pte, bool write);
+bool page_write_fault (struct page_table_entry *pte);
+void *page_pin (void *upage, bool write);
 bool insert_file(struct file* file, off_t offset, uint8_t *upage, uint32_t read_bytes, uint32_t zero_bytes, bool writable, int bit_set);
-bool grow_stack(void* vaddr);
-bool check_mmap(struct page_table_entry *pte);
-void free_pte(struct page_table_entry* pte);
+bool grow_stack(void* vaddr, bool write);
 
 
 #endif /* vm/frame.h */
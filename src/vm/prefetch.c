@@ -0,0 +1,203 @@
+#include "vm/prefetch.h"
+#include <debug.h>
+#include <list.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/share.h"
+
+/* TASK 3 : Exec-time prefetch.
+
+   A program that has just been loaded has nothing resident, so it
+   takes a fault, and waits for a disk read, for every page of text
+   it runs.  Instead, once load() has set up the page table, it
+   queues a job for the prefetch worker, a kernel thread, which reads
+   the page holding the entry point and then the first
+   prefetch_pages pages of each read-only segment into the shared
+   page table, see vm/share.c.  The new process carries on
+   meanwhile, and its parent's exec() returns as soon as the load is
+   done; the process's faults then find most pages resident and only
+   have to map them, several at a time, see fault-around in
+   vm/page.c.
+
+   Only read-only pages are read: they are the ones kept in the
+   shared page table, which the worker can fill in without mapping
+   anything into the process.  Like swap read-ahead, the worker
+   stops rather than evict anything once free user frames drop to
+   the page-out daemon's low watermark.
+
+   The worker reads a process's page table and files, so a process
+   that exits cancels its job first, waiting for the worker if it
+   is already at it.
+
+   Set with the "-prefetch=N" kernel option; 0 turns it off. */
+size_t prefetch_pages = 16;
+
+/* Most read-only areas of a process that are prefetched */
+#define PREFETCH_MAX_AREAS 8
+
+/* A process to prefetch pages for */
+struct prefetch_job
+  {
+    struct thread *thread;      /* Process whose pages to read */
+    void *entry;                /* Its entry point */
+    bool cancelled;             /* Process exiting?  Then stop */
+    struct list_elem elem;      /* Element of prefetch_jobs */
+  };
+
+static struct lock prefetch_lock;       /* Protects everything below */
+static struct condition prefetch_queued; /* A job has been queued */
+static struct condition prefetch_done;  /* The worker finished a job */
+static struct list prefetch_jobs;       /* Jobs not started yet */
+static struct prefetch_job *prefetch_current; /* Job the worker is on */
+
+static thread_func prefetch_worker NO_RETURN;
+
+/* TASK 3 : Initializes the job queue and starts the worker */
+void
+prefetch_init (void)
+{
+  lock_init_named (&prefetch_lock, "prefetch_lock");
+  cond_init (&prefetch_queued);
+  cond_init (&prefetch_done);
+  list_init (&prefetch_jobs);
+  if (prefetch_pages > 0)
+    thread_create ("prefetch", PRI_DEFAULT, prefetch_worker, NULL);
+}
+
+/* TASK 3 : Queues the current process, which has just been loaded
+   and starts at ENTRY, for prefetching.  Prefetching is only a
+   hint, so nothing is queued if out of memory */
+void
+prefetch_exec (void *entry)
+{
+  struct prefetch_job *job;
+
+  if (prefetch_pages == 0)
+    return;
+  job = malloc (sizeof *job);
+  if (job == NULL)
+    return;
+  job->thread = thread_current ();
+  job->entry = entry;
+  job->cancelled = false;
+
+  lock_acquire (&prefetch_lock);
+  list_push_back (&prefetch_jobs, &job->elem);
+  cond_signal (&prefetch_queued, &prefetch_lock);
+  lock_release (&prefetch_lock);
+}
+
+/* TASK 3 : Cancels prefetching for process T, which is exiting.  On
+   return the worker no longer uses T's page table or files */
+void
+prefetch_cancel (struct thread *t)
+{
+  struct list_elem *e;
+
+  lock_acquire (&prefetch_lock);
+  for (e = list_begin (&prefetch_jobs); e != list_end (&prefetch_jobs); )
+    {
+      struct prefetch_job *job = list_entry (e, struct prefetch_job, elem);
+      e = list_next (e);
+      if (job->thread == t)
+        {
+          list_remove (&job->elem);
+          free (job);
+        }
+    }
+  while (prefetch_current != NULL && prefetch_current->thread == t)
+    {
+      prefetch_current->cancelled = true;
+      cond_wait (&prefetch_done, &prefetch_lock);
+    }
+  lock_release (&prefetch_lock);
+}
+
+/* TASK 3 : Reads the page at UPAGE of process T into the shared page
+   table, if it is a read-only page of a file that is not mapped yet.
+   Returns false if the worker should stop.  T's page table is held
+   shared while its entry is used */
+static bool
+prefetch_page (struct thread *t, void *upage)
+{
+  struct page_table_entry *pte;
+  struct file_d file_d;
+  bool go_on = true;
+
+  if (palloc_user_free_pages () <= pageout_low)
+    return false;
+  rwlock_acquire_shared (&t->sup_page_table_lock);
+  pte = get_page_table_entry (t, upage);
+  if (pte != NULL && !pte->writable && pte->bit_set == FILE_BIT
+      && !pte->loaded && page_file_data (t, upage, &file_d)
+      && file_d.read_bytes > 0)
+    go_on = share_prefetch (pte, &file_d);
+  rwlock_release_shared (&t->sup_page_table_lock);
+  return go_on;
+}
+
+/* TASK 3 : Reads the pages that JOB's process will want first */
+static void
+prefetch_run (struct prefetch_job *job)
+{
+  struct thread *t = job->thread;
+  struct vm_area *areas[PREFETCH_MAX_AREAS];
+  size_t area_cnt = 0;
+  struct list_elem *e;
+  size_t i, j;
+
+  /* The entry point's page first, since it is faulted on first */
+  if (!prefetch_page (t, pg_round_down (job->entry)))
+    return;
+
+  /* Then the start of each segment.  The areas of the executable
+     stay until T exits, but the list they are on may change as T
+     maps files, so it is only looked at under the lock */
+  rwlock_acquire_shared (&t->sup_page_table_lock);
+  for (e = list_begin (&t->vm_areas);
+       e != list_end (&t->vm_areas) && area_cnt < PREFETCH_MAX_AREAS;
+       e = list_next (e))
+    {
+      struct vm_area *area = list_entry (e, struct vm_area, elem);
+      if (area->file != NULL && area->mapid == MAP_FAILED)
+        areas[area_cnt++] = area;
+    }
+  rwlock_release_shared (&t->sup_page_table_lock);
+
+  for (i = 0; i < area_cnt; i++)
+    for (j = 0; j < areas[i]->page_cnt && j < prefetch_pages; j++)
+      if (job->cancelled
+          || !prefetch_page (t, areas[i]->start + j * PGSIZE))
+        return;
+}
+
+/* TASK 3 : Body of the prefetch worker */
+static void
+prefetch_worker (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct prefetch_job *job;
+
+      lock_acquire (&prefetch_lock);
+      while (list_empty (&prefetch_jobs))
+        cond_wait (&prefetch_queued, &prefetch_lock);
+      job = list_entry (list_pop_front (&prefetch_jobs),
+                        struct prefetch_job, elem);
+      prefetch_current = job;
+      lock_release (&prefetch_lock);
+
+      prefetch_run (job);
+
+      lock_acquire (&prefetch_lock);
+      prefetch_current = NULL;
+      cond_broadcast (&prefetch_done, &prefetch_lock);
+      lock_release (&prefetch_lock);
+      free (job);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef _VM_PREFETCH_H
+#define _VM_PREFETCH_H
+
+#include <stddef.h>
+
+struct thread;
+
+/* TASK 3 : Pages of each read-only segment to read at exec time, 0
+   to disable prefetching */
+extern size_t prefetch_pages;
+
+void prefetch_init (void);
+void prefetch_exec (void *entry);
+void prefetch_cancel (struct thread *t);
+
+#endif /* vm/prefetch.h */
@@ -0,0 +1,707 @@
+#include "vm/share.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* TASK 3 : Shared read-only file pages.
+
+   Every process running the same program maps the same text and
+   read-only data, so there is no need for each one to read its own
+   copy.  Read-only FILE_BIT pages are instead looked up in a table
+   of shared pages keyed by (inode, offset).  The first process to
+   fault on a page reads it into a frame as usual; any other
+   process faulting on it while it is resident just maps the same
+   frame into its own page directory.
+
+   A shared page counts the supplementary page table entries that
+   refer to it, and lists those that have it mapped.  It holds the
+   inode open and denies writes to it for as long as it exists, so
+   that the cached contents stay those of the file.  When the
+   clock picks a shared frame, share_evict() unmaps it from every
+   process at once; it is never dirty, so it is simply dropped and
+   read again on the next fault.  When the last entry referring to
+   a shared page goes away, at process exit, the page and its frame
+   are freed.
+
+   Shared pages also implement copy-on-write for fork().  Every
+   resident page of the forking process becomes an anonymous
+   shared page, which is in no table and has no file behind it: it
+   is mapped read-only in both processes, and the first process to
+   write to it gets a copy of its own, from share_cow_break().  The
+   last process left sharing it just takes its frame over.  The
+   clock writes an anonymous shared page to swap once, and leaves
+   every process that had it mapped with a reference to the same
+   swap slot.
+
+   Only one thread reads a given page in at a time: one that finds
+   another already reading it waits for it, on share_read_done,
+   rather than read a second copy.  That thread may be the prefetch
+   worker, reading pages of a program that has just been loaded
+   ahead of its faults, see vm/prefetch.c.
+
+   share_lock protects the table and every shared page.  It is
+   taken after the frame lock, so it must not be held while calling
+   into the frame table. */
+struct share_page
+  {
+    bool anon;                  /* Copy-on-write page, with no file? */
+    struct inode *inode;        /* File the page comes from */
+    off_t offset;               /* Offset of the page in the file */
+    void *kpage;                /* Frame holding the page, or NULL */
+    bool reading;               /* Being read into a frame? */
+    int ref_cnt;                /* Page table entries referring to it */
+    struct list mappers;        /* Entries with it mapped */
+    struct hash_elem elem;      /* Element of share_table */
+  };
+
+/* TASK 3 : An entry that has a shared page mapped, and the process
+   it belongs to.  Kept out of the entry itself, since most pages
+   are never shared */
+struct share_mapper
+  {
+    struct page_table_entry *pte;   /* Entry with the page mapped */
+    struct thread *owner;           /* Process PTE belongs to */
+    struct list_elem elem;          /* Element of share_page's mappers */
+  };
+
+static struct lock share_lock;
+static struct condition share_read_done;  /* Some page has been read */
+static struct hash share_table;
+
+/* TASK 3 : Caches the shared pages and their mappers come from.  A
+   shared page is freed with no mappers left, so its list of them
+   is initialized once, by share_page_ctor() */
+static struct kmem_cache *share_page_cache;
+static struct kmem_cache *share_mapper_cache;
+
+/* Statistics */
+static unsigned share_maps;     /* Shared pages mapped */
+static unsigned share_hits;     /* ...that were already resident */
+static unsigned share_around;   /* ...by fault-around */
+static unsigned share_prefetches; /* Pages read by the prefetch worker */
+static unsigned cow_maps;       /* Pages mapped copy-on-write by fork */
+static unsigned cow_copies;     /* Writes that copied the page */
+static unsigned cow_reuses;     /* Writes that took the frame over */
+
+/* TASK 3 : Returns a hash value for a shared page, from its key */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct share_page *sp = hash_entry (e, struct share_page, elem);
+  return hash_bytes (&sp->inode, sizeof sp->inode) ^ hash_int (sp->offset);
+}
+
+/* TASK 3 : Returns true if shared page 'a' orders before 'b' */
+static bool
+share_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  const struct share_page *sa = hash_entry (a, struct share_page, elem);
+  const struct share_page *sb = hash_entry (b, struct share_page, elem);
+  if (sa->inode != sb->inode)
+    return sa->inode < sb->inode;
+  return sa->offset < sb->offset;
+}
+
+/* TASK 3 : Constructs shared page SP, as it is in its cache */
+static void
+share_page_ctor (void *sp_)
+{
+  struct share_page *sp = sp_;
+  list_init (&sp->mappers);
+}
+
+/* TASK 3 : Initializes the shared page table */
+void
+share_init (void)
+{
+  hash_init (&share_table, share_hash, share_less, NULL);
+  lock_init_named (&share_lock, "share_lock");
+  cond_init (&share_read_done);
+  share_page_cache = kmem_cache_create ("share_page",
+                                        sizeof (struct share_page),
+                                        share_page_ctor);
+  share_mapper_cache = kmem_cache_create ("share_mapper",
+                                          sizeof (struct share_mapper),
+                                          NULL);
+}
+
+/* TASK 3 : Returns the shared page for the file page described by
+   FILE_D, or NULL if there is none.  share_lock must be held */
+static struct share_page *
+share_find (const struct file_d *file_d)
+{
+  struct share_page key;
+  struct hash_elem *e;
+
+  key.inode = file_get_inode (file_d->filename);
+  key.offset = file_d->file_offset;
+  e = hash_find (&share_table, &key.elem);
+  return e != NULL ? hash_entry (e, struct share_page, elem) : NULL;
+}
+
+/* TASK 3 : Returns the shared page for the file page described by
+   FILE_D, creating it if there is none yet, and takes a reference
+   to it.  Returns NULL if out of memory.  share_lock must be held */
+static struct share_page *
+share_get (const struct file_d *file_d)
+{
+  struct share_page *sp = share_find (file_d);
+
+  if (sp == NULL)
+    {
+      sp = kmem_cache_alloc (share_page_cache);
+      if (sp == NULL)
+        return NULL;
+      sp->anon = false;
+      sp->inode = inode_reopen (file_get_inode (file_d->filename));
+      sp->offset = file_d->file_offset;
+      sp->kpage = NULL;
+      sp->reading = false;
+      sp->ref_cnt = 0;
+      inode_deny_write (sp->inode);
+      hash_insert (&share_table, &sp->elem);
+    }
+  sp->ref_cnt++;
+  return sp;
+}
+
+/* TASK 3 : Records that PTE, of process OWNER, has shared page SP
+   mapped.  Returns false if out of memory.  share_lock must be
+   held */
+static bool
+share_add_mapper (struct share_page *sp, struct page_table_entry *pte,
+                  struct thread *owner)
+{
+  struct share_mapper *m = kmem_cache_alloc (share_mapper_cache);
+  if (m == NULL)
+    return false;
+  m->pte = pte;
+  m->owner = owner;
+  list_push_back (&sp->mappers, &m->elem);
+  return true;
+}
+
+/* TASK 3 : Forgets that PTE has shared page SP mapped, returning the
+   process it belongs to.  share_lock must be held */
+static struct thread *
+share_remove_mapper (struct share_page *sp, struct page_table_entry *pte)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&sp->mappers); e != list_end (&sp->mappers);
+       e = list_next (e))
+    {
+      struct share_mapper *m = list_entry (e, struct share_mapper, elem);
+      if (m->pte == pte)
+        {
+          struct thread *owner = m->owner;
+          list_remove (e);
+          kmem_cache_free (share_mapper_cache, m);
+          return owner;
+        }
+    }
+  NOT_REACHED ();
+}
+
+/* TASK 3 : Maps shared page SP, which must be resident, at PTE's
+   address in the current process.  share_lock must be held */
+static bool
+share_map (struct share_page *sp, struct page_table_entry *pte)
+{
+  if (!share_add_mapper (sp, pte, thread_current ()))
+    return false;
+  if (!install_page (pte->vaddr, sp->kpage, false))
+    {
+      share_remove_mapper (sp, pte);
+      return false;
+    }
+  pte->loaded = true;
+  share_maps++;
+  return true;
+}
+
+/* TASK 3 : Makes shared page SP, of the file page described by
+   FILE_D, resident, unless it already is.  If nobody is reading it
+   in, reads it into a new frame for UPAGE, releasing share_lock
+   meanwhile, since allocating a frame may have to evict one; if
+   somebody is, waits for them.  On return *KPAGEP is the frame if
+   this call read the page, which is then still pinned for the
+   caller to unpin once it has released share_lock, or NULL.
+   Returns false if out of memory or the file could not be read.
+   share_lock must be held */
+static bool
+share_fill (struct share_page *sp, void *upage, const struct file_d *file_d,
+            void **kpagep)
+{
+  void *kpage;
+
+  *kpagep = NULL;
+  while (sp->reading)
+    cond_wait (&share_read_done, &share_lock);
+  if (sp->kpage != NULL)
+    return true;
+
+  sp->reading = true;
+  lock_release (&share_lock);
+  kpage = frame_alloc (upage, PAL_USER);
+  if (kpage != NULL
+      && file_read_at (file_d->filename, kpage, file_d->read_bytes,
+                       file_d->file_offset) != (off_t) file_d->read_bytes)
+    {
+      frame_free (kpage);
+      kpage = NULL;
+    }
+  if (kpage != NULL)
+    {
+      memset (kpage + file_d->read_bytes, 0, file_d->zero_bytes);
+      frame_set_shared (kpage, sp);
+    }
+  lock_acquire (&share_lock);
+
+  sp->kpage = kpage;
+  sp->reading = false;
+  cond_broadcast (&share_read_done, &share_lock);
+  *kpagep = kpage;
+  return kpage != NULL;
+}
+
+/* TASK 3 : Loads PTE, a read-only page of the file page described
+   by FILE_D, by mapping the shared copy of it if one is resident,
+   and otherwise by reading it into a new frame that later faults
+   can share */
+bool
+share_load (struct page_table_entry *pte, const struct file_d *file_d)
+{
+  struct share_page *sp;
+  void *kpage = NULL;
+  bool success;
+
+  lock_acquire (&share_lock);
+  if (pte->shared == NULL)
+    pte->shared = share_get (file_d);
+  sp = pte->shared;
+  success = sp != NULL && share_fill (sp, pte->vaddr, file_d, &kpage);
+  if (success && kpage == NULL)
+    share_hits++;
+  success = success && share_map (sp, pte);
+  lock_release (&share_lock);
+
+  if (kpage != NULL)
+    {
+      frame_unpin (kpage);
+      thread_current ()->stats.major_faults++;
+    }
+  return success;
+}
+
+/* TASK 3 : Maps PTE, a read-only page of the file page described by
+   FILE_D, only if a shared copy of it is resident, reading nothing.
+   Returns true if it did.  Used for fault-around */
+bool
+share_map_resident (struct page_table_entry *pte,
+                    const struct file_d *file_d)
+{
+  struct share_page *sp;
+  bool success = false;
+
+  lock_acquire (&share_lock);
+  sp = pte->shared != NULL ? pte->shared : share_find (file_d);
+  if (sp != NULL && sp->kpage != NULL)
+    {
+      if (pte->shared == NULL)
+        {
+          sp->ref_cnt++;
+          pte->shared = sp;
+        }
+      success = share_map (sp, pte);
+      if (success)
+        share_around++;
+    }
+  lock_release (&share_lock);
+  return success;
+}
+
+/* TASK 3 : Reads PTE's read-only file page, described by FILE_D,
+   into a shared frame, without mapping it, so that the fault that
+   will map it finds it resident.  PTE may belong to a process other
+   than the running one, which must not exit meanwhile.  Returns
+   false if out of memory */
+bool
+share_prefetch (struct page_table_entry *pte, const struct file_d *file_d)
+{
+  struct share_page *sp;
+  void *kpage = NULL;
+  bool success;
+
+  lock_acquire (&share_lock);
+  if (pte->shared == NULL)
+    pte->shared = share_get (file_d);
+  sp = pte->shared;
+  success = sp != NULL && share_fill (sp, pte->vaddr, file_d, &kpage);
+  if (kpage != NULL)
+    share_prefetches++;
+  lock_release (&share_lock);
+
+  if (kpage != NULL)
+    frame_unpin (kpage);
+  return success;
+}
+
+/* TASK 3 : Drops PTE's reference to its shared page, unmapping the
+   page from PTE's process first if it is mapped there.  Frees the
+   page, and its frame, if that was the last reference.  Returns
+   false if PTE has no shared page, which may be because the clock
+   has just moved it to swap */
+bool
+share_release (struct page_table_entry *pte)
+{
+  struct share_page *sp;
+  void *kpage = NULL;
+
+  /* Only the clock takes a shared page away from an entry of
+     another process, and it clears pte->shared last */
+  if (pte->shared == NULL)
+    return false;
+
+  lock_acquire (&share_lock);
+  sp = pte->shared;
+  if (sp == NULL)
+    {
+      lock_release (&share_lock);
+      return false;
+    }
+  if (pte->loaded)
+    {
+      struct thread *owner = share_remove_mapper (sp, pte);
+      pagedir_clear_page (owner->pagedir, pte->vaddr);
+      pte->loaded = false;
+    }
+  pte->shared = NULL;
+  if (--sp->ref_cnt > 0)
+    {
+      lock_release (&share_lock);
+      return true;
+    }
+  if (!sp->anon)
+    hash_delete (&share_table, &sp->elem);
+  kpage = sp->kpage;
+  lock_release (&share_lock);
+
+  /* Nobody can find SP any more, but the clock may still be
+     evicting its frame, so free the frame first, through the frame
+     table, and only then SP itself */
+  if (kpage != NULL)
+    frame_free_shared (kpage, sp);
+  if (!sp->anon)
+    {
+      inode_allow_write (sp->inode);
+      inode_close (sp->inode);
+    }
+  kmem_cache_free (share_page_cache, sp);
+  return true;
+}
+
+/* TASK 3 : Returns true if shared page SP, held in frame KPAGE, has
+   been accessed through any process's mapping or the kernel alias,
+   clearing all of the accessed bits.  Called by the clock with the
+   frame lock held */
+bool
+share_is_accessed (struct share_page *sp, void *kpage)
+{
+  struct list_elem *e;
+  bool accessed = pagedir_is_accessed (init_page_dir, kpage);
+
+  pagedir_set_accessed (init_page_dir, kpage, false);
+  lock_acquire (&share_lock);
+  for (e = list_begin (&sp->mappers); e != list_end (&sp->mappers);
+       e = list_next (e))
+    {
+      struct share_mapper *m = list_entry (e, struct share_mapper, elem);
+      uint32_t *pd = m->owner->pagedir;
+      if (pagedir_is_accessed (pd, m->pte->vaddr))
+        {
+          accessed = true;
+          pagedir_set_accessed (pd, m->pte->vaddr, false);
+        }
+    }
+  lock_release (&share_lock);
+  return accessed;
+}
+
+/* TASK 3 : Unmaps shared page SP from every process that has it
+   mapped, so that its frame can be freed.  A file page is clean,
+   so its contents are simply dropped.  A copy-on-write page is
+   written to swap, and each process that had it mapped is left
+   with a reference to the slot instead.  Called by the clock with
+   the page's frame pinned and marked as being evicted, but without
+   the frame lock */
+void
+share_evict (struct share_page *sp)
+{
+  bool anon = sp->anon;
+  struct swap_slot ss;
+  int cnt = 0;
+
+  /* Nothing can write to the page, so it can go out before
+     share_lock is taken; processes may stop sharing it meanwhile */
+  if (anon)
+    ss.swap_addr = swap_store (sp->kpage);
+
+  lock_acquire (&share_lock);
+  while (!list_empty (&sp->mappers))
+    {
+      struct share_mapper *m
+        = list_entry (list_pop_front (&sp->mappers), struct share_mapper,
+                      elem);
+      struct page_table_entry *pte = m->pte;
+      pagedir_clear_page (m->owner->pagedir, pte->vaddr);
+      kmem_cache_free (share_mapper_cache, m);
+      if (anon)
+        {
+          if (cnt++ > 0)
+            swap_dup (ss.swap_addr);
+          pte->swap_index = ss.swap_addr;
+          sp->ref_cnt--;
+        }
+
+      /* The owner may already be faulting on the page; make sure it
+         sees where the page went before it sees that it is gone */
+      barrier ();
+      pte->loaded = false;
+      if (anon)
+        {
+          barrier ();
+          pte->shared = NULL;
+        }
+    }
+  sp->kpage = NULL;
+  lock_release (&share_lock);
+
+  /* The last process to stop sharing a copy-on-write page frees
+     it.  If the clock did not unmap anybody, that was a process
+     exiting meanwhile, and only the slot is left over */
+  if (anon)
+    {
+      if (cnt == 0)
+        swap_free (&ss);
+      else
+        {
+          ASSERT (sp->ref_cnt == 0);
+          kmem_cache_free (share_page_cache, sp);
+        }
+    }
+}
+
+/* TASK 3 : Makes the page in frame F, that of PPTE, an entry of
+   PARENT, an anonymous shared page mapped read-only by PARENT.
+   Returns NULL if out of memory.  The frame lock and share_lock
+   must be held */
+static struct share_page *
+share_cow_new (struct thread *parent, struct page_table_entry *ppte,
+               struct frame *f)
+{
+  struct share_page *sp = kmem_cache_alloc (share_page_cache);
+
+  if (sp == NULL)
+    return NULL;
+  if (!share_add_mapper (sp, ppte, parent))
+    {
+      kmem_cache_free (share_page_cache, sp);
+      return NULL;
+    }
+  sp->anon = true;
+  sp->inode = NULL;
+  sp->offset = 0;
+  sp->kpage = f->addr;
+  sp->reading = false;
+  sp->ref_cnt = 1;
+  f->shared = sp;
+
+  /* PARENT is blocked in fork(), so no CPU can be running with a
+     writable TLB entry for the page left over */
+  pagedir_set_writable (parent->pagedir, ppte->vaddr, false);
+  ppte->shared = sp;
+  ppte->bit_set = SWAP_BIT;
+  return sp;
+}
+
+/* TASK 3 : Gives PTE, the current process's copy of entry PPTE of
+   PARENT, which is forking it, the same page as PPTE:
+     - a page of the executable that is shared read-only takes
+       another reference to the shared page, and is mapped on the
+       next fault, as usual;
+     - a resident page is mapped read-only in both processes, until
+       one of them writes to it;
+     - a page in swap takes another reference to its slot;
+     - any other page, including one that only has the zero page
+       mapped, is loaded on the next fault, as it would have been
+       in PARENT.
+   Returns false if out of memory */
+bool
+share_fork (struct thread *parent, struct page_table_entry *ppte,
+            struct page_table_entry *pte)
+{
+  struct share_page *sp;
+  struct frame *f = NULL;
+  bool success = true;
+
+  /* The frame lock keeps the clock from evicting PPTE's page while
+     it is looked at.  The clock may already have unmapped a page of
+     PARENT's own, but not yet have marked it as not loaded, which it
+     does once the page is saved; wait for that and take the page
+     from where it went.  Only this function makes PPTE shared, so
+     if it is not now it will not be */
+  acquire_framelock ();
+  while (ppte->shared == NULL && ppte->loaded && ppte->bit_set != ZERO_BIT)
+    {
+      void *kpage = pagedir_get_page (parent->pagedir, ppte->vaddr);
+      f = kpage != NULL ? frame_lookup (kpage) : NULL;
+      if (f != NULL && !f->evicting)
+        break;
+      f = NULL;
+      frame_wait_eviction ();
+    }
+  lock_acquire (&share_lock);
+  sp = ppte->shared;
+  if (sp != NULL && !sp->anon)
+    {
+      sp->ref_cnt++;
+      pte->shared = sp;
+    }
+  else if (ppte->loaded && ppte->bit_set != ZERO_BIT)
+    {
+      if (sp == NULL)
+        sp = share_cow_new (parent, ppte, f);
+      success = (sp != NULL
+                 && share_add_mapper (sp, pte, thread_current ()));
+      if (success && !install_page (pte->vaddr, sp->kpage, false))
+        {
+          share_remove_mapper (sp, pte);
+          success = false;
+        }
+      if (success)
+        {
+          sp->ref_cnt++;
+          pte->shared = sp;
+          pte->bit_set = SWAP_BIT;
+          pte->loaded = true;
+          cow_maps++;
+        }
+    }
+  else
+    {
+      pte->bit_set = ppte->bit_set;
+      pte->swap_index = ppte->swap_index;
+      if (pte->bit_set == SWAP_BIT)
+        swap_dup (pte->swap_index);
+    }
+  lock_release (&share_lock);
+  release_framelock ();
+  return success;
+}
+
+/* TASK 3 : Resolves a write fault on PTE, a page of the current
+   process that is writable but mapped read-only because it is
+   shared copy-on-write, by giving the process a writable page of
+   its own.  Returns false if PTE is not such a page or if out of
+   memory.  Also returns true, so that the access is retried, if
+   the page moved meanwhile, e.g. to swap */
+bool
+share_cow_break (struct page_table_entry *pte)
+{
+  struct thread *cur = thread_current ();
+  struct share_page *sp;
+  void *kpage;
+
+  /* If nobody else shares the page any more, take its frame over */
+  acquire_framelock ();
+  lock_acquire (&share_lock);
+  sp = pte->shared;
+  if (sp == NULL || !sp->anon || !pte->loaded)
+    {
+      lock_release (&share_lock);
+      release_framelock ();
+      return sp == NULL;
+    }
+  if (sp->ref_cnt == 1)
+    {
+      struct frame *f = frame_lookup (sp->kpage);
+
+      /* The clock is taking the page away; retry once it has */
+      if (f == NULL || f->shared != sp || f->evicting)
+        {
+          lock_release (&share_lock);
+          frame_wait_eviction ();
+          release_framelock ();
+          return true;
+        }
+      f->shared = NULL;
+      f->thread = cur;
+      f->upage = pte->vaddr;
+      share_remove_mapper (sp, pte);
+      pte->shared = NULL;
+      pagedir_set_writable (cur->pagedir, pte->vaddr, true);
+      cow_reuses++;
+      lock_release (&share_lock);
+      release_framelock ();
+      kmem_cache_free (share_page_cache, sp);
+      return true;
+    }
+  lock_release (&share_lock);
+  release_framelock ();
+
+  /* Otherwise copy it, into a frame allocated without any locks
+     held, since that may have to evict */
+  kpage = frame_alloc (pte->vaddr, PAL_USER);
+  if (kpage == NULL)
+    return false;
+
+  /* Holding share_lock keeps the clock from freeing the shared
+     frame until the copy is done */
+  lock_acquire (&share_lock);
+  sp = pte->shared;
+  if (sp == NULL || !pte->loaded || sp->ref_cnt == 1)
+    {
+      lock_release (&share_lock);
+      frame_free (kpage);
+      return true;
+    }
+  memcpy (kpage, sp->kpage, PGSIZE);
+  share_remove_mapper (sp, pte);
+  sp->ref_cnt--;
+  pte->shared = NULL;
+  pagedir_clear_page (cur->pagedir, pte->vaddr);
+  pagedir_set_page (cur->pagedir, pte->vaddr, kpage, true);
+  cow_copies++;
+  lock_release (&share_lock);
+
+  frame_unpin (kpage);
+  return true;
+}
+
+/* TASK 3 : Prints statistics about shared pages */
+void
+share_print_stats (void)
+{
+  printf ("Shared pages: %u mapped, %u already resident (frames saved)\n",
+          share_maps, share_hits);
+  printf ("Prefetch: %u pages read ahead of exec, %u mapped by fault-around\n",
+          share_prefetches, share_around);
+  printf ("Copy-on-write: %u pages shared by fork, %u copied, %u reused\n",
+          cow_maps, cow_copies, cow_reuses);
+}
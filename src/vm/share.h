@@ -0,0 +1,25 @@
+#ifndef _VM_SHARE_H
+#define _VM_SHARE_H
+
+#include <stdbool.h>
+
+struct file_d;
+struct page_table_entry;
+struct share_page;
+struct thread;
+
+void share_init (void);
+bool share_load (struct page_table_entry *pte, const struct file_d *file_d);
+bool share_map_resident (struct page_table_entry *pte,
+                         const struct file_d *file_d);
+bool share_prefetch (struct page_table_entry *pte,
+                     const struct file_d *file_d);
+bool share_release (struct page_table_entry *pte);
+bool share_is_accessed (struct share_page *sp, void *kpage);
+void share_evict (struct share_page *sp);
+bool share_fork (struct thread *parent, struct page_table_entry *ppte,
+                 struct page_table_entry *pte);
+bool share_cow_break (struct page_table_entry *pte);
+void share_print_stats (void);
+
+#endif /* vm/share.h */
@@ -1,22 +1,33 @@
 #include "vm/swap.h"
 #include "vm/page.h"
+#include "vm/zswap.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "userprog/syscall.h"
 #include <bitmap.h>
 #include <hash.h>
 #include <debug.h>
 #include <stdio.h>
+#include <string.h>
 
 #define PGSIZE 4096                                 /* The size of a page. */
-#define NBR_BLOCKS (PGSIZE / BLOCK_SECTOR_SIZE)     /* The number of sectors in a page. */
+#define NBR_BLOCKS SWAP_SLOT_SECTORS                 /* The number of sectors in a page. */
 
 static struct block *swap_space;                    /* Block storing swapped table */
-static struct lock swap_lock;                       /* Global lock to stop concurrent access of the swap table. */
+static struct lock swap_lock;                       /* Protects swap_bitmap.  Not held during disk I/O. */
 static struct bitmap * swap_bitmap;                 /* The Swap Table Bitmap */
+static size_t swap_cursor;                          /* Where swap_get_free() looks first */
+static uint16_t *swap_refs;                         /* Swap table entries sharing each slot */
 
 unsigned swap_size;                                  /* Size of the Swap Block  */
 
+/* TASK 3 : With the "-swap-per-sector" kernel option, pages go to
+   and from the device with one request per sector, as they did
+   before block_read_multi() and block_write_multi(), so that the
+   two can be compared. */
+bool swap_per_sector;
+
 static void acquire_swaplock (void);
 static void release_swaplock (void);
 block_sector_t swap_get_free(void);
@@ -39,20 +50,29 @@ release_swaplock (void)
 void
 swap_init ()
 {
-  /* block device used for swapping */
+  /* initializes the swap lock, which swap_store() takes even
+     when there is no device to report the problem */
+  lock_init_named(&swap_lock, "swap_lock");
+
+  /* block device used for swapping, if there is one */
   swap_space = block_get_role (BLOCK_SWAP);
+  if (swap_space == NULL)
+    return;
 
   /* get the size of the block */
   swap_size = block_size (swap_space);
 
-  /* initializes the swap lock */
-  lock_init(&swap_lock);
-
   swap_bitmap = bitmap_create (swap_size);
+  swap_refs = calloc (swap_size / NBR_BLOCKS, sizeof *swap_refs);
+  if (swap_bitmap == NULL || swap_refs == NULL)
+    PANIC ("Not enough memory for the swap table");
 
   acquire_swaplock();
 	bitmap_set_all(swap_bitmap, 0);
 	release_swaplock();
+
+  /* compressed pool in front of the device, if asked for */
+  zswap_init ();
 }
 
 /* TASK 3: Construct the swap slot and dereference to frame */
@@ -64,47 +84,210 @@ swap_slot * swap_slot_construct (struct frame * frame)
   return swap_slot;
 }
 
-/* TASK 3: Checking as if the swap table is full or else flips them all and
-   returns the index of the first bit in the group. */
+/* TASK 3: Reserves NBR_BLOCKS consecutive sectors in the swap
+   table and returns the first of them.  Panics if swap is
+   missing or full.  Must be called with the swap lock held.
+
+   Slots are handed out next-fit: the search starts just past the
+   slot handed out last, and only wraps around to the start of the
+   table when it reaches the end.  Pages evicted one after another,
+   as the clock sweeps over a process's array, so land in
+   consecutive slots, where swap read-ahead can find them.
+
+   Every reservation is NBR_BLOCKS sectors long and the search
+   starts on a slot boundary, so slots never straddle one another
+   and swap_refs can be indexed by slot. */
 block_sector_t swap_get_free ()
 {
-  bool isFull = bitmap_all (swap_bitmap, 0 , swap_size);
-  if (isFull)
+  if (swap_space == NULL)
+  {
+    PANIC("No swap device! Memory exhausted!");
+  }
+  size_t swap_addr = bitmap_scan_and_flip (swap_bitmap, swap_cursor,
+                                           NBR_BLOCKS, false);
+  if (swap_addr == BITMAP_ERROR)
+    swap_addr = bitmap_scan_and_flip (swap_bitmap, 0, NBR_BLOCKS, false);
+  if (swap_addr == BITMAP_ERROR)
   {
     PANIC("SWAP id full! Memory exhausted!");
   }
-  return bitmap_scan_and_flip (swap_bitmap, 0, NBR_BLOCKS, NULL);
+  ASSERT (swap_addr % NBR_BLOCKS == 0);
+  swap_cursor = swap_addr + NBR_BLOCKS;
+  swap_refs[swap_addr / NBR_BLOCKS] = 1;
+  return swap_addr;
+}
+
+/* TASK 3 : Reads swap slot SLOT from the block device into the
+   page at KPAGE */
+static void
+swap_read_slot (block_sector_t slot, void *kpage)
+{
+  uint8_t *p = kpage;
+  size_t i;
+
+  if (!swap_per_sector)
+    block_read_multi (swap_space, slot, kpage, NBR_BLOCKS);
+  else
+    for (i = 0; i < NBR_BLOCKS; i++)
+      block_read (swap_space, slot + i, p + i * BLOCK_SECTOR_SIZE);
 }
 
-/* TASK 3 : Load the swapping address by reading the block device */
+/* TASK 3 : Load the swapping address, from the compressed pool if
+   the page is there and otherwise by reading the block device.
+   The page is read with one multi-sector request and without the
+   swap lock, which only guards the bitmap: the slot still belongs
+   to SS until it is released below, so nobody can reuse it while
+   the read is in flight.  Processes that share the slot since a
+   fork keep it until they have read it too. */
 void
 swap_load (void *upageaddr, struct swap_slot* ss)
 {
-  acquire_swaplock();
-  for (int i = 0; i < PGSIZE / BLOCK_SECTOR_SIZE; i++)
-    block_read (swap_space, ss->swap_addr + i, upageaddr + i * BLOCK_SECTOR_SIZE);
-  bitmap_set_multiple (swap_bitmap, ss->swap_addr, NBR_BLOCKS, NULL);
-  release_swaplock();
+  if (!zswap_load (ss->swap_addr, upageaddr))
+    swap_read_slot (ss->swap_addr, upageaddr);
+  swap_free (ss);
+}
+
+
+/* TASK 3 : Reads the N pages of the run of slots from SLOT on that
+   the compressed pool does not hold, starting with page FIRST, into
+   KPAGES[FIRST] onward.  The frames are scattered, so the run is
+   read with one request into BOUNCE, N pages long, and copied out;
+   without a bounce buffer each page is read by itself */
+static void
+swap_read_run (block_sector_t slot, void *kpages[], size_t first, size_t n,
+               uint8_t *bounce)
+{
+  size_t i;
+
+  if (n == 1 || bounce == NULL)
+    {
+      for (i = first; i < first + n; i++)
+        swap_read_slot (slot + i * NBR_BLOCKS, kpages[i]);
+      return;
+    }
+  block_read_multi (swap_space, slot + first * NBR_BLOCKS, bounce,
+                    n * NBR_BLOCKS);
+  for (i = 0; i < n; i++)
+    memcpy (kpages[first + i], bounce + i * PGSIZE, PGSIZE);
+}
+
+/* TASK 3 : Loads the CNT pages swapped out to the consecutive slots
+   from SLOT on into the pages at KPAGES, then releases the slots,
+   as swap_load() does for one page.  Pages the compressed pool
+   holds come from there, and each run of the others is read from
+   the device with one multi-sector request rather than one per
+   page.  CNT must not exceed SWAP_RUN_PAGES.  With the
+   "-swap-per-sector" option, every page is read by itself, a
+   sector at a time */
+void
+swap_load_run (block_sector_t slot, void *kpages[], size_t cnt)
+{
+  uint8_t *bounce = NULL;
+  size_t i, first, n;
+  struct swap_slot ss;
+
+  ASSERT (cnt <= SWAP_RUN_PAGES);
+
+  if (!swap_per_sector && cnt > 1)
+    bounce = palloc_get_multiple (0, cnt);
+
+  /* FIRST and N delimit the run of pages waiting to be read */
+  first = n = 0;
+  for (i = 0; i < cnt; i++)
+    if (!zswap_load (slot + i * NBR_BLOCKS, kpages[i]))
+      {
+        if (n == 0)
+          first = i;
+        n++;
+      }
+    else if (n > 0)
+      {
+        swap_read_run (slot, kpages, first, n, bounce);
+        n = 0;
+      }
+  if (n > 0)
+    swap_read_run (slot, kpages, first, n, bounce);
+
+  if (bounce != NULL)
+    palloc_free_multiple (bounce, cnt);
+  for (i = 0; i < cnt; i++)
+    {
+      ss.swap_addr = slot + i * NBR_BLOCKS;
+      swap_free (&ss);
+    }
 }
 
 
-/* TASK 3 : Store the swapping address by writing into the block device */
+/* TASK 3 : Store the swapping address by writing into the block device,
+   unless the compressed pool takes the page.  The slot is reserved
+   either way, so that the pool can write the page back to it later.
+   Only the slot reservation happens under the swap lock, so other
+   threads can reserve and release slots while the page goes out
+   in one multi-sector request. */
 size_t
 swap_store (void *vaddr)
 {
   acquire_swaplock();
   block_sector_t swap_addr = swap_get_free();
-  for (int i = 0; i < NBR_BLOCKS; i++)
-    block_write (swap_space, swap_addr + i, vaddr + i *BLOCK_SECTOR_SIZE);
   release_swaplock();
+  if (!zswap_store (swap_addr, vaddr))
+    swap_write_slot (swap_addr, vaddr);
   return (size_t) swap_addr;
 }
 
-/* TASK 3: Free swap slots */
+/* TASK 3 : Writes the page at KPAGE to swap slot SLOT on the block
+   device */
+void
+swap_write_slot (block_sector_t slot, const void *kpage)
+{
+  const uint8_t *p = kpage;
+  size_t i;
+
+  if (!swap_per_sector)
+    block_write_multi (swap_space, slot, kpage, NBR_BLOCKS);
+  else
+    for (i = 0; i < NBR_BLOCKS; i++)
+      block_write (swap_space, slot + i, p + i * BLOCK_SECTOR_SIZE);
+}
+
+/* TASK 3 : Takes another reference to swap slot SLOT, for a
+   forked process whose page table entry shares it */
+void
+swap_dup (block_sector_t slot)
+{
+  acquire_swaplock();
+  ASSERT (swap_refs[slot / NBR_BLOCKS] > 0);
+  swap_refs[slot / NBR_BLOCKS]++;
+  release_swaplock();
+}
+
+/* TASK 3: Drops a reference to swap slot SS, freeing the slot when
+   it was the last */
 void
 swap_free (struct swap_slot* ss)
 {
+  acquire_swaplock();
+  bool last = --swap_refs[ss->swap_addr / NBR_BLOCKS] == 0;
+  release_swaplock();
+  if (!last)
+    return;
+
+  zswap_invalidate (ss->swap_addr);
   acquire_swaplock();
   bitmap_set_multiple (swap_bitmap, ss->swap_addr, NBR_BLOCKS, false);
   release_swaplock();
 }
+
+/* TASK 3 : Prints statistics about swap */
+void
+swap_print_stats (void)
+{
+  if (swap_space == NULL)
+    return;
+
+  acquire_swaplock();
+  size_t used = bitmap_count (swap_bitmap, 0, swap_size, true) / NBR_BLOCKS;
+  release_swaplock();
+  printf ("Swap: %zu of %u slots in use\n", used, swap_size / NBR_BLOCKS);
+  zswap_print_stats ();
+}
@@ -4,6 +4,16 @@
 #include "vm/frame.h"
 #include "devices/block.h"
 
+/* Sectors in one swap slot, which holds one page. */
+#define SWAP_SLOT_SECTORS (4096 / BLOCK_SECTOR_SIZE)
+
+/* Most pages swap_load_run() reads, as many as one disk request
+   of 255 sectors holds. */
+#define SWAP_RUN_PAGES (255 / SWAP_SLOT_SECTORS)
+
+/* TASK 3 : Move swap pages a sector at a time, for comparison? */
+extern bool swap_per_sector;
+
 struct swap_slot {
 	struct frame *swap_frame;   /* Frame that is being swapped */
 	block_sector_t swap_addr;	 /* Address of the first segment where the page stored */
@@ -11,8 +21,12 @@ struct swap_slot {
 
 void swap_init (void);
 void swap_load (void* , struct swap_slot* ss);
+void swap_load_run (block_sector_t slot, void *kpages[], size_t cnt);
 size_t swap_store (void *vaddr);
 void swap_free (struct swap_slot* ss);
+void swap_dup (block_sector_t slot);
+void swap_write_slot (block_sector_t slot, const void *kpage);
+void swap_print_stats (void);
 struct swap_slot* swap_slot_construct(struct frame* frame);
 
 #endif /* vm/swap.h */
@@ -0,0 +1,498 @@
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/swap.h"
+
+/* TASK 3 : Compressed swap pool.
+
+   Sits in front of the swap device.  swap_store() reserves a slot
+   as usual and then offers the page to zswap_store(), which keeps
+   it in memory instead of writing it out:
+     - a page of zeros is remembered as a flag, taking no space;
+     - any other page is compressed with a small LZ77 codec into a
+       pool of kernel pages, unless it would not shrink to
+       ZSWAP_MAX_SIZE, in which case it goes to disk after all.
+   swap_load() asks zswap_load() for the slot before reading the
+   disk, and a hit returns the page to the process without any
+   I/O.  Only when the pool is full are the oldest pages in it
+   decompressed and written to their slots on disk, to make room.
+
+   Entries are keyed by swap slot, so the rest of the VM code keeps
+   dealing in slots and does not know whether a page is on disk or
+   in the pool.
+
+   The pool is one contiguous run of zswap_pool_pages kernel pages,
+   carved into ZSWAP_CHUNK-byte chunks; a compressed page takes a
+   run of contiguous chunks.  The pool is off unless the "-zswap"
+   kernel option is given. */
+
+#define ZSWAP_CHUNK 64                          /* Bytes per pool chunk. */
+#define ZSWAP_MAX_SIZE (PGSIZE * 3 / 4)         /* Largest page we keep. */
+
+/* A page held by the pool */
+struct zswap_entry
+  {
+    block_sector_t slot;        /* Swap slot the page belongs to */
+    bool zero;                  /* All zeros?  Then nothing is stored */
+    size_t chunk;               /* First chunk of the compressed data */
+    size_t size;                /* Bytes of compressed data */
+    struct hash_elem hash_elem; /* Element of zswap_entries */
+    struct list_elem lru_elem;  /* Element of zswap_lru */
+  };
+
+size_t zswap_pool_pages;
+
+static struct lock zswap_lock;          /* Protects everything below */
+static uint8_t *zswap_pool;             /* The pool's pages */
+static struct bitmap *zswap_chunks;     /* Chunks in use */
+static struct hash zswap_entries;       /* Entries by slot */
+static struct list zswap_lru;           /* Entries, oldest first */
+static uint8_t *zswap_cbuf;             /* Compression output */
+static uint8_t *zswap_wbuf;             /* Write-back staging page */
+
+/* Statistics */
+static unsigned zswap_stores;           /* Pages offered */
+static unsigned zswap_zero;             /* Zero pages kept as a flag */
+static unsigned zswap_rejects;          /* Pages that did not compress */
+static unsigned zswap_hits;             /* Loads served from the pool */
+static unsigned zswap_misses;           /* Loads left to the disk */
+static unsigned zswap_writebacks;       /* Pages written back to disk */
+static uint64_t zswap_raw_bytes;        /* Bytes of pages compressed */
+static uint64_t zswap_packed_bytes;     /* The same, compressed */
+static size_t zswap_peak_chunks;        /* Most chunks in use at once */
+
+static size_t lz_compress (const uint8_t *src, size_t len,
+                           uint8_t *dst, size_t max);
+static bool lz_decompress (const uint8_t *src, size_t len,
+                           uint8_t *dst, size_t dst_len);
+
+/* TASK 3 : Returns a hash value for a zswap entry, from its slot */
+static unsigned
+zswap_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct zswap_entry *z = hash_entry (e, struct zswap_entry, hash_elem);
+  return hash_int (z->slot);
+}
+
+/* TASK 3 : Returns true if entry 'a' has a lower slot than 'b' */
+static bool
+zswap_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct zswap_entry, hash_elem)->slot
+          < hash_entry (b, struct zswap_entry, hash_elem)->slot);
+}
+
+/* TASK 3 : Sets up the pool, if the "-zswap" option asked for one */
+void
+zswap_init (void)
+{
+  size_t chunk_cnt = zswap_pool_pages * (PGSIZE / ZSWAP_CHUNK);
+
+  lock_init_named (&zswap_lock, "zswap_lock");
+  if (zswap_pool_pages == 0)
+    return;
+
+  zswap_pool = palloc_get_multiple (0, zswap_pool_pages);
+  zswap_cbuf = palloc_get_page (0);
+  zswap_wbuf = palloc_get_page (0);
+  zswap_chunks = bitmap_create (chunk_cnt);
+  if (zswap_pool == NULL || zswap_cbuf == NULL || zswap_wbuf == NULL
+      || zswap_chunks == NULL)
+    PANIC ("zswap: cannot allocate a %zu page pool", zswap_pool_pages);
+  hash_init (&zswap_entries, zswap_hash, zswap_less, NULL);
+  list_init (&zswap_lru);
+}
+
+/* TASK 3 : Returns the entry for SLOT, or NULL.  The zswap lock must
+   be held */
+static struct zswap_entry *
+zswap_lookup (block_sector_t slot)
+{
+  struct zswap_entry key;
+  struct hash_elem *e;
+
+  key.slot = slot;
+  e = hash_find (&zswap_entries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct zswap_entry, hash_elem) : NULL;
+}
+
+/* TASK 3 : Removes entry Z from the pool and frees it.  The zswap
+   lock must be held */
+static void
+zswap_drop (struct zswap_entry *z)
+{
+  hash_delete (&zswap_entries, &z->hash_elem);
+  list_remove (&z->lru_elem);
+  if (!z->zero)
+    bitmap_set_multiple (zswap_chunks, z->chunk,
+                         DIV_ROUND_UP (z->size, ZSWAP_CHUNK), false);
+  free (z);
+}
+
+/* TASK 3 : Decompresses entry Z into PAGE.  The zswap lock must be
+   held */
+static void
+zswap_unpack (const struct zswap_entry *z, void *page)
+{
+  if (z->zero)
+    memset (page, 0, PGSIZE);
+  else if (!lz_decompress (zswap_pool + z->chunk * ZSWAP_CHUNK, z->size,
+                           page, PGSIZE))
+    PANIC ("zswap: slot %"PRDSNu" is corrupt", z->slot);
+}
+
+/* TASK 3 : Writes the oldest page in the pool back to its slot on
+   disk and frees its space.  Returns false if the pool is empty.
+   The zswap lock must be held, and stays held over the write so
+   that nobody looks for the page on disk before it is there; this
+   only happens once the pool has filled up */
+static bool
+zswap_writeback_one (void)
+{
+  struct zswap_entry *z;
+
+  if (list_empty (&zswap_lru))
+    return false;
+  z = list_entry (list_front (&zswap_lru), struct zswap_entry, lru_elem);
+  zswap_unpack (z, zswap_wbuf);
+  swap_write_slot (z->slot, zswap_wbuf);
+  zswap_drop (z);
+  zswap_writebacks++;
+  return true;
+}
+
+/* TASK 3 : Returns true if PAGE is all zeros */
+static bool
+page_is_zero (const void *page)
+{
+  const uint32_t *p = page;
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *p; i++)
+    if (p[i] != 0)
+      return false;
+  return true;
+}
+
+/* TASK 3 : Offers PAGE, about to be swapped out to SLOT, to the
+   pool.  Returns true if the pool took it, in which case nothing
+   needs to be written to disk, or false if the caller must write
+   it out itself */
+bool
+zswap_store (block_sector_t slot, const void *page)
+{
+  struct zswap_entry *z;
+  size_t size = 0, chunk_cnt, chunk = 0;
+  bool zero;
+
+  if (zswap_pool == NULL)
+    return false;
+
+  z = malloc (sizeof *z);
+  if (z == NULL)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  zswap_stores++;
+  zero = page_is_zero (page);
+  if (!zero)
+    {
+      size = lz_compress (page, PGSIZE, zswap_cbuf, ZSWAP_MAX_SIZE);
+      if (size == 0)
+        {
+          zswap_rejects++;
+          lock_release (&zswap_lock);
+          free (z);
+          return false;
+        }
+
+      /* Find room, making it by writing old pages back if need be */
+      chunk_cnt = DIV_ROUND_UP (size, ZSWAP_CHUNK);
+      while ((chunk = bitmap_scan_and_flip (zswap_chunks, 0, chunk_cnt,
+                                            false)) == BITMAP_ERROR)
+        if (!zswap_writeback_one ())
+          {
+            lock_release (&zswap_lock);
+            free (z);
+            return false;
+          }
+      memcpy (zswap_pool + chunk * ZSWAP_CHUNK, zswap_cbuf, size);
+
+      zswap_raw_bytes += PGSIZE;
+      zswap_packed_bytes += size;
+      size_t used = bitmap_count (zswap_chunks, 0,
+                                  bitmap_size (zswap_chunks), true);
+      if (used > zswap_peak_chunks)
+        zswap_peak_chunks = used;
+    }
+  else
+    zswap_zero++;
+
+  z->slot = slot;
+  z->zero = zero;
+  z->chunk = chunk;
+  z->size = size;
+  hash_insert (&zswap_entries, &z->hash_elem);
+  list_push_back (&zswap_lru, &z->lru_elem);
+  lock_release (&zswap_lock);
+  return true;
+}
+
+/* TASK 3 : If the page swapped out to SLOT is in the pool, copies it
+   into PAGE and returns true.  Otherwise returns false, and the
+   page is on disk.  The page stays in the pool until the slot is
+   freed, since forked processes may share the slot */
+bool
+zswap_load (block_sector_t slot, void *page)
+{
+  struct zswap_entry *z;
+
+  if (zswap_pool == NULL)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  z = zswap_lookup (slot);
+  if (z != NULL)
+    {
+      zswap_unpack (z, page);
+      zswap_hits++;
+    }
+  else
+    zswap_misses++;
+  lock_release (&zswap_lock);
+  return z != NULL;
+}
+
+/* TASK 3 : Forgets the page swapped out to SLOT, if it is in the
+   pool, because the slot is being freed */
+void
+zswap_invalidate (block_sector_t slot)
+{
+  struct zswap_entry *z;
+
+  if (zswap_pool == NULL)
+    return;
+
+  lock_acquire (&zswap_lock);
+  z = zswap_lookup (slot);
+  if (z != NULL)
+    zswap_drop (z);
+  lock_release (&zswap_lock);
+}
+
+/* TASK 3 : Prints statistics about the pool, if there is one */
+void
+zswap_print_stats (void)
+{
+  unsigned loads = zswap_hits + zswap_misses;
+  size_t chunk_cnt;
+
+  if (zswap_pool == NULL)
+    return;
+
+  chunk_cnt = bitmap_size (zswap_chunks);
+  printf ("Zswap: %u pages stored (%u zero, %u incompressible), "
+          "%u written back\n",
+          zswap_stores, zswap_zero, zswap_rejects, zswap_writebacks);
+  printf ("Zswap: %u of %u loads hit (%u%%), compressed to %u%%, "
+          "pool %zu of %zu kB used (peak %zu kB)\n",
+          zswap_hits, loads, loads ? zswap_hits * 100 / loads : 0,
+          zswap_raw_bytes
+          ? (unsigned) (zswap_packed_bytes * 100 / zswap_raw_bytes) : 0,
+          bitmap_count (zswap_chunks, 0, chunk_cnt, true)
+          * ZSWAP_CHUNK / 1024,
+          chunk_cnt * ZSWAP_CHUNK / 1024,
+          zswap_peak_chunks * ZSWAP_CHUNK / 1024);
+}
+
+/* TASK 3 : LZ77 codec, in the style of LZ4.
+
+   The compressed data is a series of sequences, each a token byte,
+   then a run of literal bytes copied as is, then a match: a
+   2-byte little-endian offset back into the output and a length.
+   The token's high nibble is the literal count and its low nibble
+   the match length minus LZ_MIN_MATCH; a nibble of 15 means more
+   length follows in extra bytes, each added in, up to and
+   including the first that is not 255.  The last sequence has
+   literals only.
+
+   Matches are found with a small hash table of the last position
+   at which each 4-byte string was seen, which is fast and finds
+   the runs and repeated words that make up most compressible
+   pages. */
+
+#define LZ_MIN_MATCH 4                  /* Shortest match encoded. */
+#define LZ_HASH_BITS 10                 /* Bits of hash table index. */
+
+static uint16_t lz_table[1 << LZ_HASH_BITS];   /* Guarded by zswap_lock. */
+
+/* TASK 3 : Returns the 4 bytes at P as an integer */
+static inline uint32_t
+lz_read32 (const uint8_t *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof v);
+  return v;
+}
+
+/* TASK 3 : Writes the extra bytes of length LEN, which was too long
+   for its nibble, at OP and returns the new end of output */
+static uint8_t *
+lz_put_length (uint8_t *op, size_t len)
+{
+  for (len -= 15; len >= 255; len -= 255)
+    *op++ = 255;
+  *op++ = len;
+  return op;
+}
+
+/* TASK 3 : Appends a sequence of LIT_LEN literals from LIT and a
+   match of MATCH_LEN bytes, OFFSET bytes back, at *OPP, advancing
+   *OPP.  A MATCH_LEN of 0 means no match.  Returns false without
+   writing anything if the sequence might not fit before OEND */
+static bool
+lz_emit (uint8_t **opp, uint8_t *oend, const uint8_t *lit, size_t lit_len,
+         size_t offset, size_t match_len)
+{
+  uint8_t *op = *opp;
+  uint8_t *token;
+  size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+
+  if ((size_t) (oend - op) < 1 + lit_len / 255 + 1 + lit_len
+                             + 2 + ml / 255 + 1)
+    return false;
+
+  token = op++;
+  *token = (lit_len < 15 ? lit_len : 15) << 4;
+  if (lit_len >= 15)
+    op = lz_put_length (op, lit_len);
+  memcpy (op, lit, lit_len);
+  op += lit_len;
+
+  if (match_len != 0)
+    {
+      *op++ = offset & 0xff;
+      *op++ = offset >> 8;
+      *token |= ml < 15 ? ml : 15;
+      if (ml >= 15)
+        op = lz_put_length (op, ml);
+    }
+  *opp = op;
+  return true;
+}
+
+/* TASK 3 : Compresses the LEN bytes at SRC into DST, which has room
+   for MAX bytes.  Returns the compressed size, or 0 if it would
+   not fit.  LEN must be less than 64 kB */
+static size_t
+lz_compress (const uint8_t *src, size_t len, uint8_t *dst, size_t max)
+{
+  const uint8_t *ip = src, *anchor = src;
+  const uint8_t *end = src + len;
+  uint8_t *op = dst;
+
+  ASSERT (len < 65536);
+
+  memset (lz_table, 0, sizeof lz_table);
+  while (end - ip >= LZ_MIN_MATCH)
+    {
+      uint32_t v = lz_read32 (ip);
+      unsigned h = (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+      const uint8_t *ref = src + lz_table[h];
+      const uint8_t *mp;
+
+      lz_table[h] = ip - src;
+      if (ref >= ip || lz_read32 (ref) != v)
+        {
+          ip++;
+          continue;
+        }
+
+      for (mp = ip + LZ_MIN_MATCH; mp < end && *mp == ref[mp - ip]; mp++)
+        continue;
+      if (!lz_emit (&op, dst + max, anchor, ip - anchor, ip - ref, mp - ip))
+        return 0;
+      ip = anchor = mp;
+    }
+
+  if (!lz_emit (&op, dst + max, anchor, end - anchor, 0, 0))
+    return 0;
+  return op - dst;
+}
+
+/* TASK 3 : Reads the rest of a length whose nibble was 15 from *IPP,
+   adding it to *LEN.  Returns false if the input ends first */
+static bool
+lz_get_length (const uint8_t **ipp, const uint8_t *iend, size_t *len)
+{
+  const uint8_t *ip = *ipp;
+  uint8_t b;
+
+  do
+    {
+      if (ip >= iend)
+        return false;
+      b = *ip++;
+      *len += b;
+    }
+  while (b == 255);
+  *ipp = ip;
+  return true;
+}
+
+/* TASK 3 : Decompresses the LEN bytes at SRC, produced by
+   lz_compress(), into DST, which must come out exactly DST_LEN
+   bytes long.  Returns false if the data is malformed */
+static bool
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len)
+{
+  const uint8_t *ip = src, *iend = src + len;
+  uint8_t *op = dst, *oend = dst + dst_len;
+
+  while (ip < iend)
+    {
+      uint8_t token = *ip++;
+      size_t lit_len = token >> 4;
+      size_t match_len = token & 15;
+      size_t offset;
+
+      if (lit_len == 15 && !lz_get_length (&ip, iend, &lit_len))
+        return false;
+      if (lit_len > (size_t) (iend - ip) || lit_len > (size_t) (oend - op))
+        return false;
+      memcpy (op, ip, lit_len);
+      ip += lit_len;
+      op += lit_len;
+
+      /* The last sequence has no match */
+      if (ip == iend)
+        break;
+
+      if (iend - ip < 2)
+        return false;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (match_len == 15 && !lz_get_length (&ip, iend, &match_len))
+        return false;
+      match_len += LZ_MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || match_len > (size_t) (oend - op))
+        return false;
+
+      /* Byte by byte, since the match may overlap its own output */
+      for (; match_len > 0; match_len--, op++)
+        *op = op[-offset];
+    }
+  return op == oend;
+}
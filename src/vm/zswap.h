@@ -0,0 +1,17 @@
+#ifndef _VM_ZSWAP_H
+#define _VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* TASK 3 : Pages in the compressed swap pool, 0 to disable it */
+extern size_t zswap_pool_pages;
+
+void zswap_init (void);
+bool zswap_store (block_sector_t slot, const void *page);
+bool zswap_load (block_sector_t slot, void *page);
+void zswap_invalidate (block_sector_t slot);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */